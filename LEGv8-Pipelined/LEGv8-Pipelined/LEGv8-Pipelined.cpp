@@ -14,35 +14,17 @@ This program was designed to simulate an ARM x64 processor using the limited ins
 #include <iomanip>
 #include <map>
 
-using namespace std;
+#include "LEGv8-Pipelined.h"
 
-struct Instructions //contains all of the information from the machine code
-{
-	int opcode;
-	int Rd, _Rd; //underscore variables are used to store value stored in corresponding register location
-	int Rn, _Rn; // "" 
-	int Rm, _Rm; // ""
-	int Rt, _Rt; // ""
-	int shamt;
-	int ALU_immediate;
-	int op;
-	int BR_address;
-	int COND_BR_address;
-	int MOV_immediate;
-	int DT_address;
-	int LSL;
-	char format; //Format of the opcode ( R I D B C D )
-
-				 //Overload << operator to be able to output Instructions
-				 //Only outputs variables for the proper opcode based on the format
-	friend ostream& operator << (ostream& out_str, const Instructions&  output);
-};
+using namespace std;
 
 string fetchVars;
+int fetchLocation; //instruction memory location fetchVars was read from
 int PC = 1;
 int SP = 1;
-int clockCycles;
+long long clockCycles;
 int endProgram = 0;
+long long instructionsRetired; //instructions that reached writeback, used for CPI
 
 bool pipeline;
 bool negativeFlag;
@@ -61,38 +43,22 @@ Instructions decodeVars;
 Instructions executeVars;
 Instructions writebackVars;
 Instructions noOP;
-Instructions assemble;
 
 array<int, 32> registers; //Ininitilize 32 registers available to LEG V8
-array<string, 100> memory; // Heap/Stack memory used by the assembler, size is arbitrary at this point
-array<unsigned char, 1024> dataMemory;
+array<string, 4096> memory; // Heap/Stack memory used by the assembler, sized for the generated workloads
+array<unsigned char, 1048576> dataMemory;
 array<int, 200> simpleDataMemory;
 
-int convertBinaryStringToInt(string machineCode, int start, int end, int findFormat, int checkNegative);
-string signExtend(string binary, int stringStart, int totalSize);
-string convertIntToBinaryString(int integer);
-void twosComplement(char *variable);
 void finalize(time_t, time_t);
-char findFormat(int opcode);
 void fillSimpleData();
 void readSimpleData();
-void storeDataMemory(int data, int location, int size);
-int loadDataMemory(int location, int size);
-void setFlags(int integer);
-void clearFlags();
-void checkFlags();
 void assembler();
-void machineCompliler();
-void fetch();
-void decode();
-void execute();
-void writeback();
 void clockCycle();
-void hazardCheck();
 void setup();
-void forwarding();
-void pipelined();
-void unpipelined();
+template<bool Pipelined> void fetchStage();
+template<bool Pipelined> void decodeStage();
+template<bool Pipelined> void executeStage();
+template<bool Pipelined, bool Checked, bool Traced> void writebackStage();
 
 
 
@@ -107,67 +73,335 @@ array<int, 10> unSorted;
 //////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-int main()
+int main(int argc, char* argv[])
 {
 	time_t tstart, tend;
 	tstart = time(0);
 
 	srand(time(NULL));
 
-	assembler();
+	if ((argc > 1) && (string(argv[1]) == "--bench"))
+		return runWorkloads(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--microbench"))
+		return runMicrobenchmarks(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--assemble"))
+		return runAssembler(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--image"))
+		return runImageBuilder(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--replay"))
+		return runReplay(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--cachesim"))
+		return runCacheSim(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--dataflow"))
+		return runDataflow(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--baselines"))
+		return runBaselines(argc, argv);
+	if ((argc > 1) && (string(argv[1]) == "--parallel-worker"))
+		return runParallelWorker(argc, argv);
+
+	bool loadImage = (argc > 2) && (string(argv[1]) == "--load");
+	bool loadSource = (argc > 2) && (string(argv[1]) == "--asm");
+	string traceName;
+	string cacheSweepName;
+	string localityName;
+	bool dataflow = false;
+	bool baselines = false;
+	bool debugging = false;
+	long long fastForwardCount = 0;
+	string checkpointName;
+	string restoreName;
+	for (int i = (loadImage || loadSource) ? 3 : 1; i < argc; i++)
+	{
+		string option = argv[i];
+		int used = 0;
+		if (option == "--cosim") cosimEnabled = true;
+		else if ((option == "--trace") && (i + 1 < argc)) traceName = argv[++i];
+		else if ((option == "--cache-sweep") && (i + 1 < argc)) cacheSweepName = argv[++i];
+		else if ((option == "--locality") && (i + 1 < argc)) localityName = argv[++i];
+		else if (option == "--ilp") dataflow = true;
+		else if (option == "--speedup") baselines = true;
+		else if (option == "--debug") debugging = true;
+		else if (option == "--simd-scalar") hostSimd = false;
+		else if ((option == "--debug-history") && (i + 1 < argc)) historyBudget = max(1LL, atoll(argv[++i])) << 20;
+		else if ((option == "--fast-forward") && (i + 1 < argc)) fastForwardCount = max(0LL, atoll(argv[++i]));
+		else if ((option == "--checkpoint") && (i + 1 < argc)) checkpointName = argv[++i];
+		else if ((option == "--restore") && (i + 1 < argc)) restoreName = argv[++i];
+		else if ((option == "--break") && (i + 1 < argc)) debuggerCommands.push_back(string("break ") + argv[++i]);
+		else if ((option == "--watch") && (i + 1 < argc)) debuggerCommands.push_back(string("watch ") + argv[++i]);
+		else if ((option == "--units") && (i + 1 < argc))
+		{
+			if (!loadUnits(argv[++i])) return 1;
+		}
+		else if ((option == "--plugin") && (i + 1 < argc))
+		{
+			if (!loadPlugin(argv[++i])) return 1;
+		}
+		else if ((option == "--locality-line") && (i + 1 < argc)) localityLineBytes = max(1, atoi(argv[++i]));
+		else if ((option == "--locality-window") && (i + 1 < argc)) localityWindow = max(1, atoi(argv[++i]));
+		else if ((used = parseDataOption(argc, argv, i)) > 0) i += used - 1;
+		else if (!used && ((used = parseSimpointOption(argc, argv, i)) > 0)) i += used - 1;
+		else if (!used && ((used = parseParallelOption(argc, argv, i)) > 0)) i += used - 1;
+		else if (!used && ((used = parseBaselineOption(argc, argv, i)) > 0)) i += used - 1;
+		else if (!used && ((used = parseDeviceOption(argc, argv, i)) > 0)) i += used - 1;
+		else
+		{
+			if (!used)
+			{
+				cout << "Unknown option " << option << endl;
+				cout << "Usage: [--asm file | --load image] [--data file address]... [--dump file address bytes]... [--csv-width N] [--console file] [--input file] [--units file] [--plugin file]... [--simd-scalar] [--cosim] [--trace file] [--cache-sweep file]"
+					<< " [--locality prefix [--locality-line bytes] [--locality-window cycles]] [--ilp]"
+					<< " [--speedup [--multicycle-states class=cycles,...] [--cycle-time single=ps,multi=ps,stage=ps]]"
+					<< " [--debug [--debug-history MiB]] [--break location] [--watch address[,bytes[,kind]]]"
+					<< " [--restore file] [--fast-forward N] [--checkpoint file]"
+					<< " [--simpoint [--simpoint-interval N] [--simpoint-clusters K] [--simpoint-warmup N] [--simpoint-samples S]]"
+					<< " [--parallel [--parallel-interval N] [--parallel-warmup N] [--parallel-jobs N] [--parallel-prefix prefix]]" << endl;
+			}
+			return 1;
+		}
+	}
+
+	if (!restoreName.empty() && (loadImage || loadSource))
+	{
+		cout << "--restore replaces the program, it cannot be combined with --asm or --load" << endl;
+		return 1;
+	}
+	if (!debuggerCommands.empty()) debugging = true;
+	if (simpointEnabled && parallelEnabled)
+	{
+		cout << "--simpoint and --parallel cannot be combined" << endl;
+		return 1;
+	}
+	if ((simpointEnabled || parallelEnabled) && (debugging || cosimEnabled || dataflow || baselines || !traceName.empty() || !cacheSweepName.empty() || !localityName.empty()))
+	{//they would only see the sampled intervals, or none of the run in this process
+		cout << (simpointEnabled ? "--simpoint" : "--parallel") << " cannot be combined with --debug, --cosim, --trace, --cache-sweep, --locality, --ilp or --speedup" << endl;
+		return 1;
+	}
+	if (debugging && (unitTiming || !inputName.empty() || pluginInstructionCount))
+	{//the units in flight, the input already read and the memory plugins write are not in the undo log
+		cout << "--debug cannot be combined with --units, --input or --plugin" << endl;
+		return 1;
+	}
+	if (debugging && (cosimEnabled || dataflow || baselines || !traceName.empty() || !cacheSweepName.empty() || !localityName.empty()))
+	{//stepping back and forth would show them the same instructions more than once
+		cout << "--debug cannot be combined with --cosim, --trace, --cache-sweep, --locality, --ilp or --speedup" << endl;
+		return 1;
+	}
 
-	//machineCompliler();
+	if (loadSource)
+	{//assemble a source file instead of reading bubble.machine
+		if (!loadAssembly(argv[2])) return 1;
+	}
+	else if (!loadImage && restoreName.empty()) assembler();
 
 	setup();
 
-	if (pipeline) pipelined();
-	else unpipelined();
+	if (loadImage)
+	{//program image, loaded after setup() so its data segment replaces the demo array
+		if (!loadProgramImage(argv[2])) return 1;
+		fetchInstruction(PC);
+	}
+	if (!restoreName.empty() && !restoreCheckpoint(restoreName)) return 1;
+	if (!loadDataFiles()) return 1;
+	if (fastForwardCount && !fastForward(fastForwardCount)) return 1;
+	if (!checkpointName.empty() && !saveCheckpoint(checkpointName)) return 1;
+	if (simpointEnabled) return runSimpoint() ? 0 : 1;
+	if (cosimEnabled) startCosim();
+	if (!traceName.empty() && !startTrace(traceName)) return 1;
+	if (!cacheSweepName.empty()) startCacheSweep(cacheSweepName);
+	if (!localityName.empty()) startLocality(localityName);
+	if (dataflow) startDataflow();
+	if (baselines && !startBaselines()) return 1;
+
+	if (parallelEnabled)
+	{
+		if (!runParallel(argv[0])) return 1;
+	}
+	else if (debugging) runDebugger();
+	else run();
+	if (!parallelEnabled) reportCounters(); //before finalize() reads data memory, the workers of a parallel run had the regions
+	finishDevices();
+	finishLocality();
+	finishTrace();
+	if (!cacheSweepName.empty()) finishCacheSweep();
+	if (dataflow) finishDataflow();
+	if (baselines) finishBaselines();
 
 	tend = time(0);
 	finalize(tend, tstart);
 
+	if (cosimEnabled)
+	{
+		bool matched = finishCosim();
+		cout << (matched ? "cosim: " + to_string(instructionsRetired) + " retirements matched the reference\n" : cosimReport);
+		if (!matched) return 1;
+	}
+
 	cin;
-	return 0;
+	return semihostExitCode;
 }
 
-void pipelined()
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////RUN LOOPS///////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//The mode flags are fixed for a whole run, so the step and the loop are instantiated once for each combination of pipelined,
+//checked against the co-simulation reference (cosimEnabled) and traced (traceRecording), and the tables below pick one when
+//the run starts. Inside an instantiation the flags are constants and the branches on them compile away. The stage functions
+//fetch(), decode(), execute() and writeback() still test the flags, for the replay and the microbenchmarks that call them
+//one at a time.
+
+template<bool Pipelined, bool Checked, bool Traced>
+void specializedStep()
 {
-	while (!endProgram)
-	{
-		fetch();
-		decode();
+	if (clockCycles < stallUntil)
+	{//stalled, the clock jumps
+		skipStall();
+		return;
+	}
+
+	if (Pipelined)
+	{//one clock cycle
+		fetchStage<true>();
+		decodeStage<true>();
 		forwarding();
-		execute();
-		writeback();
+		executeStage<true>();
+		writebackStage<true, Checked, Traced>();
 
 		//clockCycle();
 		clockCycles++;
 		cout << endl << endl << endl;
 		hazardCheck();
-
 	}
-}
-
-void unpipelined()
-{
-	while (!endProgram)
-	{
-		fetch();
+	else
+	{//one instruction, four clock cycles
+		fetchStage<false>();
 		//clockCycle();
 		clockCycles++;
-		decode();
+		decodeStage<false>();
 		//clockCycle();
 		clockCycles++;
-		execute();
+		executeStage<false>();
 		//clockCycle();
 		clockCycles++;
-		writeback();
+		writebackStage<false, Checked, Traced>();
 		//clockCycle();
 		clockCycles++;
 		cout << endl;
 	}
 }
 
+template<bool Pipelined, bool Checked, bool Traced>
+void specializedRun()
+{
+	while (!endProgram) specializedStep<Pipelined, Checked, Traced>();
+}
+
+typedef void(*ProcessorLoop)();
+
+const ProcessorLoop stepLoops[8] = {
+	specializedStep<false, false, false>, specializedStep<false, false, true>,
+	specializedStep<false, true, false>, specializedStep<false, true, true>,
+	specializedStep<true, false, false>, specializedStep<true, false, true>,
+	specializedStep<true, true, false>, specializedStep<true, true, true> };
+
+const ProcessorLoop runLoops[8] = {
+	specializedRun<false, false, false>, specializedRun<false, false, true>,
+	specializedRun<false, true, false>, specializedRun<false, true, true>,
+	specializedRun<true, false, false>, specializedRun<true, false, true>,
+	specializedRun<true, true, false>, specializedRun<true, true, true> };
+
+int checkedTraced()
+{//low two bits of the table index
+	return (cosimEnabled ? 2 : 0) + (traceRecording ? 1 : 0);
+}
+
+void pipelined()
+{
+	runLoops[4 + checkedTraced()]();
+}
+
+void unpipelined()
+{
+	runLoops[checkedTraced()]();
+}
+
+void pipelinedStep()
+{//one clock cycle
+	stepLoops[4 + checkedTraced()]();
+}
+
+void unpipelinedStep()
+{//one instruction, four clock cycles
+	stepLoops[checkedTraced()]();
+}
+
+void stepProcessor()
+{
+	if (pipeline) pipelinedStep();
+	else unpipelinedStep();
+}
+
+void run()
+{
+	if (pipeline) pipelined();
+	else unpipelined();
+}
+
+void resetSimulator()
+{//returns the processor to its power on state so another program can be loaded and run
+	PC = 1;
+	SP = 1;
+	clockCycles = 0;
+	endProgram = 0;
+	instructionsRetired = 0;
+
+	negativeFlag = false;
+	zeroFlag = false;
+	overflowFlag = false;
+	carryFlag = false;
+	branched = false;
+	concurrentHazardn = false;
+	concurrentHazardt = false;
+	concurrentHazardm = false;
+	storeFlag = false;
+	loadFlag = false;
+	atomic = false;
+
+	decodeVars = noOP;
+	executeVars = noOP;
+	writebackVars = noOP;
+	fetchVars = "";
+	fetchLocation = 0;
+	clearStall();
+	resetUnits();
+	resetDevices();
+	resetSemihosting();
+	idleCyclesSkipped = 0;
+	resetCounters();
+	unloadProgramImage();
+
+	registers.fill(0);
+	for (VectorRegister &vector : vectorRegisters) vector.fill(0);
+	memory.fill("");
+	dataMemory.fill(0);
+}
+
+class NullBuffer : public streambuf
+{//swallows everything written to it, used to silence the per stage output
+protected:
+	int overflow(int c) { return c; }
+	streamsize xsputn(const char *, streamsize n) { return n; }
+};
+
+void quietOutput(bool quiet)
+{
+	static NullBuffer nullBuffer;
+	static streambuf *consoleBuffer = cout.rdbuf();
+
+	if (quiet) cout.rdbuf(&nullBuffer);
+	else cout.rdbuf(consoleBuffer);
+}
+
 void forwarding()
 {
 	if (concurrentHazardn && writebackVars.format != 'D') executeVars._Rn = writebackVars._Rd;
@@ -199,14 +433,15 @@ void hazardCheck()
 		executeVars._Rm = registers.at(executeVars.Rm);
 		executeVars._Rn = registers.at(executeVars.Rn);
 		executeVars._Rt = registers.at(executeVars.Rt);
-		fetchVars = memory.at(PC);
+		fetchInstruction(PC);
 		if ((decodeVars.Rn == executeVars.Rd))
 			concurrentHazardn = true;
 		if ((decodeVars.Rm == executeVars.Rd))
 			concurrentHazardm = true;
 	}
 	else if (branched)
-	{
+	{//the instructions fetched behind a taken branch are flushed
+		branchMispredicts++;
 		executeVars._Rd = registers.at(decodeVars.Rd);
 		executeVars._Rt = registers.at(decodeVars.Rt);
 		executeVars._Rm = registers.at(executeVars.Rm);
@@ -214,7 +449,7 @@ void hazardCheck()
 		writebackVars = executeVars;
 		executeVars = noOP;
 		decodeVars = noOP;
-		fetchVars = memory.at(PC);
+		fetchInstruction(PC);
 		branched = false;
 
 	}
@@ -227,7 +462,7 @@ void hazardCheck()
 		executeVars._Rm = registers.at(executeVars.Rm);
 		executeVars._Rn = registers.at(executeVars.Rn);
 		executeVars._Rt = registers.at(executeVars.Rt);
-		fetchVars = memory.at(PC);
+		fetchInstruction(PC);
 
 	}
 
@@ -239,7 +474,7 @@ void hazardCheck()
 		executeVars._Rm = registers.at(executeVars.Rm);
 		executeVars._Rn = registers.at(executeVars.Rn);
 		executeVars._Rt = registers.at(executeVars.Rt);
-		fetchVars = memory.at(PC);
+		fetchInstruction(PC);
 	}
 }
 
@@ -251,10 +486,13 @@ void setup()
 	//////////////////////////////USER DEFINED CODE///////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	for (int i = 0; i < 10; i++)
+	if (dataLoads.empty()) //--data files replace the demo array
 	{
-		unSorted[i] = rand() % 100;
-		storeDataMemory(unSorted[i], 8 * i, 8);
+		for (int i = 0; i < 10; i++)
+		{
+			unSorted[i] = rand() % 100;
+			storeDataMemory(unSorted[i], 8 * i, 8);
+		}
 	}
 	cout << endl;
 
@@ -282,7 +520,7 @@ void setup()
 		cout << endl;
 	}
 
-	fetchVars = memory.at(PC);
+	fetchInstruction(PC);
 }
 
 void finalize(time_t tend, time_t tstart)
@@ -291,28 +529,35 @@ void finalize(time_t tend, time_t tstart)
 	//////////////////////////////USER DEFINED CODE///////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	cout << "Before   After" << endl;
-	for (int i = 0; i < 10; i++)
+	if (dataLoads.empty())
 	{
-		int temp;
-		cout << setw(4) << unSorted[i] << "     " << setw(4) << loadDataMemory(i * 8, 8) << endl;
+		cout << "Before   After" << endl;
+		for (int i = 0; i < 10; i++)
+		{
+			int temp;
+			cout << setw(4) << unSorted[i] << "     " << setw(4) << loadDataMemory(i * 8, 8) << endl;
+		}
 	}
 
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////
 	//////////////////////////////USER DEFINED CODE///////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////
 	cout << "Clock Cycles: " << clockCycles << " Time Taken: " << difftime(tend, tstart) << " seconds" << endl;
+	if (idleCyclesSkipped) cout << "Stalled cycles skipped: " << idleCyclesSkipped << endl;
+	if (unitTiming && !parallelEnabled) reportUnits(); //the stalls of a parallel run happened in its workers
+	dumpDataFiles();
 
 }
 
-void fetch()
+template<bool Pipelined>
+void fetchStage()
 {
-	if (!pipeline)
+	if (!Pipelined)
 	{
-		fetchVars = memory.at(PC);
+		fetchInstruction(PC);
 	}
 
-	string border = "==================================Fetch======================================";
+	const char *border = "==================================Fetch======================================";
 
 	cout << border << endl;
 	cout << "PC is at " << PC << endl;
@@ -321,42 +566,74 @@ void fetch()
 
 }
 
-void decode()
+void fetch()
 {
-	if (!pipeline)
+	if (pipeline) fetchStage<true>();
+	else fetchStage<false>();
+}
+
+void fetchInstruction(int location)
+{//reads from a mapped program image when one is loaded, otherwise from instruction memory
+	if (localityEnabled) localityFetch(location);
+	if (((size_t)location < breakpointMap.size()) && breakpointMap[location]) breakpointPending = location;
+	if (imageText && (location >= 1) && (location <= imageTextWords))
+	{//written in place, so the string keeps its buffer from one fetch to the next
+		fetchVars.resize(32);
+		for (int bit = 0; bit < 32; bit++) fetchVars[bit] = ((imageText[location - 1] >> (31 - bit)) & 1) ? '1' : '0';
+	}
+	else if (!imageText && (location >= 0) && ((size_t)location < memory.size()))
+		fetchVars = memory[location];
+	else
+		fetchVars.clear(); //past the end of the program, as the fetch after EXIT reads when it is the last word, a bubble
+	fetchLocation = location;
+}
+
+template<bool Pipelined>
+void decodeStage()
+{
+	if (!Pipelined)
 	{
 		executeVars = decodeVars;
 	}
 
-	string border = "==================================Decode=====================================";
-
-	/////////////////////////////////////////////////////
-	decodeVars.format = 'X'; //clear op code
-
-	if (decodeVars.format == 'X')
-		decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 5, 1, 0);
-	if (decodeVars.format == 'X')
-		decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 7, 1, 0);
-	if (decodeVars.format == 'X')
-		decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 8, 1, 0);
-	if (decodeVars.format == 'X')
-		decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 9, 1, 0);
-	if (decodeVars.format == 'X')
-		decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 10, 1, 0);
-	/////////////////////////////////////////////////////
-
-	decodeVars.Rd = convertBinaryStringToInt(fetchVars, 27, 31, 0, 0);
-	decodeVars.Rn = convertBinaryStringToInt(fetchVars, 22, 26, 0, 0);
-	decodeVars.Rm = convertBinaryStringToInt(fetchVars, 11, 15, 0, 0);
-	decodeVars.Rt = convertBinaryStringToInt(fetchVars, 27, 31, 0, 0);
-	decodeVars.shamt = convertBinaryStringToInt(fetchVars, 16, 21, 0, 0);
-	decodeVars.ALU_immediate = convertBinaryStringToInt(fetchVars, 10, 21, 0, 1);
-	decodeVars.op = convertBinaryStringToInt(fetchVars, 20, 21, 0, 0);
-	decodeVars.BR_address = convertBinaryStringToInt(fetchVars, 6, 31, 0, 1);
-	decodeVars.COND_BR_address = convertBinaryStringToInt(fetchVars, 8, 26, 0, 1);
-	decodeVars.MOV_immediate = convertBinaryStringToInt(fetchVars, 11, 19, 0, 0);
-	decodeVars.DT_address = convertBinaryStringToInt(fetchVars, 11, 19, 0, 1);
-	decodeVars.LSL = convertBinaryStringToInt(fetchVars, 9, 10, 0, 0);
+	const char *border = "==================================Decode=====================================";
+
+	if (imageDecoded && (fetchLocation >= 1) && (fetchLocation <= imageTextWords))
+	{//the program image carries this instruction already decoded, copy the fields instead of parsing the string
+		copyDecoded(imageDecoded[fetchLocation - 1], decodeVars);
+	}
+	else
+	{
+		/////////////////////////////////////////////////////
+		decodeVars.format = 'X'; //clear op code
+
+		if (decodeVars.format == 'X')
+			decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 5, 1, 0);
+		if (decodeVars.format == 'X')
+			decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 7, 1, 0);
+		if (decodeVars.format == 'X')
+			decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 8, 1, 0);
+		if (decodeVars.format == 'X')
+			decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 9, 1, 0);
+		if (decodeVars.format == 'X')
+			decodeVars.opcode = convertBinaryStringToInt(fetchVars, 0, 10, 1, 0);
+		/////////////////////////////////////////////////////
+
+		decodeVars.Rd = convertBinaryStringToInt(fetchVars, 27, 31, 0, 0);
+		decodeVars.Rn = convertBinaryStringToInt(fetchVars, 22, 26, 0, 0);
+		decodeVars.Rm = convertBinaryStringToInt(fetchVars, 11, 15, 0, 0);
+		decodeVars.Rt = convertBinaryStringToInt(fetchVars, 27, 31, 0, 0);
+		decodeVars.shamt = convertBinaryStringToInt(fetchVars, 16, 21, 0, 0);
+		decodeVars.ALU_immediate = convertBinaryStringToInt(fetchVars, 10, 21, 0, 1);
+		decodeVars.op = convertBinaryStringToInt(fetchVars, 20, 21, 0, 0);
+		decodeVars.BR_address = convertBinaryStringToInt(fetchVars, 6, 31, 0, 1);
+		decodeVars.COND_BR_address = convertBinaryStringToInt(fetchVars, 8, 26, 0, 1);
+		decodeVars.MOV_immediate = convertBinaryStringToInt(fetchVars, 11, 19, 0, 0);
+		decodeVars.DT_address = convertBinaryStringToInt(fetchVars, 11, 19, 0, 1);
+		decodeVars.LSL = convertBinaryStringToInt(fetchVars, 9, 10, 0, 0);
+	}
+	if ((decodeVars.format == 'X') && pluginInstructionCount) decodeVars.format = pluginFormat(decodeVars.opcode); //plugins.cpp
+	decodeVars.location = fetchLocation;
 
 	cout << border << endl;
 	cout << decodeVars << endl;
@@ -365,9 +642,16 @@ void decode()
 	//cout << decodeVars;
 }
 
-void execute()
+void decode()
+{
+	if (pipeline) decodeStage<true>();
+	else decodeStage<false>();
+}
+
+template<bool Pipelined>
+void executeStage()
 {
-	if (!pipeline)
+	if (!Pipelined)
 	{
 		executeVars = decodeVars;
 		executeVars._Rd = registers.at(executeVars.Rd);
@@ -375,8 +659,9 @@ void execute()
 		executeVars._Rn = registers.at(executeVars.Rn);
 		executeVars._Rt = registers.at(executeVars.Rt);
 	}
+	if (unitTiming && executeVars.opcode) issueInstruction(executeVars);
 
-	string border = "==================================Excecute===================================";
+	const char *border = "==================================Excecute===================================";
 
 	//use opcode to determine operation
 	switch (executeVars.opcode)
@@ -385,7 +670,7 @@ void execute()
 		case//B
 			0b000101: {/* Format = 'B*/
 			PC = PC + executeVars.BR_address; //the -1 accounts for the next fetch increment of PC
-			if (pipeline) PC -= 2; //2 additional cycles have passed because of pipeline
+			if (Pipelined) PC -= 2; //2 additional cycles have passed because of pipeline
 			else PC -= 1;
 			cout << border << endl;
 			cout << "Executing unconditional break to PC: " << executeVars.BR_address << endl;
@@ -406,7 +691,7 @@ void execute()
 					if (zeroFlag)
 					{
 						PC = PC + executeVars.COND_BR_address;
-						if (pipeline) PC -= 2;
+						if (Pipelined) PC -= 2;
 						else PC -= 1;
 						clearFlags();
 						cout << border << endl;
@@ -424,7 +709,7 @@ void execute()
 					if (!(zeroFlag))
 					{
 						PC = PC + executeVars.COND_BR_address;
-						if (pipeline) PC -= 2;
+						if (Pipelined) PC -= 2;
 						else PC -= 1;
 						clearFlags();
 						cout << border << endl;
@@ -442,7 +727,7 @@ void execute()
 					if (negativeFlag != overflowFlag)
 					{
 						PC = PC + executeVars.COND_BR_address;
-						if (pipeline) PC -= 2;
+						if (Pipelined) PC -= 2;
 						else PC -= 1;
 						clearFlags();
 						cout << border << endl;
@@ -460,7 +745,7 @@ void execute()
 					if (zeroFlag || (negativeFlag != overflowFlag))
 					{
 						PC = PC + executeVars.COND_BR_address;
-						if (pipeline) PC -= 2;
+						if (Pipelined) PC -= 2;
 						else PC -= 1;
 						clearFlags();
 						cout << border << endl;
@@ -478,7 +763,7 @@ void execute()
 					if ((!zeroFlag) && (negativeFlag == overflowFlag))
 					{
 						PC = PC + executeVars.COND_BR_address;
-						if (pipeline) PC -= 2;
+						if (Pipelined) PC -= 2;
 						else PC -= 1;
 						clearFlags();
 						cout << border << endl;
@@ -496,7 +781,7 @@ void execute()
 					if (negativeFlag == overflowFlag)
 					{
 						PC = PC + executeVars.COND_BR_address;
-						if (pipeline) PC -= 2;
+						if (Pipelined) PC -= 2;
 						else PC -= 1;
 						clearFlags();
 						cout << border << endl;
@@ -550,11 +835,15 @@ void execute()
 			break; }
 		case//BL
 			0b100101: {/* Format = 'B*/
-			registers.at(30) = PC + 1;
+			//link to the instruction after the BL, PC has already moved past it by the same amount a branch corrects for
+			if (Pipelined) registers.at(30) = PC - 1;
+			else registers.at(30) = PC;
 			PC = PC + executeVars.BR_address;
+			if (Pipelined) PC -= 2;
+			else PC -= 1;
 			cout << border << endl;
-			cout << "Storing Link Register from current PC: PC = " << PC + 1 << endl;
-			cout << "PC is now " << PC + executeVars.BR_address;
+			cout << "Storing Link Register from current PC: PC = " << registers.at(30) << endl;
+			cout << "PC is now " << PC << endl;
 			cout << border << endl;
 			branched = true;
 			break; }
@@ -653,7 +942,7 @@ void execute()
 			0b10110100: {/* Format = 'C*/
 			if (executeVars._Rt == 0) {
 				PC = PC + executeVars.COND_BR_address;
-				if (pipeline) PC -= 2;
+				if (Pipelined) PC -= 2;
 				else PC -= 1;
 				cout << border << endl;
 				cout << "Executing Compare & Branch if Zero on value in register " << executeVars.Rt << endl;
@@ -672,7 +961,7 @@ void execute()
 			0b10110101: {/* Format = 'C*/
 			if (executeVars._Rt != 0) {
 				PC = PC + executeVars.COND_BR_address;
-				if (pipeline) PC -= 2;
+				if (Pipelined) PC -= 2;
 				else PC -= 1;
 				cout << border << endl;
 				cout << "Executing Compare & Branch if Not Zero on value in register  " << executeVars.Rt << endl;
@@ -897,23 +1186,60 @@ void execute()
 			cout << "Executing MOVZ" << endl;
 			cout << border << endl;
 			break; }
+		case//STUR Q, LDUR Q, vector operations and reductions
+			0b11111111000: case 0b11111111001: case 0b11111111010: case 0b11111111011: {/* Custom OPCODES - simd.cpp */
+			executeVector();
+			break; }
+		case//MARK
+			0b11111111100: {/* Format = 'R' Custom OPCODE - start a counter region, counters.cpp */
+			markRegion(executeVars.shamt);
+			cout << border << endl;
+			cout << "Executing MARK, region " << executeVars.shamt << endl;
+			cout << border << endl;
+			break; }
+		case//MRS
+			0b11111111101: {/* Format = 'R' Custom OPCODE - read a performance counter, counters.cpp */
+			executeVars._Rd = readCounter(executeVars.shamt);
+			cout << border << endl;
+			cout << "Executing MRS, counter " << executeVars.shamt << " is " << executeVars._Rd << endl;
+			cout << border << endl;
+			break; }
+		case//SVC
+			0b11111111110: {/* Format = 'R' Custom OPCODE - host call, semihost.cpp */
+			executeVars._Rd = semihostCall(executeVars.shamt);
+			cout << border << endl;
+			cout << "Executing SVC " << executeVars.shamt << ", the result is " << executeVars._Rd << endl;
+			cout << border << endl;
+			break; }
 		case
 			0b11111111111: {/* Format = 'X' Custom OPCODE - EXIT PROGRAM */
 			endProgram = 1;
 			break; }
-		default:  cout << border << endl << "No data to be executed" << endl << border << endl;   break;
+		default:
+			if (pluginInstructionCount && executePlugin()) break; //an opcode of a plugin, plugins.cpp
+			cout << border << endl << "No data to be executed" << endl << border << endl;   break;
 	}
 
 }
 
-void writeback()
+void execute()
 {
-	if (!pipeline)
+	if (pipeline) executeStage<true>();
+	else executeStage<false>();
+}
+
+template<bool Pipelined, bool Checked, bool Traced>
+void writebackStage()
+{
+	if (!Pipelined)
 	{
 		writebackVars = executeVars;
 	}
 
-	string border = "==================================WriteBack==================================";
+	const char *border = "==================================WriteBack==================================";
+
+	bool retired = (writebackVars.format != 'X') && (writebackVars.opcode != 0); //bubbles carry opcode 0
+	if (retired) instructionsRetired++;
 
 
 	/*
@@ -925,7 +1251,8 @@ void writeback()
 	W - Opcode, MOV_immediate, Rd
 	*/
 
-	if ((writebackVars.format == 'R') || (writebackVars.format == 'I'))
+	//bubbles are written as format 'R' by hazardCheck() and BR holds its target in the Rd field, neither writes a register
+	if (retired && ((writebackVars.format == 'R') || (writebackVars.format == 'I')) && (writebackVars.opcode != 0b11010110000))
 	{
 		registers.at(writebackVars.Rd) = writebackVars._Rd;
 		cout << border << endl;
@@ -939,6 +1266,19 @@ void writeback()
 	}
 
 	cout << border << endl;
+	if (Checked && retired) checkRetirement();
+	if (Traced && retired) recordRetirement();
+}
+
+const ProcessorLoop writebackStages[8] = {
+	writebackStage<false, false, false>, writebackStage<false, false, true>,
+	writebackStage<false, true, false>, writebackStage<false, true, true>,
+	writebackStage<true, false, false>, writebackStage<true, false, true>,
+	writebackStage<true, true, false>, writebackStage<true, true, true> };
+
+void writeback()
+{
+	writebackStages[(pipeline ? 4 : 0) + checkedTraced()]();
 }
 
 string signExtend(string binary, int stringStart, int totalSize)
@@ -971,45 +1311,20 @@ void storeDataMemory(int data, int location, int size)
  //array<unsigned char, 8> dataMemory
  //Common Usage
  //storeDataMemory(executeVars._Rt, (executeVars.DT_address + executeVars._Rn), size)
-
-
-	string temp = convertIntToBinaryString(data);
-	array<unsigned char, 8> bytes;
-
-	if (size == 8)
-	{
-		bytes[0] = convertBinaryStringToInt(temp, 56, 63, 0, 0);
-		bytes[1] = convertBinaryStringToInt(temp, 48, 55, 0, 0);
-		bytes[2] = convertBinaryStringToInt(temp, 40, 47, 0, 0);
-		bytes[3] = convertBinaryStringToInt(temp, 32, 39, 0, 0);
-		bytes[4] = convertBinaryStringToInt(temp, 24, 31, 0, 0);
-		bytes[5] = convertBinaryStringToInt(temp, 16, 23, 0, 0);
-		bytes[6] = convertBinaryStringToInt(temp, 8, 15, 0, 0);
-		bytes[7] = convertBinaryStringToInt(temp, 0, 7, 0, 0);
-	}
-
-	if (size == 4)
-	{
-		bytes[0] = convertBinaryStringToInt(temp, 24, 31, 0, 0);
-		bytes[1] = convertBinaryStringToInt(temp, 16, 23, 0, 0);
-		bytes[2] = convertBinaryStringToInt(temp, 8, 15, 0, 0);
-		bytes[3] = convertBinaryStringToInt(temp, 0, 7, 0, 0);
-	}
-
-	if (size == 2)
-	{
-		bytes[0] = convertBinaryStringToInt(temp, 8, 15, 0, 0);
-		bytes[1] = convertBinaryStringToInt(temp, 0, 7, 0, 0);
-	}
-
-	if (size == 1)
-	{
-		bytes[0] = convertBinaryStringToInt(temp, 0, 7, 0, 0);
+	if ((unsigned int)location > (unsigned int)(deviceBase - size))
+	{//devices.cpp, negative locations and accesses running past the end of data memory included
+		deviceStore(data, location, size);
+		return;
 	}
+	dataAccesses++;
+	if (localityEnabled) localityDataAccess(location, size);
+	if (historyEnabled) historyDataWrite(location, size);
+	if (watchTags[((unsigned int)location >> watchPageShift) % watchTags.size()] & watchWrite) watchAccess(location, size, true);
 
+	//little endian, the int sign extended to 64 bits as convertIntToBinaryString() extends it
 	for (int i = 0; i < size; i++)
 	{
-		dataMemory[location + i] = bytes[i];
+		dataMemory[location + i] = (unsigned char)((long long)data >> (8 * i));
 	}
 }
 
@@ -1017,16 +1332,19 @@ int loadDataMemory(int location, int size)
 {
 	//loadDataMemory(executeVars._Rt, (executeVars._Rn + executeVars.DT_address), size) 
 	//load data into executeVars._Rt 
-
-	string combined;
-	unsigned char tempChar;
-	for (int i = size-1; i >= 0; i--)
+	if ((unsigned int)location > (unsigned int)(deviceBase - size)) return deviceLoad(location, size); //as storeDataMemory() routes them
+	dataAccesses++;
+	if (localityEnabled) localityDataAccess(location, size);
+	if (watchTags[((unsigned int)location >> watchPageShift) % watchTags.size()] & watchRead) watchAccess(location, size, false);
+
+	//little endian, sign extended from the size loaded
+	long long value = 0;
+	for (int i = size - 1; i >= 0; i--)
 	{
-		tempChar = dataMemory[location + i];
-		combined = combined + (convertIntToBinaryString(tempChar)).substr(56, 8);
+		value = (value << 8) | dataMemory[location + i];
 	}
-
-	return convertBinaryStringToInt(combined, 0, (size*8)-1, 0, 1);
+	if ((size < 8) && (value >> (8 * size - 1))) value -= 1LL << (8 * size);
+	return (int)value;
 }
 
 string convertIntToBinaryString(int integer)
@@ -1073,15 +1391,16 @@ void readSimpleData()
 	registers.at(executeVars.Rt) = executeVars._Rt;
 }
 
-int convertBinaryStringToInt(string machineCode, int start, int end, int findFormat, int checkNegative)
+int convertBinaryStringToInt(const string &machineCode, int start, int end, int findFormat, int checkNegative)
 {
 	bool negative = false;
-	char variable[64];
+	char variable[65];
 	char *varPtr = &variable[0];
 	if (checkNegative)
 		fill(variable, variable + 64, machineCode[start]);
 	else
 		fill(variable, variable + 64, '0');
+	variable[64] = '\0'; //strtol needs the terminator, without it the read runs off the end of the buffer
 	char* endptr;
 	long int variableInt;
 	int length = end - start;
@@ -1214,6 +1533,20 @@ int convertBinaryStringToInt(string machineCode, int start, int end, int findFor
 					0b11111100000: {format = 'R';  break; }
 				case//LDURD
 					0b11111100010: {format = 'R';  break; }
+				case//STUR Q
+					0b11111111000: {format = 'D';  break; }
+				case//LDUR Q
+					0b11111111001: {format = 'D';  break; }
+				case//vector operations
+					0b11111111010: {format = 'V';  break; }
+				case//vector reductions
+					0b11111111011: {format = 'R';  break; }
+				case//MARK
+					0b11111111100: {format = 'R';  break; }
+				case//MRS
+					0b11111111101: {format = 'R';  break; }
+				case//SVC
+					0b11111111110: {format = 'R';  break; }
 				default: {format = 'X'; break; }
 			}
 			decodeVars.format = format;
@@ -1263,47 +1596,59 @@ void clockCycle()
 	return;
 }
 
+struct BinaryDigits
+{//the low width bits of a value written as bitset writes them, without building a string
+	unsigned int value;
+	int width;
+};
+
+ostream& operator << (ostream& out_str, BinaryDigits digits)
+{
+	for (int bit = digits.width - 1; bit >= 0; bit--) out_str.put(((digits.value >> bit) & 1) ? '1' : '0');
+	return out_str;
+}
+
 ostream& operator << (ostream& out_str, const Instructions& output)
 {
-	if (decodeVars.format == 'R')
+	if ((decodeVars.format == 'R') || (decodeVars.format == 'V'))
 	{
-		out_str << "Opcode: " << bitset<11>(decodeVars.opcode) << endl
-			<< "Rm: " << bitset<5>(decodeVars.Rm) << endl
-			<< "shamt: " << bitset<6>(decodeVars.shamt) << endl
-			<< "Rn: " << bitset<5>(decodeVars.Rn) << endl
-			<< "Rd: " << bitset<5>(decodeVars.Rd) << endl;
+		out_str << "Opcode: " << BinaryDigits{ (unsigned int)decodeVars.opcode, 11 } << endl
+			<< "Rm: " << BinaryDigits{ (unsigned int)decodeVars.Rm, 5 } << endl
+			<< "shamt: " << BinaryDigits{ (unsigned int)decodeVars.shamt, 6 } << endl
+			<< "Rn: " << BinaryDigits{ (unsigned int)decodeVars.Rn, 5 } << endl
+			<< "Rd: " << BinaryDigits{ (unsigned int)decodeVars.Rd, 5 } << endl;
 	}
 	else if (decodeVars.format == 'I')
 	{
-		out_str << "Opcode: " << bitset<10>(decodeVars.opcode) << endl
-			<< "ALU_immediate: " << bitset<12>(decodeVars.ALU_immediate) << endl
-			<< "Rn: " << bitset<5>(decodeVars.Rn) << endl
-			<< "Rd: " << bitset<5>(decodeVars.Rd) << endl;
+		out_str << "Opcode: " << BinaryDigits{ (unsigned int)decodeVars.opcode, 10 } << endl
+			<< "ALU_immediate: " << BinaryDigits{ (unsigned int)decodeVars.ALU_immediate, 12 } << endl
+			<< "Rn: " << BinaryDigits{ (unsigned int)decodeVars.Rn, 5 } << endl
+			<< "Rd: " << BinaryDigits{ (unsigned int)decodeVars.Rd, 5 } << endl;
 	}
 	else if (decodeVars.format == 'D')
 	{
-		out_str << "Opcode: " << bitset<11>(decodeVars.opcode) << endl
-			<< "DT_address: " << bitset<9>(decodeVars.Rm) << endl
-			<< "op: " << bitset<2>(decodeVars.op) << endl
-			<< "Rn: " << bitset<5>(decodeVars.Rn) << endl
-			<< "Rt: " << bitset<5>(decodeVars.Rt) << endl;
+		out_str << "Opcode: " << BinaryDigits{ (unsigned int)decodeVars.opcode, 11 } << endl
+			<< "DT_address: " << BinaryDigits{ (unsigned int)decodeVars.Rm, 9 } << endl
+			<< "op: " << BinaryDigits{ (unsigned int)decodeVars.op, 2 } << endl
+			<< "Rn: " << BinaryDigits{ (unsigned int)decodeVars.Rn, 5 } << endl
+			<< "Rt: " << BinaryDigits{ (unsigned int)decodeVars.Rt, 5 } << endl;
 	}
 	else if (decodeVars.format == 'B')
 	{
-		out_str << "Opcode: " << bitset<6>(decodeVars.opcode) << endl
-			<< "BR_address: " << bitset<5>(decodeVars.BR_address) << endl;
+		out_str << "Opcode: " << BinaryDigits{ (unsigned int)decodeVars.opcode, 6 } << endl
+			<< "BR_address: " << BinaryDigits{ (unsigned int)decodeVars.BR_address, 5 } << endl;
 	}
 	else if (decodeVars.format == 'C')
 	{
-		out_str << "Opcode: " << bitset<8>(decodeVars.opcode) << endl
-			<< "COND_BR_address: " << bitset<19>(decodeVars.COND_BR_address) << endl
-			<< "Rt: " << bitset<5>(decodeVars.Rt) << endl;
+		out_str << "Opcode: " << BinaryDigits{ (unsigned int)decodeVars.opcode, 8 } << endl
+			<< "COND_BR_address: " << BinaryDigits{ (unsigned int)decodeVars.COND_BR_address, 19 } << endl
+			<< "Rt: " << BinaryDigits{ (unsigned int)decodeVars.Rt, 5 } << endl;
 	}
 	else if (decodeVars.format == 'W')
 	{
-		out_str << "Opcode: " << bitset<11>(decodeVars.opcode) << endl
-			<< "MOV_immediate: " << bitset<16>(decodeVars.MOV_immediate) << endl
-			<< "Rd: " << bitset<5>(decodeVars.Rd) << endl;
+		out_str << "Opcode: " << BinaryDigits{ (unsigned int)decodeVars.opcode, 11 } << endl
+			<< "MOV_immediate: " << BinaryDigits{ (unsigned int)decodeVars.MOV_immediate, 16 } << endl
+			<< "Rd: " << BinaryDigits{ (unsigned int)decodeVars.Rd, 5 } << endl;
 	}
 	else
 	{
@@ -1356,318 +1701,6 @@ void checkFlags()
 	cout << "Carry flag" << carryFlag << endl;
 }
 
-void machineCompliler()
-{
-		map<string, int> instruction;
-
-		instruction["B"] = 0b000101;
-		instruction["FMULS"] = 0b00011110001;
-		instruction["FDIVS"] = 0b00011110001;
-		instruction["FCMPS"] = 0b00011110001;
-		instruction["FADDS"] = 0b00011110001;
-		instruction["FSUBS"] = 0b00011110001;
-		instruction["FMULD"] = 0b00011110001;
-		instruction["FDIVD"] = 0b00011110001;
-		instruction["FDIVD"] = 0b00011110001;
-		instruction["FCMPD"] = 0b00011110001;
-		instruction["FADDD"] = 0b00011110001;
-		instruction["FSUBD"] = 0b00011110001;
-		instruction["STURB"] = 0b00111000000;
-		instruction["LDURB"] = 0b00111000010;
-		instruction["BCOND"] = 0b01010100;
-		instruction["STURH"] = 0b01111000000;
-		instruction["LDURH"] = 0b01111000010;
-		instruction["AND"] = 0b10001010000;
-		instruction["ADD"] = 0b10001011000;
-		instruction["ADDI"] = 0b1001000100;
-		instruction["ANDI"] = 0b1001001000;
-		instruction["BL"] = 0b100101;
-		instruction["SDIV"] = 0b10011010110;
-		instruction["UDIV"] = 0b10011010110;
-		instruction["MUL"] = 0b10011011000;
-		instruction["SMULH"] = 0b10011011010;
-		instruction["UMULH"] = 0b10011011110;
-		instruction["ORR"] = 0b10101010000;
-		instruction["ADDS"] = 0b10101011000;
-		instruction["ADDIS"] = 0b1011000100;
-		instruction["ORRI"] = 0b1011001000;
-		instruction["CBZ"] = 0b10110100;
-		instruction["CBNZ"] = 0b10110101;
-		instruction["STURW"] = 0b10111000000;
-		instruction["LDURSW"] = 0b10111000100;
-		instruction["STURS"] = 0b10111100000;
-		instruction["LDURS"] = 0b10111100010;
-		instruction["STXR"] = 0b11001000000;
-		instruction["LDXR"] = 0b11001000010;
-		instruction["EOR"] = 0b11001010000;
-		instruction["SUB"] = 0b11001011000;
-		instruction["SUBI"] = 0b1101000100;
-		instruction["EORI"] = 0b1101001000;
-		instruction["MOVZ"] = 0b110100101;
-		instruction["LSR"] = 0b11010011010;
-		instruction["LSL"] = 0b11010011011;
-		instruction["BR"] = 0b11010110000;
-		instruction["ANDS"] = 0b11101010000;
-		instruction["SUBS"] = 0b11101011000;
-		instruction["SUBIS"] = 0b1111000100;
-		instruction["ANDIS"] = 0b1111001000;
-		instruction["MOVK"] = 0b111100101;
-		instruction["STUR"] = 0b11111000000;
-		instruction["LDUR"] = 0b11111000010;
-		instruction["STURD"] = 0b11111100000;
-		instruction["LDURD"] = 0b11111100010;
-		instruction["EXIT"] = 0b11111111111;
-
-		instruction["X0"] = 0;
-		instruction["X1"] = 1;
-		instruction["X2"] = 2;
-		instruction["X3"] = 3;
-		instruction["X4"] = 4;
-		instruction["X5"] = 5;
-		instruction["X6"] = 6;
-		instruction["X7"] = 7;
-		instruction["X8"] = 8;
-		instruction["X9"] = 9;
-		instruction["X10"] = 10;
-		instruction["X11"] = 11;
-		instruction["X12"] = 12;
-		instruction["X13"] = 13;
-		instruction["X14"] = 14;
-		instruction["X15"] = 15;
-		instruction["X16"] = 16;
-		instruction["X17"] = 17;
-		instruction["X18"] = 18;
-		instruction["X19"] = 19;
-		instruction["X20"] = 20;
-		instruction["X21"] = 21;
-		instruction["X22"] = 22;
-		instruction["X23"] = 23;
-		instruction["X24"] = 24;
-		instruction["X25"] = 25;
-		instruction["X26"] = 26;
-		instruction["X27"] = 27;
-		instruction["X28"] = 28;
-		instruction["X29"] = 29;
-		instruction["X30"] = 30;
-		instruction["X31"] = 31;
-
-		instruction["SP"] = 28;
-		instruction["FP"] = 29;
-		instruction["LR"] = 30;
-		instruction["ZR"] = 31;
-
-		ifstream infile;
-		infile.open("bubble.assembly");
-		int memoryLocation = 1;
-
-		string assembly;
-		string machineCode;
-
-		while (getline(infile, assembly)) // To get you all the lines.
-		{
-			int i = 0;
-			int j = 0;
-			string temp;
-			char format = 'X';
-			bool first, second, third, fourth;
-
-			first = false;
-			second = false;
-			third = false;
-			fourth = false;
-
-			int linelength = 0;
-
-			while (assembly[i] != '\0')
-			{
-				j = 0;
-				linelength = 0;
-				while (assembly[j] != '\0')
-				{
-					linelength++;
-					j++;
-				}
-
-				if ((assembly[i] == 32) && (!first))
-				{
-					first = true;
-					temp = assembly.substr(0, i);
-					auto search = instruction.find(temp);
-					if (search != instruction.end())
-					{
-						format = findFormat(search->second);
-						assemble.opcode = search->second;
-						assemble.format = format;
-					}
-					else
-						cout << "Format Error!" << endl;
-				}
-				if ((assembly[i] == 44) && format == 'R')
-				{
-
-					auto search = instruction.find(assembly.substr(i - 2, 2));
-					if (search != instruction.end())
-					{
-						if (!second)
-						{
-							second = true;
-							assemble.Rd = search->second;
-						}
-						else if (second && !third)
-						{
-							third = true;
-							assemble.Rn = search->second;
-						}
-						else if (third && !fourth)
-						{
-							fourth = true;
-							assemble.Rm = search->second;
-						}
-					}
-					else assemble.shamt = stoi(assembly.substr(i - 2, linelength -i - 2));
-				}
-				if ((assembly[i] == 44) && format == 'I')
-				{
-					auto search = instruction.find(assembly.substr(i - 2, 2));
-					if (search != instruction.end())
-					{
-						if (!second)
-						{
-							second = true;
-							assemble.Rd = search->second;
-						}
-						else if (second && !third)
-						{
-							third = true;
-							assemble.Rn = search->second;
-						}
-					}
-					else
-					{
-						assemble.ALU_immediate = stoi(assembly.substr(i + 2, linelength - i - 2));
-						fourth = true;
-					}
-				}
-				if ((assembly[i] == 44) && format == 'D')
-				{
-					auto search = instruction.find(assembly.substr(i - 2, 2));
-					if (search != instruction.end())
-					{
-						if (!second)
-						{
-							second = true;
-							assemble.Rt = search->second;
-						}
-						else if (second && !third)
-						{
-							third = true;
-							assemble.Rn = search->second;
-						}
-					}
-					else
-					{
-						assemble.DT_address = stoi(assembly.substr(i + 2, linelength - i - 2));
-						fourth = true;
-					}
-				}
-				if ((assembly[i] == 44) && format == 'B')
-				{
-					assemble.BR_address = stoi(assembly.substr(i + 1, 6));
-					fourth = true;
-				}
-				if ((assembly[i] == 44) && format == 'C')
-				{
-					auto search = instruction.find(assembly.substr(i - 2, 2));
-					if (search != instruction.end())
-					{
-						if (!second)
-						{
-							second = true;
-							assemble.Rt = search->second;
-						}
-					}
-					else
-					{
-						assemble.COND_BR_address = stoi(assembly.substr(i + 2, linelength - i - 2));
-						fourth = true;
-					}
-				}
-				if ((assembly[i] == 44) && format == 'M')
-				{
-					auto search = instruction.find(assembly.substr(i - 2, 2));
-					if (search != instruction.end())
-					{
-						if (!second)
-						{
-							second = true;
-							assemble.Rd = search->second;
-						}
-					}
-					else
-					{
-						assemble.MOV_immediate = stoi(assembly.substr(i + 2, linelength - i - 2));
-						fourth = true;
-					}
-				}
-				i++;
-			}
-			
-
-			///////
-
-			if (fourth)
-			{
-				if (format == 'R')
-				{
-					machineCode = bitset<11>(assemble.opcode).to_string();
-					machineCode += bitset<5>(assemble.Rm).to_string();
-					machineCode += bitset<6>(assemble.shamt).to_string();
-					machineCode += bitset<5>(assemble.Rn).to_string();
-					machineCode += bitset<5>(assemble.Rd).to_string();
-				}
-				if (format == 'I')
-				{
-					machineCode = bitset<10>(assemble.opcode).to_string();
-					machineCode += bitset<12>(assemble.ALU_immediate).to_string();
-					machineCode += bitset<5>(assemble.Rn).to_string();
-					machineCode += bitset<5>(assemble.Rd).to_string();
-				}
-				if (format == 'D')
-				{
-					machineCode = bitset<11>(assemble.opcode).to_string();
-					machineCode += bitset<9>(assemble.DT_address).to_string();
-					machineCode += "00";
-					machineCode += bitset<5>(assemble.Rn).to_string();
-					machineCode += bitset<5>(assemble.Rt).to_string();
-				}
-				if (format == 'B')
-				{
-					machineCode = bitset<6>(assemble.opcode).to_string();
-					machineCode += bitset<26>(assemble.BR_address).to_string();
-				}
-				if (format == 'C')
-				{
-					machineCode = bitset<8>(assemble.opcode).to_string();
-					machineCode += bitset<19>(assemble.COND_BR_address).to_string();
-					machineCode += bitset<5>(assemble.Rd).to_string();
-				}
-				if (format == 'M')
-				{
-					machineCode = bitset<11>(assemble.opcode).to_string();
-					machineCode += bitset<16>(assemble.MOV_immediate).to_string();
-					machineCode += bitset<5>(assemble.Rd).to_string();
-				}
-
-
-				memory.at(memoryLocation) = machineCode;
-				memoryLocation++;
-			}
-		}
-
-		infile.close();
-
-	}
-
 char findFormat(int opcode)
 	{
 
@@ -1763,6 +1796,20 @@ char findFormat(int opcode)
 				0b11111100000: {format = 'R';  break; }
 			case//LDURD
 				0b11111100010: {format = 'R';  break; }
+			case//STUR Q
+				0b11111111000: {format = 'D';  break; }
+			case//LDUR Q
+				0b11111111001: {format = 'D';  break; }
+			case//vector operations
+				0b11111111010: {format = 'V';  break; }
+			case//vector reductions
+				0b11111111011: {format = 'R';  break; }
+			case//MARK
+				0b11111111100: {format = 'R';  break; }
+			case//MRS
+				0b11111111101: {format = 'R';  break; }
+			case//SVC
+				0b11111111110: {format = 'R';  break; }
 			default: {format = 'X'; break; }
 		}
 
@@ -0,0 +1,370 @@
+#ifndef LEGV8_PIPELINED_H
+#define LEGV8_PIPELINED_H
+
+#include <iostream>
+#include <string>
+#include <array>
+#include <vector>
+#include <map>
+
+#include "LEGv8-Plugin.h"
+
+struct Instructions //contains all of the information from the machine code
+{
+	int opcode;
+	int Rd, _Rd; //underscore variables are used to store value stored in corresponding register location
+	int Rn, _Rn; // ""
+	int Rm, _Rm; // ""
+	int Rt, _Rt; // ""
+	int shamt;
+	int ALU_immediate;
+	int op;
+	int BR_address;
+	int COND_BR_address;
+	int MOV_immediate;
+	int DT_address;
+	int LSL;
+	int location; //instruction memory location it was fetched from, 0 for bubbles
+	char format; //Format of the opcode ( R I D B C D )
+
+				 //Overload << operator to be able to output Instructions
+				 //Only outputs variables for the proper opcode based on the format
+	friend std::ostream& operator << (std::ostream& out_str, const Instructions&  output);
+};
+
+struct DecodedInstruction //the fields decode() extracts from one instruction word, as stored in a program image
+{
+	int opcode;
+	int Rd, Rn, Rm, Rt;
+	int shamt;
+	int ALU_immediate;
+	int op;
+	int BR_address;
+	int COND_BR_address;
+	int MOV_immediate;
+	int DT_address;
+	int LSL;
+	int format;
+};
+
+//Simulator state, defined in LEGv8-Pipelined.cpp
+extern std::string fetchVars;
+extern int fetchLocation;
+extern int PC;
+extern int SP;
+extern long long clockCycles;
+extern int endProgram;
+extern long long instructionsRetired;
+
+extern bool pipeline;
+extern bool negativeFlag;
+extern bool zeroFlag;
+extern bool overflowFlag;
+extern bool carryFlag;
+extern bool branched;
+extern bool concurrentHazardn;
+extern bool concurrentHazardt;
+extern bool concurrentHazardm;
+extern bool storeFlag;
+extern bool loadFlag;
+extern bool atomic;
+
+extern Instructions decodeVars;
+extern Instructions executeVars;
+extern Instructions writebackVars;
+extern Instructions noOP;
+
+extern std::array<int, 32> registers;
+extern std::array<std::string, 4096> memory;
+extern std::array<unsigned char, 1048576> dataMemory;
+
+int convertBinaryStringToInt(const std::string& machineCode, int start, int end, int findFormat, int checkNegative);
+std::string signExtend(std::string binary, int stringStart, int totalSize);
+std::string convertIntToBinaryString(int integer);
+void twosComplement(char *variable);
+char findFormat(int opcode);
+void storeDataMemory(int data, int location, int size);
+int loadDataMemory(int location, int size);
+void setFlags(int integer);
+void clearFlags();
+void checkFlags();
+void fetch();
+void fetchInstruction(int location);
+void decode();
+void execute();
+void writeback();
+void hazardCheck();
+void forwarding();
+void pipelined();
+void unpipelined();
+void pipelinedStep();
+void unpipelinedStep();
+void stepProcessor();
+void run();
+void resetSimulator();
+void quietOutput(bool quiet);
+
+//workloads.cpp
+int runWorkloads(int argc, char* argv[]);
+
+//allocations.cpp
+long long heapAllocationCount();
+
+//microbench.cpp
+int runMicrobenchmarks(int argc, char* argv[]);
+
+//assembler.cpp
+extern std::map<std::string, int> assemblySymbols;
+int assembleStream(std::istream& input, std::string sourceName, std::vector<unsigned int>& words);
+int assembleFile(std::string fileName, std::vector<unsigned int>& words);
+void loadProgram(const std::vector<unsigned int>& words);
+bool loadAssembly(std::string fileName);
+bool writeMachineFile(const std::vector<unsigned int>& words, std::string fileName);
+void addAssemblyKeyword(const char* name, char syntax, int value);
+int runAssembler(int argc, char* argv[]);
+std::string disassemble(const Instructions& instruction);
+
+//image.cpp
+extern const unsigned int* imageText;
+extern int imageTextWords;
+extern const DecodedInstruction* imageDecoded;
+bool writeProgramImage(std::string fileName, const std::vector<unsigned int>& words, const std::map<std::string, int>& symbols,
+	const std::vector<unsigned char>& data, int dataAddress, bool predecode);
+std::vector<DecodedInstruction> predecodeWords(const std::vector<unsigned int>& words);
+void copyDecoded(const DecodedInstruction& decoded, Instructions& instruction);
+bool loadProgramImage(std::string fileName);
+void loadProgramText(const std::vector<unsigned int>& words);
+void unloadProgramImage();
+int runImageBuilder(int argc, char* argv[]);
+
+//datafiles.cpp
+struct DataTransfer //a file loaded into or dumped from data memory
+{
+	std::string fileName;
+	long long address;
+	long long bytes; //dumps only
+};
+extern std::vector<DataTransfer> dataLoads;
+extern std::vector<DataTransfer> dataDumps;
+int parseDataOption(int argc, char* argv[], int i);
+bool loadDataFiles();
+bool dumpDataFiles();
+
+//cosim.cpp
+extern bool cosimEnabled;
+extern std::string cosimReport;
+void startCosim();
+void checkRetirement();
+bool finishCosim();
+long long runReference(long long instructions, std::string& error, void(*visit)(int location) = nullptr);
+void adoptReference();
+int storeSize(int opcode);
+bool isLoad(int opcode);
+
+//trace.cpp
+struct TraceRecord //one retired instruction and its effects
+{
+	int location;
+	int nextLocation; //location of the next instruction to retire, anything but location + 1 is a taken branch
+	unsigned int word;
+	int registerNumber; //-1 when no register is written
+	int value;
+	int size; //bytes of data accessed, 0 when there is no access
+	bool store;
+	long long address;
+	int stored;
+};
+typedef void(*TraceListener)(const TraceRecord& record);
+struct TraceSummary //what a trace file says about the run it recorded
+{
+	long long records;
+	long long cycles;
+	bool pipelined;
+};
+extern bool traceRecording;
+unsigned long long zigzag(long long value);
+std::vector<unsigned int> currentText();
+long long unzigzag(unsigned long long value);
+bool startTrace(std::string fileName);
+void recordRetirement();
+bool finishTrace();
+void addTraceListener(TraceListener listener);
+bool readTrace(std::string fileName, TraceListener listener, TraceSummary* summary = nullptr);
+int runReplay(int argc, char* argv[]);
+
+//cachesim.cpp
+int runCacheSim(int argc, char* argv[]);
+void startCacheSweep(std::string csvName);
+bool finishCacheSweep();
+
+//locality.cpp
+extern bool localityEnabled;
+extern int localityLineBytes;
+extern int localityWindow;
+void localityDataAccess(int location, int size);
+void localityFetch(int location);
+void startLocality(std::string prefix);
+bool finishLocality();
+
+//dataflow.cpp
+enum LatencyClass { latencyALU, latencyMUL, latencyDIV, latencyLOAD, latencySTORE, latencyBRANCH, latencyClasses };
+const int flagsRegister = 32; //the flags are tracked as a 33rd register
+const int vectorRegisterBase = 33; //then V0-V31 (simd.cpp)
+const int dependenceRegisters = vectorRegisterBase + 32;
+struct Dependences //registers an instruction reads and writes, and its latency class
+{
+	int sources[3];
+	int sourceCount;
+	int destinations[2];
+	int destinationCount;
+	LatencyClass latency;
+	int plugin; //index of the plugin instruction, -1 for built in ones
+};
+extern const char* latencyClassNames[latencyClasses];
+Dependences dependencesOf(const DecodedInstruction& instruction, bool load, bool store);
+const DecodedInstruction& decodedWord(unsigned int word);
+bool parseClassCycles(std::string text, std::array<int, latencyClasses>& cycles, std::string what);
+int runDataflow(int argc, char* argv[]);
+void startDataflow();
+void finishDataflow();
+
+//reverse.cpp
+extern bool historyEnabled;
+extern long long historyBudget;
+extern long long historyStep;
+std::vector<int*> stateFields();
+std::vector<long long*> stateCounters();
+unsigned long long packStateFlags();
+void unpackStateFlags(unsigned long long packed);
+void historyDataWrite(int location, int size);
+void startHistory();
+bool stepForward();
+bool goToStep(long long step);
+long long historyLoggedFrom();
+std::vector<std::pair<int, int>> lastStepWrites();
+void historyReport();
+
+//checkpoint.cpp
+bool saveCheckpoint(std::string fileName);
+bool restoreCheckpoint(std::string fileName);
+bool fastForward(long long instructions);
+void emptyPipeline();
+
+//simpoint.cpp
+extern bool simpointEnabled;
+int parseSimpointOption(int argc, char* argv[], int i);
+bool runSimpoint();
+
+//parallel.cpp
+extern bool parallelEnabled;
+long long measureInterval(long long warmup, long long instructions, long long& retired);
+int parseParallelOption(int argc, char* argv[], int i);
+bool runParallel(std::string program);
+int runParallelWorker(int argc, char* argv[]);
+
+//events.cpp
+extern long long stallUntil;
+extern long long idleCyclesSkipped;
+void stallProcessor(int cycles);
+void skipStall();
+void clearStall();
+
+//units.cpp
+struct UnitClass //timing of the functional units of one latency class
+{
+	int latency;
+	bool pipelined;
+	int units;
+};
+extern bool unitTiming;
+extern std::string unitsFile;
+extern std::array<UnitClass, latencyClasses> unitClasses;
+bool loadUnits(std::string fileName);
+void resetUnits();
+void issueInstruction(const Instructions& instruction);
+void reportUnits();
+
+//baselines.cpp
+int parseBaselineOption(int argc, char* argv[], int i);
+int runBaselines(int argc, char* argv[]);
+bool startBaselines();
+void finishBaselines();
+
+//devices.cpp
+const int deviceBase = 0x100000; //device registers, the first address past data memory
+extern std::string inputName;
+void deviceStore(int data, int location, int size);
+int deviceLoad(int location, int size);
+int parseDeviceOption(int argc, char* argv[], int i);
+void resetDevices();
+void finishDevices();
+
+//semihost.cpp
+const int opcodeSVC = 0b11111111110;
+extern int semihostExitCode;
+int operandInExecute(int number);
+bool guestRange(int address, int bytes, bool store);
+int semihostCall(int call);
+void resetSemihosting();
+
+//counters.cpp
+const int opcodeMRS = 0b11111111101;
+const int opcodeMARK = 0b11111111100;
+extern long long branchMispredicts;
+extern long long dataAccesses;
+int readCounter(int counter);
+void markRegion(int region);
+void resetCounters();
+void reportCounters();
+
+//simd.cpp
+const int opcodeVectorStore = 0b11111111000;
+const int opcodeVectorLoad = 0b11111111001;
+const int opcodeVector = 0b11111111010;
+const int opcodeAcross = 0b11111111011;
+enum VectorOperation { vectorADD, vectorSUB, vectorMUL, vectorCMEQ, vectorCMGT, vectorSMIN, vectorSMAX, vectorUMIN, vectorUMAX,
+	vectorAND, vectorORR, vectorEOR, vectorDUP, vectorOperations }; //in shamt above the arrangement, 16B, 8H or 4S
+typedef std::array<int, 4> VectorRegister;
+extern std::array<VectorRegister, 32> vectorRegisters;
+extern bool hostSimd; //SSE4.1 on the host, cleared by --simd-scalar
+bool vectorEncoding(int opcode, int shamt);
+void vectorLanes(int shamt, const VectorRegister& n, const VectorRegister& m, int scalar, VectorRegister& result, bool host);
+int vectorAcross(int shamt, const VectorRegister& n, bool host);
+void executeVector();
+std::string disassembleVector(const Instructions& instruction);
+
+//plugins.cpp
+extern int pluginInstructionCount;
+bool loadPlugin(std::string fileName);
+int pluginIndex(int opcode);
+char pluginFormat(int opcode);
+bool callPlugin(int index, const Instructions& instruction, int valueRd, int valueRn, int valueRm, int* registerFile,
+	unsigned char* memory, long long memoryBytes, int& result, std::string& error);
+bool executePlugin();
+bool pluginReadsRd(int index);
+const UnitClass& pluginUnit(int index);
+std::string pluginName(int index);
+std::string pluginOptions();
+
+//breakpoints.cpp
+const int watchPageShift = 12; //watch tags are kept per 4 KiB page of data memory
+const unsigned char watchRead = 0x01;
+const unsigned char watchWrite = 0x02;
+extern std::vector<unsigned char> breakpointMap;
+extern std::array<unsigned char, 256> watchTags;
+extern int breakpointPending;
+extern std::string debugStop;
+void watchAccess(int location, int size, bool store);
+void beginDebugStep();
+bool endDebugStep();
+bool stoppedBackwards();
+bool addBreakpoint(std::string arguments);
+bool addWatchpoint(std::string arguments);
+void deleteDebugPoint(int number);
+void listDebugPoints();
+
+//debugger.cpp
+extern std::vector<std::string> debuggerCommands;
+void runDebugger();
+
+#endif // LEGV8_PIPELINED_H
@@ -0,0 +1,70 @@
+//Custom instruction plugin interface
+/*
+A plugin is a shared library (.so, .dll) loaded with --plugin file. It exports one C function, legv8Plugin, which is given
+the interface version and returns its table of instructions:
+
+	extern "C" int legv8Plugin(int version, const LegPluginInstruction **instructions);   returns the number of entries,
+	                                                                                       0 or less to refuse to load
+
+Each entry claims the instruction words with (word & mask) == match. The match has to lie in the opcode field, the top 11
+bits for R format and the top 10 for I format, and may not overlap a built in opcode, EXIT or another plugin's. Decode
+extracts the fields of the chosen format and the execute handler is called with them, the register values read for them,
+the registers and data memory. The value the handler leaves in result is written to Rd in writeback as any R or I format
+instruction does; it starts as the value of Rd, so an instruction that writes no register leaves it alone.
+
+latency, pipelined and units time the instruction under --units the way a line of the units file times a class (units.cpp),
+and latency is its latency for --ilp and --dataflow. readsRd adds Rd to the registers the instruction waits for.
+
+A fused multiply-add, Rd = Rd + Rn * Rm, as a plugin:
+
+	static int fma(LegPluginContext *context)
+	{
+		context->result = context->valueRd + context->valueRn * context->valueRm;
+		return 0;
+	}
+	static const LegPluginInstruction table[] = { { "FMADD", 0xFFE00000u, 0xFE000000u, 'R', 1, 4, 1, 1, fma } };
+	extern "C" int legv8Plugin(int version, const LegPluginInstruction **instructions)
+	{
+		*instructions = table;
+		return (version == LEGV8_PLUGIN_VERSION) ? 1 : 0;
+	}
+
+built with g++ -shared -fPIC -I. fma.cpp -o fma.so (on Windows exported with __declspec(dllexport)).
+*/
+
+#ifndef LEGV8_PLUGIN_H
+#define LEGV8_PLUGIN_H
+
+#define LEGV8_PLUGIN_VERSION 1
+
+struct LegPluginContext
+{
+	int Rd, Rn, Rm; //register numbers
+	int shamt; //R format
+	int immediate; //I format, sign extended
+	int valueRd, valueRn, valueRm; //register values as the instruction reads them
+	int *registers; //X0-X31, for instructions that write more than Rd; X31 is not forced to zero
+	unsigned char *memory; //data memory, little endian
+	long long memoryBytes;
+	long long cycle;
+	int result; //written to Rd
+};
+
+typedef int(*LegPluginExecute)(LegPluginContext *context); //0 on success, anything else stops the run with an error
+
+struct LegPluginInstruction
+{
+	const char *name; //assembler mnemonic
+	unsigned int mask;
+	unsigned int match;
+	char format; //'R' (Rd, Rn, Rm, shamt) or 'I' (Rd, Rn, 12 bit immediate)
+	int readsRd;
+	int latency;
+	int pipelined;
+	int units;
+	LegPluginExecute execute;
+};
+
+typedef int(*LegPluginEntry)(int version, const LegPluginInstruction **instructions);
+
+#endif // LEGV8_PLUGIN_H
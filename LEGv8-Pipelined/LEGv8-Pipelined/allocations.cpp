@@ -0,0 +1,82 @@
+//Allocation counting
+/*
+Replaces the global operator new and operator delete for the whole program with versions that count every allocation, so the
+benchmark harness (workloads.cpp) can check that the cycle loop does not touch the heap. Every form a C++14 program can call is
+replaced together, the array and nothrow forms and the sized deletes, so each block is released by the delete that matches the
+new that made it. Blocks come from malloc and go back to free, and counting one is a relaxed atomic add.
+*/
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+std::atomic<long long> heapAllocations(0); //std:: as the processor has a flag named atomic
+
+long long heapAllocationCount()
+{
+	return heapAllocations.load(memory_order_relaxed);
+}
+
+void* countedAllocation(size_t size) noexcept
+{
+	heapAllocations.fetch_add(1, memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+	void *block = countedAllocation(size);
+	if (!block) throw bad_alloc();
+	return block;
+}
+
+void* operator new[](size_t size)
+{
+	void *block = countedAllocation(size);
+	if (!block) throw bad_alloc();
+	return block;
+}
+
+void* operator new(size_t size, const nothrow_t &) noexcept
+{
+	return countedAllocation(size);
+}
+
+void* operator new[](size_t size, const nothrow_t &) noexcept
+{
+	return countedAllocation(size);
+}
+
+void operator delete(void *block) noexcept
+{
+	free(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+	free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+	free(block);
+}
+
+void operator delete[](void *block, size_t) noexcept
+{
+	free(block);
+}
+
+void operator delete(void *block, const nothrow_t &) noexcept
+{
+	free(block);
+}
+
+void operator delete[](void *block, const nothrow_t &) noexcept
+{
+	free(block);
+}
@@ -0,0 +1,778 @@
+//LEGv8 assembler
+/*
+Replaces machineCompliler(). Each source line is tokenized in place and encoded straight into a 32 bit word, mnemonics and
+register names are found through a perfect hash table, and branches to labels are recorded as fixups that are patched once
+the whole file has been read (the second pass only visits the branches). Errors are reported as file:line: message with the
+offending line, and assembly carries on so every error in the file is reported in one run.
+
+Syntax, one instruction per line, case insensitive, // or ; starts a comment:
+	label:  ADD X1, X2, X3          R format
+	        LSL X1, X2, #3          shifts take the amount as the third operand
+	        ADDI X1, X2, #-5        I format, # is optional
+	        LDUR X1, [X2, #8]       D format, the brackets are optional (LDUR X1,X2,#8)
+	        B label                 B and BL, a label or a signed offset in instructions
+	        CBZ X1, label           CBZ, CBNZ and B.EQ/B.NE/B.LT/B.LE/B.GT/B.GE
+	        BR X30
+	        MOVZ X1, #4660, LSL #16
+	        SVC #2                  host call, semihost.cpp
+	        MRS X1, #0              read a performance counter, MARK #1 starts a counter region (counters.cpp)
+	        ADD V1.4S, V2.4S, V3.4S vector instructions on V0-V31 with arrangement 16B, 8H or 4S, LDUR Q1, [X2, #16] for
+	        ADDV X1, V2.4S          their loads and stores (simd.cpp)
+	        EXIT
+Registers are X0-X31 or the aliases SP (X28), FP (X29), LR (X30), XZR and ZR (X31).
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <bitset>
+#include <array>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cctype>
+#include <deque>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+map<string, int> assemblySymbols; //label -> instruction memory location of the last assembled program
+
+struct AssemblyKeyword
+{
+	const char *name;
+	char syntax; //R three registers, S shift, J branch to register, I, D, B, C compare and branch, Q B.cond, M move wide, X exit,
+	             //V host call, P counter read, K counter mark, N three vector registers, U DUP, A across vector, r register
+	int value; //opcode, or the register number
+	int extra; //shamt for SDIV/UDIV, condition for B.cond, VectorOperation for the vector instructions
+};
+
+AssemblyKeyword assemblyKeywords[] =
+{
+	{ "B", 'B', 0b000101, 0 },
+	{ "FMULS", 'R', 0b00011110001, 0 },
+	{ "FDIVS", 'R', 0b00011110001, 0 },
+	{ "FCMPS", 'R', 0b00011110001, 0 },
+	{ "FADDS", 'R', 0b00011110001, 0 },
+	{ "FSUBS", 'R', 0b00011110001, 0 },
+	{ "FMULD", 'R', 0b00011110001, 0 },
+	{ "FDIVD", 'R', 0b00011110001, 0 },
+	{ "FCMPD", 'R', 0b00011110001, 0 },
+	{ "FADDD", 'R', 0b00011110001, 0 },
+	{ "FSUBD", 'R', 0b00011110001, 0 },
+	{ "STURB", 'D', 0b00111000000, 0 },
+	{ "LDURB", 'D', 0b00111000010, 0 },
+	{ "B.EQ", 'Q', 0b01010100, 0b00000 },
+	{ "B.NE", 'Q', 0b01010100, 0b00001 },
+	{ "B.LT", 'Q', 0b01010100, 0b01011 },
+	{ "B.LE", 'Q', 0b01010100, 0b01101 },
+	{ "B.GT", 'Q', 0b01010100, 0b01100 },
+	{ "B.GE", 'Q', 0b01010100, 0b01010 },
+	{ "STURH", 'D', 0b01111000000, 0 },
+	{ "LDURH", 'D', 0b01111000010, 0 },
+	{ "AND", 'R', 0b10001010000, 0 },
+	{ "ADD", 'R', 0b10001011000, 0 },
+	{ "ADDI", 'I', 0b1001000100, 0 },
+	{ "ANDI", 'I', 0b1001001000, 0 },
+	{ "BL", 'B', 0b100101, 0 },
+	{ "SDIV", 'R', 0b10011010110, 0b000010 },
+	{ "UDIV", 'R', 0b10011010110, 0b000011 },
+	{ "MUL", 'R', 0b10011011000, 0 },
+	{ "SMULH", 'R', 0b10011011010, 0 },
+	{ "UMULH", 'R', 0b10011011110, 0 },
+	{ "ORR", 'R', 0b10101010000, 0 },
+	{ "ADDS", 'R', 0b10101011000, 0 },
+	{ "ADDIS", 'I', 0b1011000100, 0 },
+	{ "ORRI", 'I', 0b1011001000, 0 },
+	{ "CBZ", 'C', 0b10110100, 0 },
+	{ "CBNZ", 'C', 0b10110101, 0 },
+	{ "STURW", 'D', 0b10111000000, 0 },
+	{ "LDURSW", 'D', 0b10111000100, 0 },
+	{ "STURS", 'R', 0b10111100000, 0 },
+	{ "LDURS", 'R', 0b10111100010, 0 },
+	{ "STXR", 'D', 0b11001000000, 0 },
+	{ "LDXR", 'D', 0b11001000010, 0 },
+	{ "EOR", 'R', 0b11001010000, 0 },
+	{ "SUB", 'R', 0b11001011000, 0 },
+	{ "SUBI", 'I', 0b1101000100, 0 },
+	{ "EORI", 'I', 0b1101001000, 0 },
+	{ "MOVZ", 'M', 0b110100101, 0 },
+	{ "LSR", 'S', 0b11010011010, 0 },
+	{ "LSL", 'S', 0b11010011011, 0 },
+	{ "BR", 'J', 0b11010110000, 0 },
+	{ "ANDS", 'R', 0b11101010000, 0 },
+	{ "SUBS", 'R', 0b11101011000, 0 },
+	{ "SUBIS", 'I', 0b1111000100, 0 },
+	{ "ANDIS", 'I', 0b1111001000, 0 },
+	{ "MOVK", 'M', 0b111100101, 0 },
+	{ "STUR", 'D', 0b11111000000, 0 },
+	{ "LDUR", 'D', 0b11111000010, 0 },
+	{ "STURD", 'R', 0b11111100000, 0 },
+	{ "LDURD", 'R', 0b11111100010, 0 },
+	{ "CMEQ", 'N', 0b11111111010, vectorCMEQ },
+	{ "CMGT", 'N', 0b11111111010, vectorCMGT },
+	{ "SMIN", 'N', 0b11111111010, vectorSMIN },
+	{ "SMAX", 'N', 0b11111111010, vectorSMAX },
+	{ "UMIN", 'N', 0b11111111010, vectorUMIN },
+	{ "UMAX", 'N', 0b11111111010, vectorUMAX },
+	{ "DUP", 'U', 0b11111111010, vectorDUP },
+	{ "ADDV", 'A', 0b11111111011, vectorADD },
+	{ "SMINV", 'A', 0b11111111011, vectorSMIN },
+	{ "SMAXV", 'A', 0b11111111011, vectorSMAX },
+	{ "UMINV", 'A', 0b11111111011, vectorUMIN },
+	{ "UMAXV", 'A', 0b11111111011, vectorUMAX },
+	{ "MARK", 'K', 0b11111111100, 0 },
+	{ "MRS", 'P', 0b11111111101, 0 },
+	{ "SVC", 'V', 0b11111111110, 0 },
+	{ "EXIT", 'X', 0b11111111111, 0 },
+
+	{ "X0", 'r', 0, 0 }, { "X1", 'r', 1, 0 }, { "X2", 'r', 2, 0 }, { "X3", 'r', 3, 0 },
+	{ "X4", 'r', 4, 0 }, { "X5", 'r', 5, 0 }, { "X6", 'r', 6, 0 }, { "X7", 'r', 7, 0 },
+	{ "X8", 'r', 8, 0 }, { "X9", 'r', 9, 0 }, { "X10", 'r', 10, 0 }, { "X11", 'r', 11, 0 },
+	{ "X12", 'r', 12, 0 }, { "X13", 'r', 13, 0 }, { "X14", 'r', 14, 0 }, { "X15", 'r', 15, 0 },
+	{ "X16", 'r', 16, 0 }, { "X17", 'r', 17, 0 }, { "X18", 'r', 18, 0 }, { "X19", 'r', 19, 0 },
+	{ "X20", 'r', 20, 0 }, { "X21", 'r', 21, 0 }, { "X22", 'r', 22, 0 }, { "X23", 'r', 23, 0 },
+	{ "X24", 'r', 24, 0 }, { "X25", 'r', 25, 0 }, { "X26", 'r', 26, 0 }, { "X27", 'r', 27, 0 },
+	{ "X28", 'r', 28, 0 }, { "X29", 'r', 29, 0 }, { "X30", 'r', 30, 0 }, { "X31", 'r', 31, 0 },
+	{ "SP", 'r', 28, 0 },
+	{ "FP", 'r', 29, 0 },
+	{ "LR", 'r', 30, 0 },
+	{ "XZR", 'r', 31, 0 },
+	{ "ZR", 'r', 31, 0 },
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////PERFECT HASH////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+deque<string> addedNames; //kept in a deque so the names do not move
+deque<AssemblyKeyword> addedKeywords;
+
+const unsigned int keywordSlots = 2048; //power of two, large enough that a collision free seed is found in a few tries
+
+unsigned int keywordHash(const char *text, int length, unsigned int seed)
+{//FNV-1a over the upper case characters, the seed is picked so no two keywords share a slot
+	unsigned int hash = 2166136261u ^ seed;
+	for (int i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)toupper((unsigned char)text[i]);
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 15;
+	return hash & (keywordSlots - 1);
+}
+
+struct KeywordTable
+{
+	unsigned int seed;
+	array<const AssemblyKeyword*, keywordSlots> slots;
+
+	KeywordTable()
+	{//built once, tries seeds until every keyword lands in its own slot
+		for (seed = 0;; seed++)
+		{
+			slots.fill(nullptr);
+			bool collision = false;
+			for (const AssemblyKeyword &keyword : assemblyKeywords)
+			{
+				const AssemblyKeyword *&slot = slots[keywordHash(keyword.name, strlen(keyword.name), seed)];
+				if (slot)
+				{
+					collision = true;
+					break;
+				}
+				slot = &keyword;
+			}
+			if (!collision) return;
+		}
+	}
+
+	static bool matches(const AssemblyKeyword *keyword, const char *text, int length)
+	{
+		for (int i = 0; i < length; i++)
+			if (toupper((unsigned char)text[i]) != keyword->name[i]) return false;
+		return keyword->name[length] == '\0';
+	}
+
+	const AssemblyKeyword *find(const char *text, int length) const
+	{//plugin mnemonics are searched only when the table misses
+		const AssemblyKeyword *keyword = slots[keywordHash(text, length, seed)];
+		if (keyword && matches(keyword, text, length)) return keyword;
+		for (const AssemblyKeyword &added : addedKeywords) if (matches(&added, text, length)) return &added;
+		return nullptr;
+	}
+};
+
+void addAssemblyKeyword(const char *name, char syntax, int value)
+{//an instruction of a plugin (plugins.cpp)
+	string upper = name;
+	for (char &c : upper) c = (char)toupper((unsigned char)c);
+	addedNames.push_back(upper);
+	addedKeywords.push_back({ addedNames.back().c_str(), syntax, value, 0 });
+}
+
+const KeywordTable &keywordTable()
+{
+	static KeywordTable table;
+	return table;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////TOKENIZER AND ENCODER//////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct AssemblyOperand
+{
+	char kind; //r register, v vector register, i immediate, l label
+	long long value;
+	int arrangement; //of a vector register, 0 16B, 1 8H, 2 4S, -1 for Qn
+	const char *text; //points into the current line, only valid while that line is being assembled
+	int length;
+};
+
+struct AssemblyFixup
+{
+	size_t word;
+	string label;
+	char syntax;
+	int line;
+};
+
+struct Assembler
+{
+	string sourceName;
+	vector<unsigned int> &words;
+	unordered_map<string, int> labels; //label -> word index
+	vector<AssemblyFixup> fixups;
+	int errors = 0;
+	int line = 0;
+	string source; //current line, kept for diagnostics
+
+	Assembler(string name, vector<unsigned int> &output) : sourceName(name), words(output) {}
+
+	void error(int atLine, const string &message, const string &text)
+	{
+		errors++;
+		if (errors > 50) return; //the rest are counted but not printed
+		cout << sourceName << ":" << atLine << ": error: " << message << endl;
+		if (!text.empty()) cout << "    " << text << endl;
+		if (errors == 50) cout << sourceName << ": too many errors, only the count is reported from here on" << endl;
+	}
+	void error(const string &message) { error(line, message, source); }
+
+	static bool isLabelCharacter(char c) { return isalnum((unsigned char)c) || (c == '_') || (c == '.'); }
+
+	static bool parseVector(const char *text, int length, AssemblyOperand &operand)
+	{//Vn.16B, Vn.8H, Vn.4S or Qn
+		char kind = (char)toupper((unsigned char)text[0]);
+		int i = 1, number = 0;
+		if ((kind != 'V') && (kind != 'Q')) return false;
+		for (; (i < length) && isdigit((unsigned char)text[i]) && (i < 3); i++) number = number * 10 + text[i] - '0';
+		if ((i == 1) || (number > 31)) return false;
+		string arrangement;
+		if (kind == 'V')
+		{
+			if ((i >= length) || (text[i] != '.')) return false;
+			for (i++; i < length; i++) arrangement += (char)toupper((unsigned char)text[i]);
+		}
+		else if (i != length) return false;
+		operand.kind = 'v';
+		operand.value = number;
+		operand.arrangement = (kind == 'Q') ? -1 : (arrangement == "16B") ? 0 : (arrangement == "8H") ? 1 : (arrangement == "4S") ? 2 : -2;
+		return operand.arrangement != -2;
+	}
+
+	int vectorOperation(int opcode)
+	{//the scalar mnemonics that also take vector registers
+		switch (opcode)
+		{
+			case 0b10001011000: return vectorADD;
+			case 0b11001011000: return vectorSUB;
+			case 0b10011011000: return vectorMUL;
+			case 0b10001010000: return vectorAND;
+			case 0b10101010000: return vectorORR;
+			case 0b11001010000: return vectorEOR;
+			default: return -1;
+		}
+	}
+
+	bool vectorOperands(const AssemblyOperand *operands, int count)
+	{//Vd.T, Vn.T[, Vm.T] with the same arrangement throughout
+		for (int i = 0; i < count; i++)
+		{
+			if (!expect(operands[i], 'v', "a vector register")) return false;
+			if ((operands[i].arrangement < 0) || (operands[i].arrangement != operands[0].arrangement))
+			{
+				error("expected " + string(operands[0].arrangement < 0 ? "an arrangement" : "the same arrangement") + ", found '"
+					+ string(operands[i].text, operands[i].length) + "'");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	unsigned int vectorWord(int opcode, int operation, const AssemblyOperand &vector, int Rd, int Rn, int Rm)
+	{//the operation and arrangement in shamt
+		return ((unsigned int)opcode << 21) | (Rm << 16) | ((operation * 4 + vector.arrangement) << 10) | (Rn << 5) | Rd;
+	}
+
+	bool parseOperand(const char *text, int length, AssemblyOperand &operand)
+	{
+		operand.text = text;
+		operand.length = length;
+		const AssemblyKeyword *keyword = keywordTable().find(text, length);
+		if (keyword && (keyword->syntax == 'r'))
+		{
+			operand.kind = 'r';
+			operand.value = keyword->value;
+			return true;
+		}
+		if (parseVector(text, length, operand)) return true;
+
+		int i = 0;
+		if (text[0] == '#') i++;
+		bool negative = false;
+		if ((i < length) && ((text[i] == '-') || (text[i] == '+'))) negative = (text[i++] == '-');
+		if ((i < length) && isdigit((unsigned char)text[i]))
+		{
+			int base = 10;
+			if ((i + 1 < length) && (text[i] == '0') && ((text[i + 1] == 'x') || (text[i + 1] == 'X')))
+			{
+				base = 16;
+				i += 2;
+			}
+			long long value = 0;
+			bool digits = false;
+			for (; i < length; i++)
+			{
+				int digit;
+				char c = text[i];
+				if (isdigit((unsigned char)c)) digit = c - '0';
+				else if ((base == 16) && isxdigit((unsigned char)c)) digit = toupper((unsigned char)c) - 'A' + 10;
+				else
+				{
+					error("malformed number '" + string(text, length) + "'");
+					return false;
+				}
+				value = value * base + digit;
+				digits = true;
+				if (value > 0xFFFFFFFFLL)
+				{
+					error("number out of range '" + string(text, length) + "'");
+					return false;
+				}
+			}
+			if (!digits)
+			{
+				error("malformed number '" + string(text, length) + "'");
+				return false;
+			}
+			operand.kind = 'i';
+			operand.value = negative ? -value : value;
+			return true;
+		}
+		if ((text[0] != '#') && !isdigit((unsigned char)text[0]))
+		{
+			for (i = 0; i < length; i++)
+				if (!isLabelCharacter(text[i])) break;
+			if (i == length)
+			{
+				operand.kind = 'l';
+				operand.value = 0;
+				return true;
+			}
+		}
+		error("unrecognized operand '" + string(text, length) + "'");
+		return false;
+	}
+
+	bool expect(const AssemblyOperand &operand, char kind, const char *what)
+	{
+		if (operand.kind == kind) return true;
+		error(string("expected ") + what + ", found '" + string(operand.text, operand.length) + "'");
+		return false;
+	}
+
+	bool inRange(long long value, long long low, long long high, const char *what)
+	{
+		if ((value >= low) && (value <= high)) return true;
+		error(string(what) + " " + to_string(value) + " is outside " + to_string(low) + ".." + to_string(high));
+		return false;
+	}
+
+	unsigned int branchField(char syntax, long long offset)
+	{
+		if (syntax == 'B') return (unsigned int)offset & 0x3FFFFFF;
+		return ((unsigned int)offset & 0x7FFFF) << 5;
+	}
+
+	bool branchTarget(const AssemblyOperand &operand, char syntax, unsigned int &field)
+	{//numbers are offsets in instructions from the branch, labels are patched after the last line
+		if (operand.kind == 'i')
+		{
+			if (syntax == 'B')
+			{
+				if (!inRange(operand.value, -(1 << 25), (1 << 25) - 1, "branch offset")) return false;
+			}
+			else if (!inRange(operand.value, -(1 << 18), (1 << 18) - 1, "branch offset")) return false;
+			field = branchField(syntax, operand.value);
+			return true;
+		}
+		if (operand.kind == 'l')
+		{
+			fixups.push_back({ words.size(), string(operand.text, operand.length), syntax, line });
+			field = 0;
+			return true;
+		}
+		error("expected a label or offset, found '" + string(operand.text, operand.length) + "'");
+		return false;
+	}
+
+	void assembleLine(const char *text, int length)
+	{
+		int i = 0;
+		auto skipSpace = [&]() { while ((i < length) && isspace((unsigned char)text[i])) i++; };
+
+		//labels, any number of name: prefixes
+		for (;;)
+		{
+			skipSpace();
+			int start = i;
+			while ((i < length) && isLabelCharacter(text[i])) i++;
+			if ((i > start) && (i < length) && (text[i] == ':'))
+			{
+				string name(text + start, i - start);
+				const AssemblyKeyword *keyword = keywordTable().find(text + start, i - start);
+				if (isdigit((unsigned char)name[0]) || (keyword && (keyword->syntax == 'r')))
+					error("'" + name + "' can not be used as a label");
+				else if (!labels.emplace(name, (int)words.size()).second)
+					error("label '" + name + "' is already defined");
+				i++;
+				continue;
+			}
+			i = start;
+			break;
+		}
+		if (i >= length) return;
+
+		//mnemonic
+		int start = i;
+		while ((i < length) && !isspace((unsigned char)text[i])) i++;
+		const AssemblyKeyword *op = keywordTable().find(text + start, i - start);
+		if (!op || (op->syntax == 'r'))
+		{
+			error("unknown mnemonic '" + string(text + start, i - start) + "'");
+			return;
+		}
+
+		//operands are separated by commas, brackets and spaces
+		AssemblyOperand operands[4];
+		int count = 0;
+		while (i < length)
+		{
+			while ((i < length) && (isspace((unsigned char)text[i]) || (text[i] == ',') || (text[i] == '[') || (text[i] == ']'))) i++;
+			if (i >= length) break;
+			start = i;
+			while ((i < length) && !isspace((unsigned char)text[i]) && (text[i] != ',') && (text[i] != '[') && (text[i] != ']')) i++;
+			if (count == 4)
+			{
+				error("too many operands for " + string(op->name));
+				return;
+			}
+			if (!parseOperand(text + start, i - start, operands[count])) return;
+			count++;
+		}
+
+		//shift keyword of MOVZ/MOVK, "LSL #16" arrives as two operands
+		bool movShift = (op->syntax == 'M') && (count == 4) && (operands[2].kind == 'l') && (operands[2].length == 3)
+			&& (toupper((unsigned char)operands[2].text[0]) == 'L') && (toupper((unsigned char)operands[2].text[1]) == 'S')
+			&& (toupper((unsigned char)operands[2].text[2]) == 'L');
+
+		int expected;
+		switch (op->syntax)
+		{
+			case 'R': case 'S': case 'I': expected = 3; break;
+			case 'D': expected = (count == 2) ? 2 : 3; break; //[Xn] without an offset
+			case 'B': case 'Q': case 'J': case 'V': case 'K': expected = 1; break;
+			case 'N': expected = 3; break;
+			case 'C': case 'P': case 'U': case 'A': expected = 2; break;
+			case 'M': expected = movShift ? 4 : 2; break;
+			default: expected = 0; break;
+		}
+		if (count != expected)
+		{
+			error(string(op->name) + " takes " + to_string(expected) + " operand" + (expected == 1 ? "" : "s") + ", found " + to_string(count));
+			return;
+		}
+
+		unsigned int word = 0;
+		unsigned int field;
+		switch (op->syntax)
+		{
+			case 'R':
+				if ((operands[0].kind == 'v') && (vectorOperation(op->value) >= 0))
+				{//ADD, SUB, MUL, AND, ORR and EOR on vector registers
+					if (!vectorOperands(operands, 3)) return;
+					word = vectorWord(opcodeVector, vectorOperation(op->value), operands[0], (int)operands[0].value, (int)operands[1].value, (int)operands[2].value);
+					break;
+				}
+				if (!expect(operands[0], 'r', "a register") || !expect(operands[1], 'r', "a register") || !expect(operands[2], 'r', "a register")) return;
+				word = (op->value << 21) | (unsigned int)(operands[2].value << 16) | (op->extra << 10) | (unsigned int)(operands[1].value << 5) | (unsigned int)operands[0].value;
+				break;
+			case 'S':
+				if (!expect(operands[0], 'r', "a register") || !expect(operands[1], 'r', "a register") || !expect(operands[2], 'i', "a shift amount")) return;
+				if (!inRange(operands[2].value, 0, 63, "shift amount")) return;
+				word = (op->value << 21) | (unsigned int)(operands[2].value << 10) | (unsigned int)(operands[1].value << 5) | (unsigned int)operands[0].value;
+				break;
+			case 'J': //the target is read from the Rt (Rd) field, Rn is filled in as well to match ARM
+				if (!expect(operands[0], 'r', "a register")) return;
+				word = (op->value << 21) | (unsigned int)(operands[0].value << 5) | (unsigned int)operands[0].value;
+				break;
+			case 'I':
+				if (!expect(operands[0], 'r', "a register") || !expect(operands[1], 'r', "a register") || !expect(operands[2], 'i', "an immediate")) return;
+				if (!inRange(operands[2].value, -2048, 2047, "immediate")) return; //decode() sign extends the 12 bit field
+				word = (op->value << 22) | (((unsigned int)operands[2].value & 0xFFF) << 10) | (unsigned int)(operands[1].value << 5) | (unsigned int)operands[0].value;
+				break;
+			case 'D':
+			{
+				int opcode = op->value;
+				if ((operands[0].kind == 'v') && (operands[0].arrangement == -1) && ((opcode == 0b11111000000) || (opcode == 0b11111000010)))
+					opcode = (opcode == 0b11111000000) ? opcodeVectorStore : opcodeVectorLoad; //STUR Qt, LDUR Qt
+				else if (!expect(operands[0], 'r', "a register")) return;
+				if (!expect(operands[1], 'r', "a base register")) return;
+				if (count == 3)
+				{
+					if (!expect(operands[2], 'i', "an offset") || !inRange(operands[2].value, -256, 255, "offset")) return;
+					field = (unsigned int)operands[2].value & 0x1FF;
+				}
+				else field = 0;
+				word = (opcode << 21) | (field << 12) | (unsigned int)(operands[1].value << 5) | (unsigned int)operands[0].value;
+				break;
+			}
+			case 'B':
+				if (!branchTarget(operands[0], 'B', field)) return;
+				word = (op->value << 26) | field;
+				break;
+			case 'C':
+				if (!expect(operands[0], 'r', "a register") || !branchTarget(operands[1], 'C', field)) return;
+				word = (op->value << 24) | field | (unsigned int)operands[0].value;
+				break;
+			case 'Q':
+				if (!branchTarget(operands[0], 'C', field)) return;
+				word = (op->value << 24) | field | op->extra;
+				break;
+			case 'M':
+			{
+				if (!expect(operands[0], 'r', "a register") || !expect(operands[1], 'i', "an immediate") || !inRange(operands[1].value, 0, 65535, "immediate")) return;
+				long long shift = 0;
+				if (movShift)
+				{
+					if (!expect(operands[3], 'i', "a shift amount")) return;
+					shift = operands[3].value;
+					if ((shift != 0) && (shift != 16) && (shift != 32) && (shift != 48))
+					{
+						error("MOV shift must be 0, 16, 32 or 48");
+						return;
+					}
+				}
+				word = (op->value << 23) | (unsigned int)((shift / 16) << 21) | (unsigned int)(operands[1].value << 5) | (unsigned int)operands[0].value;
+				break;
+			}
+			case 'V': //the call number in shamt, and Rd, Rn and Rm naming the argument registers X0, X1 and X2
+				if (!expect(operands[0], 'i', "a call number") || !inRange(operands[0].value, 0, 63, "call number")) return;
+				word = (op->value << 21) | (2u << 16) | (unsigned int)(operands[0].value << 10) | (1u << 5);
+				break;
+			case 'P': //the counter number in shamt, Rn and Rm are X31 so no register is read
+				if (!expect(operands[0], 'r', "a register") || !expect(operands[1], 'i', "a counter number") || !inRange(operands[1].value, 0, 63, "counter number")) return;
+				word = (op->value << 21) | (31u << 16) | (unsigned int)(operands[1].value << 10) | (31u << 5) | (unsigned int)operands[0].value;
+				break;
+			case 'K': //the region number in shamt, every register field X31
+				if (!expect(operands[0], 'i', "a region number") || !inRange(operands[0].value, 0, 63, "region number")) return;
+				word = (op->value << 21) | (31u << 16) | (unsigned int)(operands[0].value << 10) | (31u << 5) | 31u;
+				break;
+			case 'N':
+				if (!vectorOperands(operands, 3)) return;
+				word = vectorWord(op->value, op->extra, operands[0], (int)operands[0].value, (int)operands[1].value, (int)operands[2].value);
+				break;
+			case 'U': //DUP Vd.T, Xn, Rm is X31
+				if (!vectorOperands(operands, 1) || !expect(operands[1], 'r', "a register")) return;
+				word = vectorWord(op->value, op->extra, operands[0], (int)operands[0].value, (int)operands[1].value, 31);
+				break;
+			case 'A': //ADDV Xd, Vn.T, Rm is X31
+				if (!expect(operands[0], 'r', "a register") || !vectorOperands(operands + 1, 1)) return;
+				word = vectorWord(op->value, op->extra, operands[1], (int)operands[0].value, (int)operands[1].value, 31);
+				break;
+			case 'X':
+				word = op->value << 21;
+				break;
+		}
+		words.push_back(word);
+	}
+
+	void resolveFixups()
+	{//second pass, only over the branches that named a label
+		for (AssemblyFixup &fixup : fixups)
+		{
+			auto target = labels.find(fixup.label);
+			if (target == labels.end())
+			{
+				error(fixup.line, "undefined label '" + fixup.label + "'", "");
+				continue;
+			}
+			long long offset = (long long)target->second - (long long)fixup.word;
+			long long limit = (fixup.syntax == 'B') ? (1 << 25) : (1 << 18);
+			if ((offset < -limit) || (offset >= limit))
+			{
+				error(fixup.line, "branch to '" + fixup.label + "' is out of range", "");
+				continue;
+			}
+			words[fixup.word] |= branchField(fixup.syntax, offset);
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////ENTRY POINTS////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int assembleStream(istream &input, string sourceName, vector<unsigned int> &words)
+{//returns the number of errors, words holds the program in memory order starting at location 1
+	words.clear();
+	Assembler state(sourceName, words);
+
+	while (getline(input, state.source))
+	{
+		state.line++;
+		string &text = state.source;
+		if (!text.empty() && (text.back() == '\r')) text.pop_back();
+
+		size_t length = text.size();
+		for (size_t i = 0; i < text.size(); i++)
+		{
+			if ((text[i] == ';') || ((text[i] == '/') && (i + 1 < text.size()) && (text[i + 1] == '/')))
+			{
+				length = i;
+				break;
+			}
+		}
+		state.assembleLine(text.data(), (int)length);
+	}
+	state.source.clear();
+	state.resolveFixups();
+
+	assemblySymbols.clear();
+	for (auto &label : state.labels) assemblySymbols[label.first] = label.second + 1;
+	return state.errors;
+}
+
+int assembleFile(string fileName, vector<unsigned int> &words)
+{
+	ifstream infile(fileName);
+	if (!infile)
+	{
+		cout << fileName << ": error: could not open file" << endl;
+		return 1;
+	}
+	return assembleStream(infile, fileName, words);
+}
+
+void loadProgram(const vector<unsigned int> &words)
+{//places the program in instruction memory from location 1, as assembler() does for bubble.machine, or fetches one too large
+ //for it straight from the words the way a program image is fetched
+	if (words.size() > memory.size() - 1)
+	{
+		loadProgramText(words);
+		return;
+	}
+	for (size_t i = 0; i < words.size(); i++) memory.at(i + 1) = bitset<32>(words[i]).to_string();
+}
+
+bool writeMachineFile(const vector<unsigned int> &words, string fileName)
+{//one 32 character binary word per line, the format assembler() reads
+	ofstream outfile(fileName, ios::binary);
+	if (!outfile)
+	{
+		cout << fileName << ": error: could not open file" << endl;
+		return false;
+	}
+	string buffer;
+	buffer.reserve(words.size() * 33);
+	for (unsigned int word : words)
+	{
+		for (int bit = 31; bit >= 0; bit--) buffer += ((word >> bit) & 1) ? '1' : '0';
+		buffer += '\n';
+	}
+	outfile.write(buffer.data(), buffer.size());
+	return true;
+}
+
+bool loadAssembly(string fileName)
+{//assembles a source file into instruction memory, the replacement for machineCompliler()
+	vector<unsigned int> words;
+	int errors = assembleFile(fileName, words);
+	if (errors)
+	{
+		cout << fileName << ": " << errors << " error" << (errors == 1 ? "" : "s") << ", nothing loaded" << endl;
+		return false;
+	}
+	loadProgram(words);
+	return true;
+}
+
+int runAssembler(int argc, char* argv[])
+{//--assemble source output, writes a machine code file without running it
+	if (argc != 4)
+	{
+		cout << "Usage: --assemble source.assembly output.machine" << endl;
+		return 1;
+	}
+	vector<unsigned int> words;
+	int errors = assembleFile(argv[2], words);
+	if (errors)
+	{
+		cout << argv[2] << ": " << errors << " error" << (errors == 1 ? "" : "s") << endl;
+		return 1;
+	}
+	if (!writeMachineFile(words, argv[3])) return 1;
+	cout << "Assembled " << words.size() << " instructions, " << assemblySymbols.size() << " labels" << endl;
+	return 0;
+}
+
+string disassemble(const Instructions& instruction)
+{//assembler syntax for a decoded instruction, used in reports
+	auto reg = [](int number) { return "X" + to_string(number); };
+	if ((instruction.opcode >= opcodeVectorStore) && (instruction.opcode <= opcodeAcross)) return disassembleVector(instruction);
+	for (const AssemblyKeyword &keyword : assemblyKeywords)
+	{
+		if ((keyword.syntax == 'r') || (keyword.value != instruction.opcode)) continue;
+		if ((keyword.syntax == 'R') && keyword.extra && (keyword.extra != instruction.shamt)) continue; //SDIV or UDIV
+		if ((keyword.syntax == 'Q') && (keyword.extra != instruction.Rt)) continue; //condition
+
+		string text = keyword.name;
+		switch (keyword.syntax)
+		{
+			case 'R': return text + " " + reg(instruction.Rd) + ", " + reg(instruction.Rn) + ", " + reg(instruction.Rm);
+			case 'S': return text + " " + reg(instruction.Rd) + ", " + reg(instruction.Rn) + ", #" + to_string(instruction.shamt);
+			case 'J': return text + " " + reg(instruction.Rt);
+			case 'I': return text + " " + reg(instruction.Rd) + ", " + reg(instruction.Rn) + ", #" + to_string(instruction.ALU_immediate);
+			case 'D': return text + " " + reg(instruction.Rt) + ", [" + reg(instruction.Rn) + ", #" + to_string(instruction.DT_address) + "]";
+			case 'B': return text + " " + to_string(instruction.BR_address);
+			case 'C': return text + " " + reg(instruction.Rt) + ", " + to_string(instruction.COND_BR_address);
+			case 'Q': return text + " " + to_string(instruction.COND_BR_address);
+			case 'M': return text + " " + reg(instruction.Rd) + ", #" + to_string(instruction.MOV_immediate) + ", LSL #" + to_string(instruction.LSL * 16);
+			case 'V': case 'K': return text + " #" + to_string(instruction.shamt);
+			case 'P': return text + " " + reg(instruction.Rd) + ", #" + to_string(instruction.shamt);
+			default: return text;
+		}
+	}
+	int plugin = pluginIndex(instruction.opcode);
+	if (plugin >= 0)
+	{
+		if (instruction.format == 'I')
+			return pluginName(plugin) + " " + reg(instruction.Rd) + ", " + reg(instruction.Rn) + ", #" + to_string(instruction.ALU_immediate);
+		return pluginName(plugin) + " " + reg(instruction.Rd) + ", " + reg(instruction.Rn) + ", " + reg(instruction.Rm);
+	}
+	return "unknown opcode " + to_string(instruction.opcode);
+}
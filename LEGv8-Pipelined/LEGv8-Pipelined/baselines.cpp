@@ -0,0 +1,163 @@
+//Single-cycle and multi-cycle baselines
+/*
+unpipelined() charges four cycles for every instruction. The textbook alternatives to a pipeline are timed here from the
+retired instruction stream, so a run can be compared with both:
+
+	single-cycle    every instruction takes one long cycle, sized by the slowest instruction (a load through instruction
+	                memory, register read, ALU, data memory and register write)
+	multi-cycle     a finite state machine steps each instruction through only the states it needs: fetch, decode and
+	                branch completion for a branch, and execute plus register write for ALU instructions, a memory state
+	                for stores and both for loads. The states of a class are set with --multicycle-states (defaults alu 4,
+	                mul 6, div 15, load 5, store 4, branch 3, mul and div repeating execute while the unit iterates).
+	                With --units the execute state of each class repeats for its unit's latency instead, whether or not
+	                the unit is pipelined since the machine runs one instruction at a time, and --multicycle-states is refused
+
+Neither overlaps instructions, so the cycles depend only on the classes retired (the latency classes of dataflow.cpp) and
+not on their order. Each model has its own cycle time, --cycle-time single=ps,multi=ps,stage=ps (defaults 800, 200 and 200
+picoseconds, stage being the clock of the four stage processor both unpipelined() and pipelined() run on), which turns the
+cycles into run times and the speedup of the measured run over each baseline.
+
+	--baselines trace [--multicycle-states class=cycles,...] [--cycle-time single=ps,multi=ps,stage=ps]
+	--speedup                           as a run option, reports the run it is given with, which takes the same options
+*/
+
+#include <iostream>
+#include <string>
+#include <array>
+#include <sstream>
+#include <iomanip>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+array<int, latencyClasses> multiCycleStates = { 4, 6, 15, 5, 4, 3 };
+const array<int, latencyClasses> multiCycleOtherStates = { 3, 3, 3, 4, 3, 2 }; //the states of each class besides execute
+bool multiCycleStatesGiven = false;
+double singleCyclePicoseconds = 800;
+double multiCyclePicoseconds = 200;
+double stagePicoseconds = 200;
+array<long long, latencyClasses> baselineMix;
+
+void baselineRetire(const TraceRecord &record)
+{
+	const DecodedInstruction &instruction = decodedWord(record.word);
+	baselineMix[dependencesOf(instruction, record.size && !record.store, record.size && record.store).latency]++;
+}
+
+void reportBaselines(long long cycles, long long retired, string measuredName)
+{
+	long long instructions = 0, multiCycles = 0;
+	for (int i = 0; i < latencyClasses; i++)
+	{
+		instructions += baselineMix[i];
+		multiCycles += baselineMix[i] * multiCycleStates[i];
+	}
+
+	cout << "Baselines: " << instructions << " instructions" << fixed << setprecision(2) << endl;
+	cout << setw(10) << "Class" << setw(14) << "Instructions" << setw(8) << "States" << setw(14) << "Cycles" << setw(9) << "Share" << endl;
+	for (int i = 0; i < latencyClasses; i++)
+	{
+		if (!baselineMix[i]) continue;
+		long long classCycles = baselineMix[i] * multiCycleStates[i];
+		cout << setw(10) << latencyClassNames[i] << setw(14) << baselineMix[i] << setw(8) << multiCycleStates[i] << setw(14)
+			<< classCycles << setw(8) << 100.0 * classCycles / multiCycles << "%" << endl;
+	}
+
+	double singleTime = instructions * singleCyclePicoseconds / 1000;
+	double multiTime = multiCycles * multiCyclePicoseconds / 1000;
+	double measuredTime = cycles * stagePicoseconds / 1000;
+	cout << setprecision(1);
+	cout << "Single-cycle: " << instructions << " cycles of " << singleCyclePicoseconds << " ps, " << singleTime << " ns" << endl;
+	cout << "Multi-cycle: " << multiCycles << " cycles of " << multiCyclePicoseconds << " ps, " << multiTime << " ns, CPI "
+		<< setprecision(2) << (instructions ? double(multiCycles) / instructions : 0) << setprecision(1) << endl;
+	if (retired && cycles)
+	{
+		cout << "Measured (" << measuredName << "): " << cycles << " cycles of " << stagePicoseconds << " ps, " << measuredTime
+			<< " ns, " << setprecision(2) << singleTime / measuredTime << "x single-cycle, " << multiTime / measuredTime << "x multi-cycle" << endl;
+	}
+	cout.unsetf(ios::floatfield);
+}
+
+bool parseCycleTimes(string text)
+{//single=800,multi=200,stage=200
+	stringstream list(text);
+	string item;
+	while (getline(list, item, ','))
+	{
+		size_t equals = item.find('=');
+		string name = item.substr(0, equals);
+		double picoseconds = (equals == string::npos) ? 0 : atof(item.c_str() + equals + 1);
+		if ((picoseconds > 0) && (name == "single")) singleCyclePicoseconds = picoseconds;
+		else if ((picoseconds > 0) && (name == "multi")) multiCyclePicoseconds = picoseconds;
+		else if ((picoseconds > 0) && (name == "stage")) stagePicoseconds = picoseconds;
+		else
+		{
+			cout << "Bad cycle time '" << item << "', expected single=ps, multi=ps or stage=ps" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int parseBaselineOption(int argc, char* argv[], int i)
+{//number of arguments used by the baseline option at argv[i], 0 when it is not one, -1 on error
+	string option = argv[i];
+	if (i + 1 >= argc) return 0;
+	if (option == "--multicycle-states")
+	{
+		multiCycleStatesGiven = true;
+		return parseClassCycles(argv[i + 1], multiCycleStates, "state count") ? 2 : -1;
+	}
+	if (option == "--cycle-time") return parseCycleTimes(argv[i + 1]) ? 2 : -1;
+	return 0;
+}
+
+bool startBaselines()
+{
+	if (unitTiming)
+	{//the state counts follow the unit table, which sets the execute latency of every class
+		if (multiCycleStatesGiven)
+		{
+			cout << "--multicycle-states cannot be combined with --units, the states come from the unit latencies" << endl;
+			return false;
+		}
+		for (int i = 0; i < latencyClasses; i++) multiCycleStates[i] = multiCycleOtherStates[i] + unitClasses[i].latency;
+	}
+	baselineMix.fill(0);
+	addTraceListener(baselineRetire);
+	return true;
+}
+
+void finishBaselines()
+{
+	reportBaselines(clockCycles, instructionsRetired, pipeline ? "pipelined" : "unpipelined");
+}
+
+int runBaselines(int argc, char* argv[])
+{//--baselines trace [--multicycle-states class=cycles,...] [--cycle-time single=ps,multi=ps,stage=ps]
+	string usage = "Usage: --baselines trace [--multicycle-states class=cycles,...] [--cycle-time single=ps,multi=ps,stage=ps]";
+	if (argc < 3)
+	{
+		cout << usage << endl;
+		return 1;
+	}
+	for (int i = 3; i < argc; i++)
+	{
+		int used = parseBaselineOption(argc, argv, i);
+		if (used < 0) return 1;
+		if (!used)
+		{
+			cout << "Unknown baselines option " << argv[i] << endl;
+			cout << usage << endl;
+			return 1;
+		}
+		i += used - 1;
+	}
+
+	baselineMix.fill(0);
+	TraceSummary summary;
+	if (!readTrace(argv[2], baselineRetire, &summary)) return 1;
+	reportBaselines(summary.cycles, summary.records, summary.pipelined ? "recorded pipelined" : "recorded unpipelined");
+	return 0;
+}
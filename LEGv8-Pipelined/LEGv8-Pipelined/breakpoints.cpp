@@ -0,0 +1,268 @@
+//Breakpoints and watchpoints
+/*
+Breakpoints stop the debugger console (debugger.cpp) when an instruction memory location is fetched, optionally only while a
+register comparison holds. Watchpoints stop it when a load or store touches a range of data memory. Both are found without
+cost to runs that set none:
+
+	breakpointMap   one byte per instruction location, set where any breakpoint is. fetchInstruction() looks its location
+	                up and notes a hit, and the map is empty until the first breakpoint so a run without any pays a single
+	                size comparison per fetch
+	watchTags       one byte per 4 KiB page of data memory, bit 0 when a read watchpoint covers part of the page and bit 1
+	                for a write watchpoint. storeDataMemory() and loadDataMemory() test the tag of the page an access starts
+	                in, and only accesses to tagged pages are compared with the watched ranges. A range also tags the page
+	                before it when it starts within 8 bytes of the boundary, since an access can straddle the two
+
+Breakpoint conditions are tested once the step that fetched the location has finished, against the registers at that point.
+Going back, rcontinue stops at breakpoints and write watchpoints, found in the undo records; loads are not logged, so read
+watchpoints only stop forward execution.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cctype>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct Breakpoint
+{
+	int number;
+	int location;
+	int registerNumber; //-1 when unconditional
+	string comparison; //==, !=, <, <=, > or >=
+	long long value;
+};
+
+struct Watchpoint
+{
+	int number;
+	int address;
+	int bytes;
+	unsigned char kind; //watchRead, watchWrite or both
+};
+
+vector<unsigned char> breakpointMap;
+array<unsigned char, 256> watchTags;
+int breakpointPending = -1; //location fetched during this step that has a breakpoint
+string debugStop; //why the last step stopped, empty when it did not
+
+vector<Breakpoint> breakpoints;
+vector<Watchpoint> watchpoints;
+int debugPointNumber = 1;
+
+static_assert(sizeof(watchTags) == sizeof(dataMemory) >> watchPageShift, "one watch tag per data memory page");
+
+void rebuildDebugMaps()
+{
+	breakpointMap.clear();
+	for (const Breakpoint &point : breakpoints)
+	{
+		if (point.location >= (int)breakpointMap.size()) breakpointMap.resize(point.location + 1, 0);
+		breakpointMap[point.location] = 1;
+	}
+	watchTags.fill(0);
+	for (const Watchpoint &watch : watchpoints)
+	{
+		int first = max(0, watch.address - 7) >> watchPageShift;
+		int last = (watch.address + watch.bytes - 1) >> watchPageShift;
+		for (int page = first; (page <= last) && (page < (int)watchTags.size()); page++) watchTags[page] |= watch.kind;
+	}
+}
+
+bool compareRegister(const Breakpoint &point)
+{
+	if (point.registerNumber < 0) return true;
+	long long value = (point.registerNumber == 31) ? 0 : registers[point.registerNumber];
+	if (point.comparison == "==") return value == point.value;
+	if (point.comparison == "!=") return value != point.value;
+	if (point.comparison == "<") return value < point.value;
+	if (point.comparison == "<=") return value <= point.value;
+	if (point.comparison == ">") return value > point.value;
+	return value >= point.value;
+}
+
+bool breakpointAt(int location)
+{//the first breakpoint at location whose condition holds, reported in debugStop
+	if ((location < 0) || (location >= (int)breakpointMap.size()) || !breakpointMap[location]) return false;
+	for (const Breakpoint &point : breakpoints)
+	{
+		if ((point.location != location) || !compareRegister(point)) continue;
+		debugStop = "Breakpoint " + to_string(point.number) + " at location " + to_string(location);
+		return true;
+	}
+	return false;
+}
+
+void watchAccess(int location, int size, bool store)
+{//called for accesses to tagged pages
+	for (const Watchpoint &watch : watchpoints)
+	{
+		if (!(watch.kind & (store ? watchWrite : watchRead))) continue;
+		if ((location + size <= watch.address) || (location >= watch.address + watch.bytes)) continue;
+		if (debugStop.empty())
+			debugStop = "Watchpoint " + to_string(watch.number) + ": " + (store ? "store of " : "load of ") + to_string(size)
+				+ " bytes at " + to_string(location);
+		return;
+	}
+}
+
+bool watchedWrite(int location, int size)
+{
+	for (const Watchpoint &watch : watchpoints)
+	{
+		if (!(watch.kind & watchWrite) || (location + size <= watch.address) || (location >= watch.address + watch.bytes)) continue;
+		debugStop = "Watchpoint " + to_string(watch.number) + ": store of " + to_string(size) + " bytes at " + to_string(location);
+		return true;
+	}
+	return false;
+}
+
+void beginDebugStep()
+{
+	breakpointPending = -1;
+	debugStop.clear();
+}
+
+bool endDebugStep()
+{//true when the step that just finished should stop the console
+	if (breakpointPending >= 0) breakpointAt(breakpointPending);
+	return !debugStop.empty();
+}
+
+bool stoppedBackwards()
+{//whether rcontinue should stop in the state after the newest logged step
+	debugStop.clear();
+	if (breakpointAt(fetchLocation)) return true;
+	for (const pair<int, int> &write : lastStepWrites())
+		if (watchedWrite(write.first, write.second)) return true;
+	return false;
+}
+
+int parseLocation(string text)
+{//instruction location number or assembly label, -1 when neither
+	auto label = assemblySymbols.find(text);
+	if (label != assemblySymbols.end()) return label->second;
+	try
+	{
+		size_t used;
+		int location = stoi(text, &used, 0);
+		bool fetchable = (location > 0) && (location < max((int)memory.size(), imageTextWords + 1));
+		return ((used == text.size()) && fetchable) ? location : -1;
+	}
+	catch (const exception &)
+	{
+		return -1;
+	}
+}
+
+bool addBreakpoint(string arguments)
+{//location [if Xn op value]
+	stringstream words(arguments);
+	string locationText, keyword, registerText, comparison, valueText;
+	words >> locationText >> keyword >> registerText >> comparison >> valueText;
+	Breakpoint point = { debugPointNumber, parseLocation(locationText), -1, "", 0 };
+	if (point.location < 0)
+	{
+		cout << "Usage: break location|label [if Xn ==|!=|<|<=|>|>= value]" << endl;
+		return false;
+	}
+	if (!keyword.empty())
+	{
+		bool comparisonOk = false;
+		for (string known : { "==", "!=", "<", "<=", ">", ">=" }) if (comparison == known) comparisonOk = true;
+		if ((keyword != "if") || (registerText.size() < 2) || (toupper(registerText[0]) != 'X') || !comparisonOk || valueText.empty())
+		{
+			cout << "Usage: break location|label [if Xn ==|!=|<|<=|>|>= value]" << endl;
+			return false;
+		}
+		try
+		{
+			point.registerNumber = stoi(registerText.substr(1));
+			point.value = stoll(valueText, nullptr, 0);
+		}
+		catch (const exception &)
+		{
+			point.registerNumber = -2;
+		}
+		if ((point.registerNumber < 0) || (point.registerNumber > 31))
+		{
+			cout << "Bad condition " << registerText << " " << comparison << " " << valueText << endl;
+			return false;
+		}
+		point.comparison = comparison;
+	}
+	breakpoints.push_back(point);
+	debugPointNumber++;
+	rebuildDebugMaps();
+	cout << "Breakpoint " << point.number << " at location " << point.location << endl;
+	return true;
+}
+
+bool addWatchpoint(string arguments)
+{//address [bytes] [read|write|access], commas also separate them
+	replace(arguments.begin(), arguments.end(), ',', ' ');
+	stringstream words(arguments);
+	string addressText, bytesText = "8", kindText = "write";
+	words >> addressText;
+	if (words >> bytesText && !isdigit((unsigned char)bytesText[0]))
+	{
+		kindText = bytesText;
+		bytesText = "8";
+	}
+	else words >> kindText;
+
+	Watchpoint watch = { debugPointNumber, -1, 0, 0 };
+	try
+	{
+		watch.address = stoi(addressText, nullptr, 0);
+		watch.bytes = stoi(bytesText, nullptr, 0);
+	}
+	catch (const exception &)
+	{
+		watch.address = -1;
+	}
+	if (kindText == "read") watch.kind = watchRead;
+	else if (kindText == "write") watch.kind = watchWrite;
+	else if (kindText == "access") watch.kind = watchRead | watchWrite;
+	if ((watch.address < 0) || (watch.bytes < 1) || (watch.address + watch.bytes > (int)dataMemory.size()) || !watch.kind)
+	{
+		cout << "Usage: watch address [bytes] [read|write|access], within data memory" << endl;
+		return false;
+	}
+	watchpoints.push_back(watch);
+	debugPointNumber++;
+	rebuildDebugMaps();
+	cout << "Watchpoint " << watch.number << " on " << watch.bytes << " bytes at " << watch.address << endl;
+	return true;
+}
+
+void deleteDebugPoint(int number)
+{//0 deletes them all
+	size_t before = breakpoints.size() + watchpoints.size();
+	auto matches = [number](int pointNumber) { return !number || (pointNumber == number); };
+	breakpoints.erase(remove_if(breakpoints.begin(), breakpoints.end(), [&](const Breakpoint &point) { return matches(point.number); }),
+		breakpoints.end());
+	watchpoints.erase(remove_if(watchpoints.begin(), watchpoints.end(), [&](const Watchpoint &watch) { return matches(watch.number); }),
+		watchpoints.end());
+	rebuildDebugMaps();
+	if (breakpoints.size() + watchpoints.size() == before) cout << "No breakpoint or watchpoint " << number << endl;
+}
+
+void listDebugPoints()
+{
+	if (breakpoints.empty() && watchpoints.empty()) cout << "No breakpoints or watchpoints" << endl;
+	for (const Breakpoint &point : breakpoints)
+	{
+		cout << point.number << ": break at location " << point.location;
+		if (point.registerNumber >= 0) cout << " if X" << point.registerNumber << " " << point.comparison << " " << point.value;
+		cout << endl;
+	}
+	for (const Watchpoint &watch : watchpoints)
+		cout << watch.number << ": watch " << ((watch.kind == watchRead) ? "read" : (watch.kind == watchWrite) ? "write" : "access")
+		<< " of " << watch.bytes << " bytes at " << watch.address << endl;
+}
@@ -0,0 +1,248 @@
+//Single pass cache sweep
+/*
+Miss ratios for every LRU cache size and associativity from one pass over the data accesses, using Mattson's stack algorithm.
+For a given number of sets each set keeps its lines in recency order, and the depth an accessed line is found at (its stack
+distance) decides the outcome for every associativity at once: the access hits in an A way cache exactly when the depth is
+below A. One histogram of depths per set count therefore covers every cache of that set count, and the set counts are shared out
+between threads since each one only reads the access stream.
+
+	--cachesim trace [--line bytes] [--max-size bytes] [--max-ways N] [--threads N] [--csv file]
+	--cache-sweep file                  as a run option, sweeps the accesses of that run with the default geometry
+
+The accesses are the LDUR/STUR family data accesses of retired instructions, vector ones included, from a --trace file or live from the run. Stores
+allocate like loads, and an access that straddles two lines touches both. Sizes go up in powers of two from one line to
+--max-size (default 64 KiB) with 1, 2, 4 ... --max-ways ways (default 16) and fully associative.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct CacheGeometry
+{
+	int lineBytes = 64;
+	int maxBytes = 65536;
+	int maxWays = 16;
+	int threads = 0; //0 uses every hardware thread
+};
+
+struct StackHistogram
+{//hits by stack distance for one set count, anything deeper than the tracked depth is a miss in every tracked cache
+	int sets;
+	vector<long long> depth;
+	long long misses;
+};
+
+vector<unsigned int> cacheAccesses; //data address << 4 | size - 1, up to the 16 bytes of a vector access
+long long cacheLoads;
+long long cacheStores;
+string cacheSweepName;
+
+void collectAccess(const TraceRecord &record)
+{
+	if (!record.size) return;
+	if ((record.address < 0) || (record.address + record.size > (long long)dataMemory.size())) return;
+	cacheAccesses.push_back((unsigned int)(record.address << 4) | (record.size - 1));
+	if (record.store) cacheStores++;
+	else cacheLoads++;
+}
+
+void stackDistances(const vector<unsigned int> &lines, StackHistogram &histogram, int tracked)
+{//one pass of Mattson's algorithm for one set count
+	vector<vector<unsigned int>> stacks(histogram.sets);
+	histogram.depth.assign(tracked, 0);
+	histogram.misses = 0;
+	unsigned int setMask = histogram.sets - 1;
+
+	for (unsigned int line : lines)
+	{
+		vector<unsigned int> &stack = stacks[line & setMask];
+		auto found = find(stack.begin(), stack.end(), line);
+		if (found == stack.end())
+		{
+			histogram.misses++;
+			if ((int)stack.size() < tracked) stack.push_back(line);
+			else stack.back() = line;
+			found = stack.end() - 1;
+		}
+		else histogram.depth[found - stack.begin()]++;
+		rotate(stack.begin(), found, found + 1); //move to the most recently used end
+	}
+}
+
+vector<StackHistogram> sweepCaches(const CacheGeometry &geometry)
+{
+	vector<unsigned int> lines; //the line stream, each access split at line boundaries
+	lines.reserve(cacheAccesses.size());
+	for (unsigned int access : cacheAccesses)
+	{
+		unsigned int address = access >> 4;
+		unsigned int last = address + (access & 15);
+		for (unsigned int line = address / geometry.lineBytes; line <= last / geometry.lineBytes; line++) lines.push_back(line);
+	}
+
+	int maxLines = geometry.maxBytes / geometry.lineBytes;
+	vector<StackHistogram> histograms;
+	for (int sets = 1; sets <= maxLines; sets *= 2) histograms.push_back({ sets, {}, 0 });
+
+	int threads = geometry.threads ? geometry.threads : max(1, (int)thread::hardware_concurrency());
+	threads = min(threads, (int)histograms.size());
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(thread([&, t]()
+		{//set counts are dealt out round robin, the fully associative stack is the deepest and goes first
+			for (size_t i = t; i < histograms.size(); i += threads)
+			{
+				int sets = histograms[i].sets;
+				int tracked = (sets == 1) ? maxLines : min(geometry.maxWays, maxLines / sets);
+				stackDistances(lines, histograms[i], tracked);
+			}
+		}));
+	}
+	for (thread &worker : workers) worker.join();
+	return histograms;
+}
+
+long long missesFor(const StackHistogram &histogram, int ways)
+{
+	long long misses = histogram.misses;
+	for (size_t depth = ways; depth < histogram.depth.size(); depth++) misses += histogram.depth[depth];
+	return misses;
+}
+
+bool reportCacheSweep(const CacheGeometry &geometry, string csvName)
+{
+	vector<StackHistogram> histograms = sweepCaches(geometry);
+	long long accesses = histograms[0].misses;
+	for (long long hits : histograms[0].depth) accesses += hits;
+	int maxLines = geometry.maxBytes / geometry.lineBytes;
+
+	vector<int> columns; //associativities, 0 for fully associative
+	for (int ways = 1; ways <= geometry.maxWays; ways *= 2) columns.push_back(ways);
+	columns.push_back(0);
+
+	ofstream csv;
+	if (!csvName.empty())
+	{
+		csv.open(csvName);
+		if (!csv)
+		{
+			cout << csvName << ": error: could not open file" << endl;
+			return false;
+		}
+		csv << "size,ways,sets,line,accesses,misses,miss_ratio" << endl;
+	}
+
+	cout << cacheLoads << " loads, " << cacheStores << " stores, " << accesses << " line accesses of " << geometry.lineBytes << " bytes" << endl;
+	cout << "Miss ratio (%)" << endl << setw(10) << "Size";
+	for (int ways : columns) cout << setw(9) << (ways ? to_string(ways) + "-way" : "full");
+	cout << endl;
+
+	for (int lines = 1; lines <= maxLines; lines *= 2)
+	{
+		cout << setw(10) << (long long)lines * geometry.lineBytes;
+		for (int ways : columns)
+		{
+			int effectiveWays = ways ? ways : lines;
+			if (effectiveWays > lines)
+			{
+				cout << setw(9) << "";
+				continue;
+			}
+			int sets = lines / effectiveWays;
+			int index = 0;
+			while ((1 << index) < sets) index++;
+			const StackHistogram &histogram = histograms[index];
+			long long misses = missesFor(histogram, effectiveWays);
+			double ratio = accesses ? 100.0 * misses / accesses : 0;
+			cout << setw(9) << fixed << setprecision(2) << ratio;
+			if (csv.is_open() && (ways || (lines > geometry.maxWays)))
+				csv << (long long)lines * geometry.lineBytes << "," << effectiveWays << "," << sets << "," << geometry.lineBytes << ","
+				<< accesses << "," << misses << "," << ratio / 100 << endl;
+		}
+		cout << endl;
+	}
+	cout.unsetf(ios::floatfield);
+	return true;
+}
+
+bool parseGeometry(CacheGeometry &geometry)
+{
+	bool power = (geometry.lineBytes > 0) && !(geometry.lineBytes & (geometry.lineBytes - 1)) && (geometry.maxWays > 0)
+		&& !(geometry.maxWays & (geometry.maxWays - 1));
+	if (!power || (geometry.lineBytes > 4096) || (geometry.maxBytes < geometry.lineBytes) || (geometry.threads < 0))
+	{
+		cout << "--line and --max-ways must be powers of two, and --max-size at least one line" << endl;
+		return false;
+	}
+	int lines = geometry.maxBytes / geometry.lineBytes;
+	while (lines & (lines - 1)) lines &= lines - 1; //round down to a power of two
+	geometry.maxBytes = lines * geometry.lineBytes;
+	return true;
+}
+
+int runCacheSim(int argc, char* argv[])
+{//--cachesim trace [--line bytes] [--max-size bytes] [--max-ways N] [--threads N] [--csv file]
+	string usage = "Usage: --cachesim trace [--line bytes] [--max-size bytes] [--max-ways N] [--threads N] [--csv file]";
+	if (argc < 3)
+	{
+		cout << usage << endl;
+		return 1;
+	}
+	CacheGeometry geometry;
+	string csvName;
+	for (int i = 3; i < argc; i++)
+	{
+		string option = argv[i];
+		try
+		{
+			if ((option == "--line") && (i + 1 < argc)) geometry.lineBytes = stoi(argv[++i]);
+			else if ((option == "--max-size") && (i + 1 < argc)) geometry.maxBytes = stoi(argv[++i]);
+			else if ((option == "--max-ways") && (i + 1 < argc)) geometry.maxWays = stoi(argv[++i]);
+			else if ((option == "--threads") && (i + 1 < argc)) geometry.threads = stoi(argv[++i]);
+			else if ((option == "--csv") && (i + 1 < argc)) csvName = argv[++i];
+			else
+			{
+				cout << "Unknown cache sweep option " << option << endl;
+				cout << usage << endl;
+				return 1;
+			}
+		}
+		catch (const exception &)
+		{
+			cout << "Malformed number in " << option << " option" << endl;
+			return 1;
+		}
+	}
+	if (!parseGeometry(geometry)) return 1;
+
+	cacheAccesses.clear();
+	cacheLoads = 0;
+	cacheStores = 0;
+	if (!readTrace(argv[2], collectAccess)) return 1;
+	return reportCacheSweep(geometry, csvName) ? 0 : 1;
+}
+
+void startCacheSweep(string csvName)
+{
+	cacheSweepName = csvName;
+	cacheAccesses.clear();
+	cacheLoads = 0;
+	cacheStores = 0;
+	addTraceListener(collectAccess);
+}
+
+bool finishCacheSweep()
+{
+	CacheGeometry geometry;
+	return reportCacheSweep(geometry, cacheSweepName);
+}
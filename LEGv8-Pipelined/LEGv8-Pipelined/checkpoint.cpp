@@ -0,0 +1,215 @@
+//Checkpoints and fast forward
+/*
+A checkpoint file holds the whole simulator state, so a run can be stopped and taken up again later or in another process:
+
+	header      CheckpointHeader, 56 bytes
+	text        one 32 bit word per instruction memory location, location 1 first
+	state       stateFields() as 32 bit ints: the registers, the vector registers, PC, SP, endProgram, fetchLocation and
+	            every int field of the decode, execute and writeback latches, then stateCounters() as 64 bit ints:
+	            clockCycles and stallUntil
+	data        the data memory pages that are not all zero, each a 32 bit page number and its 4096 bytes
+
+The condition, hazard and branch flags and the latch formats are in the header, packed as packStateFlags() packs them. The
+processor has no caches or predictors whose state would need saving; the pipeline latches are the whole of its model state.
+The version changes whenever the state layout does, and a checkpoint of another version is refused.
+
+	--fast-forward N    runs the first N instructions on the co-simulation reference model (cosim.cpp), which executes
+	                    without pipeline latches or per stage output, then empties the pipeline and starts the detailed run
+	                    there with clockCycles and the retired count at 0. It stops early at EXIT
+	--checkpoint file   saves a checkpoint where the detailed run starts, after any fast forward or restore
+	--restore file      starts from a checkpoint instead of bubble.machine, --asm or --load
+
+The debugger console saves one at any step with save file. A checkpoint taken before the first cycle of a detailed run, as the
+fast forward ones are, has an empty pipeline and restores into either mode; any other one restores only into the mode it was
+taken in.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct CheckpointHeader
+{
+	char magic[8]; //LEGV8CKP
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned int textWords;
+	unsigned int stateFields;
+	unsigned int dataPages;
+	unsigned int pipelined; //execution mode it was taken in
+	unsigned int drained; //1 when taken before the first cycle, so it restores into either mode
+	unsigned int stateCounters;
+	unsigned long long retired;
+	unsigned long long flags;
+};
+
+static_assert(sizeof(CheckpointHeader) == 56, "checkpoint header layout changed");
+
+const char checkpointMagic[8] = { 'L', 'E', 'G', 'V', '8', 'C', 'K', 'P' };
+const unsigned int checkpointVersion = 4; //2 added stallUntil, 3 the vector registers, 4 widened the clock to 64 bits
+const int checkpointPageBytes = 4096;
+
+bool saveCheckpoint(string fileName)
+{
+	vector<unsigned int> text = currentText();
+	vector<int*> fields = stateFields();
+	vector<long long*> counters = stateCounters();
+	vector<unsigned int> pages;
+	for (unsigned int page = 0; page < dataMemory.size() / checkpointPageBytes; page++)
+	{
+		const unsigned char *bytes = dataMemory.data() + page * checkpointPageBytes;
+		for (int i = 0; i < checkpointPageBytes; i++)
+		{
+			if (!bytes[i]) continue;
+			pages.push_back(page);
+			break;
+		}
+	}
+
+	CheckpointHeader header = {};
+	memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+	header.version = checkpointVersion;
+	header.headerSize = sizeof(CheckpointHeader);
+	header.textWords = (unsigned int)text.size();
+	header.stateFields = (unsigned int)fields.size();
+	header.stateCounters = (unsigned int)counters.size();
+	header.dataPages = (unsigned int)pages.size();
+	header.pipelined = pipeline;
+	header.drained = (clockCycles == 0);
+	header.retired = instructionsRetired;
+	header.flags = packStateFlags();
+
+	ofstream outfile(fileName, ios::binary);
+	if (!outfile)
+	{
+		cout << fileName << ": error: could not open file" << endl;
+		return false;
+	}
+	outfile.write((const char*)&header, sizeof(header));
+	outfile.write((const char*)text.data(), 4 * text.size());
+	for (int *field : fields) outfile.write((const char*)field, sizeof(int));
+	for (long long *counter : counters) outfile.write((const char*)counter, sizeof(long long));
+	for (unsigned int page : pages)
+	{
+		outfile.write((const char*)&page, sizeof(page));
+		outfile.write((const char*)dataMemory.data() + page * checkpointPageBytes, checkpointPageBytes);
+	}
+	if (!outfile)
+	{
+		cout << fileName << ": error: could not write file" << endl;
+		return false;
+	}
+	cout << "Checkpoint at cycle " << clockCycles << " written to " << fileName << " (" << text.size() << " instructions, "
+		<< pages.size() << " data pages)" << endl;
+	return true;
+}
+
+bool restoreCheckpoint(string fileName)
+{//replaces the program and the whole processor state
+	ifstream infile(fileName, ios::binary);
+	CheckpointHeader header = {};
+	infile.read((char*)&header, sizeof(header));
+	vector<int*> fields = stateFields();
+	vector<long long*> counters = stateCounters();
+
+	string problem;
+	if (!infile)
+		problem = "could not read file";
+	else if (memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)))
+		problem = "not a checkpoint";
+	else if ((header.version != checkpointVersion) || (header.headerSize != sizeof(CheckpointHeader)) || (header.stateFields != fields.size())
+		|| (header.stateCounters != counters.size()))
+		problem = "unsupported checkpoint version " + to_string(header.version);
+	else if (!header.drained && ((header.pipelined != 0) != pipeline))
+		problem = string("taken mid-run in ") + (header.pipelined ? "pipelined" : "unpipelined") + " mode, restore it in that mode";
+
+	vector<unsigned int> text(header.textWords);
+	vector<int> values(fields.size());
+	vector<long long> counterValues(counters.size());
+	if (problem.empty())
+	{
+		infile.read((char*)text.data(), 4 * text.size());
+		infile.read((char*)values.data(), sizeof(int) * values.size());
+		infile.read((char*)counterValues.data(), sizeof(long long) * counterValues.size());
+		if (!infile) problem = "file ends early";
+	}
+	if (!problem.empty())
+	{
+		cout << fileName << ": error: " << problem << endl;
+		return false;
+	}
+
+	unloadProgramImage();
+	memory.fill("");
+	loadProgram(text);
+	dataMemory.fill(0);
+	for (unsigned int i = 0; i < header.dataPages; i++)
+	{
+		unsigned int page = 0;
+		infile.read((char*)&page, sizeof(page));
+		if (!infile || (page >= dataMemory.size() / checkpointPageBytes))
+		{
+			cout << fileName << ": error: bad data page" << endl;
+			return false;
+		}
+		infile.read((char*)dataMemory.data() + page * checkpointPageBytes, checkpointPageBytes);
+	}
+	if (!infile)
+	{
+		cout << fileName << ": error: file ends early" << endl;
+		return false;
+	}
+
+	clearStall();
+	resetUnits();
+	for (size_t i = 0; i < fields.size(); i++) *fields[i] = values[i];
+	for (size_t i = 0; i < counters.size(); i++) *counters[i] = counterValues[i];
+	instructionsRetired = header.retired;
+	resetCounters();
+	unpackStateFlags(header.flags);
+	fetchInstruction(fetchLocation);
+	cout << "Restored checkpoint at cycle " << clockCycles << ", PC " << PC << " from " << fileName << endl;
+	return true;
+}
+
+bool fastForward(long long instructions)
+{//runs the reference model, then starts the pipeline empty at the instruction after the last one it executed
+	string error;
+	startCosim();
+	long long executed = runReference(instructions, error);
+	if (!error.empty())
+	{
+		cout << "fast forward: error after " << executed << " instructions: " << error << endl;
+		return false;
+	}
+	adoptReference();
+	emptyPipeline();
+	cout << "Fast forwarded " << executed << " instructions to PC " << PC << endl;
+	return true;
+}
+
+void emptyPipeline()
+{//bubbles in every latch and the counters at 0, so the next cycle fetches PC as the first one of a run does
+	decodeVars = noOP;
+	executeVars = noOP;
+	writebackVars = noOP;
+	branched = false;
+	concurrentHazardn = false;
+	concurrentHazardt = false;
+	concurrentHazardm = false;
+	storeFlag = false;
+	loadFlag = false;
+	clockCycles = 0;
+	instructionsRetired = 0;
+	endProgram = 0;
+	clearStall();
+	resetUnits();
+	resetCounters();
+	fetchInstruction(PC);
+}
@@ -0,0 +1,455 @@
+//Lockstep co-simulation checker
+/*
+A functional reference model runs beside the timing model and is stepped once for every instruction that retires in writeback().
+The reference takes the retiring instruction's fields from writebackVars, so both sides share decode() and the predecoded image
+records, and only the execution is independent. After each step the retiring location, all 32 registers and every byte the
+instruction wrote are compared, and the first difference stops the run with a report of the instruction and each mismatching value.
+The 32 vector registers of simd.cpp are compared with the scalar ones; the reference always computes vector instructions with the
+portable loops, so the host SIMD path is checked against them.
+
+The reference follows the LEGv8 definition on 32 bit registers rather than the behaviour of execute(): X31 always reads as zero,
+ADDS/SUBS/ANDS set all four flags and the flags stay set until the next flag setting instruction, LSR is a logical shift, LDURB and
+LDURH zero extend, LDXR loads a double word, MOVZ/MOVK write their register, and SMULH/UMULH return the upper 32 bits of the product.
+
+The reference also runs alone, much faster than either mode, for --fast-forward (checkpoint.cpp): runReference() steps it from
+the current state and adoptReference() hands its registers, vector registers, flags, data memory and PC back to the timing model.
+
+In pipelined mode the instruction behind the retiring one has already executed this cycle, so the register a load or BL in execute
+writes, the vector register a vector instruction in execute writes and the bytes a store in execute writes are left out of that
+check. Data memory is compared in full when the run ends.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <array>
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+bool cosimEnabled = false;
+string cosimReport;
+
+int refPC;
+array<int, 32> refRegisters;
+array<VectorRegister, 32> refVectors;
+vector<unsigned char> refMemory;
+bool refN, refZ, refC, refV;
+long long cosimRetired;
+
+struct MemoryRange
+{
+	long long address;
+	int bytes;
+};
+
+void startCosim()
+{//called once the program and data are in place, the reference starts from the same state
+	refPC = PC;
+	refRegisters = registers;
+	refRegisters[31] = 0;
+	refVectors = vectorRegisters;
+	refMemory.assign(dataMemory.begin(), dataMemory.end());
+	refN = negativeFlag;
+	refZ = zeroFlag;
+	refC = carryFlag;
+	refV = overflowFlag;
+	cosimRetired = 0;
+	cosimReport.clear();
+}
+
+int storeSize(int opcode)
+{//bytes written by a store, 0 for anything else
+	switch (opcode)
+	{
+		case 0b11111000000: return 8; //STUR
+		case 0b11001000000: return 8; //STXR
+		case 0b10111000000: return 4; //STURW
+		case 0b01111000000: return 2; //STURH
+		case 0b00111000000: return 1; //STURB
+		case opcodeVectorStore: return 16; //STUR Q
+		default: return 0;
+	}
+}
+
+bool isLoad(int opcode)
+{//loads write their register in execute() rather than writeback()
+	return (opcode == 0b11111000010) || (opcode == 0b10111000100) || (opcode == 0b11001000010) || (opcode == 0b00111000010) || (opcode == 0b01111000010);
+}
+
+int readRef(int number)
+{
+	return (number == 31) ? 0 : refRegisters[number];
+}
+
+void writeRef(int number, int value)
+{
+	if (number != 31) refRegisters[number] = value;
+}
+
+void setRefFlags(int result, bool carry, bool overflow)
+{
+	refN = result < 0;
+	refZ = result == 0;
+	refC = carry;
+	refV = overflow;
+}
+
+int refAdd(int a, int b, bool setFlags)
+{
+	unsigned int result = (unsigned int)a + (unsigned int)b;
+	if (setFlags) setRefFlags((int)result, result < (unsigned int)a, ((a < 0) == (b < 0)) && (((int)result < 0) != (a < 0)));
+	return (int)result;
+}
+
+int refSub(int a, int b, bool setFlags)
+{
+	unsigned int result = (unsigned int)a - (unsigned int)b;
+	if (setFlags) setRefFlags((int)result, (unsigned int)a >= (unsigned int)b, ((a < 0) != (b < 0)) && (((int)result < 0) != (a < 0)));
+	return (int)result;
+}
+
+bool refCondition(int condition)
+{
+	bool result;
+	switch (condition >> 1)
+	{
+		case 0: result = refZ; break; //EQ
+		case 1: result = refC; break; //HS
+		case 2: result = refN; break; //MI
+		case 3: result = refV; break; //VS
+		case 4: result = refC && !refZ; break; //HI
+		case 5: result = refN == refV; break; //GE
+		case 6: result = (refN == refV) && !refZ; break; //GT
+		default: return true; //AL
+	}
+	return (condition & 1) ? !result : result;
+}
+
+bool refAddress(long long address, int bytes, string &error)
+{
+	if ((address >= 0) && (address + bytes <= (long long)refMemory.size())) return true;
+	error = "data address " + to_string(address) + ((address >= deviceBase) ? " is a device register, the reference has no devices" : " is outside data memory");
+	return false;
+}
+
+int refLoad(long long address, int bytes, bool signExtend)
+{
+	unsigned long long value = 0;
+	for (int i = bytes - 1; i >= 0; i--) value = (value << 8) | refMemory[address + i];
+	if (signExtend && (bytes < 8))
+	{
+		int unused = 64 - 8 * bytes;
+		value = (unsigned long long)((long long)(value << unused) >> unused);
+	}
+	return (int)value;
+}
+
+void refStore(int data, long long address, int bytes)
+{//registers are 32 bits wide, a double word store writes the sign extension in the upper half
+	long long value = data;
+	for (int i = 0; i < bytes; i++) refMemory[address + i] = (unsigned char)(value >> (8 * i));
+}
+
+bool stepReference(const Instructions &instruction, MemoryRange &written, string &error)
+{//executes one instruction on the reference state
+	int nextPC = instruction.location + 1;
+	int n = readRef(instruction.Rn);
+	int m = readRef(instruction.Rm);
+	int t = readRef(instruction.Rt);
+	long long address = (long long)n + instruction.DT_address;
+	written.bytes = 0;
+
+	switch (instruction.opcode)
+	{
+		case 0b000101: nextPC = instruction.location + instruction.BR_address; break; //B
+		case 0b100101: //BL
+			writeRef(30, instruction.location + 1);
+			nextPC = instruction.location + instruction.BR_address;
+			break;
+		case 0b11010110000: nextPC = t; break; //BR
+		case 0b10110100: if (t == 0) nextPC = instruction.location + instruction.COND_BR_address; break; //CBZ
+		case 0b10110101: if (t != 0) nextPC = instruction.location + instruction.COND_BR_address; break; //CBNZ
+		case 0b01010100: if (refCondition(instruction.Rt)) nextPC = instruction.location + instruction.COND_BR_address; break; //B.cond
+
+		case 0b10001011000: writeRef(instruction.Rd, refAdd(n, m, false)); break; //ADD
+		case 0b10101011000: writeRef(instruction.Rd, refAdd(n, m, true)); break; //ADDS
+		case 0b1001000100: writeRef(instruction.Rd, refAdd(n, instruction.ALU_immediate, false)); break; //ADDI
+		case 0b1011000100: writeRef(instruction.Rd, refAdd(n, instruction.ALU_immediate, true)); break; //ADDIS
+		case 0b11001011000: writeRef(instruction.Rd, refSub(n, m, false)); break; //SUB
+		case 0b11101011000: writeRef(instruction.Rd, refSub(n, m, true)); break; //SUBS
+		case 0b1101000100: writeRef(instruction.Rd, refSub(n, instruction.ALU_immediate, false)); break; //SUBI
+		case 0b1111000100: writeRef(instruction.Rd, refSub(n, instruction.ALU_immediate, true)); break; //SUBIS
+		case 0b10001010000: writeRef(instruction.Rd, n & m); break; //AND
+		case 0b11101010000: setRefFlags(n & m, false, false); writeRef(instruction.Rd, n & m); break; //ANDS
+		case 0b1001001000: writeRef(instruction.Rd, n & instruction.ALU_immediate); break; //ANDI
+		case 0b1111001000: setRefFlags(n & instruction.ALU_immediate, false, false); writeRef(instruction.Rd, n & instruction.ALU_immediate); break; //ANDIS
+		case 0b10101010000: writeRef(instruction.Rd, n | m); break; //ORR
+		case 0b1011001000: writeRef(instruction.Rd, n | instruction.ALU_immediate); break; //ORRI
+		case 0b11001010000: writeRef(instruction.Rd, n ^ m); break; //EOR
+		case 0b1101001000: writeRef(instruction.Rd, n ^ instruction.ALU_immediate); break; //EORI
+		case 0b11010011011: writeRef(instruction.Rd, (instruction.shamt < 32) ? (int)((unsigned int)n << instruction.shamt) : 0); break; //LSL
+		case 0b11010011010: writeRef(instruction.Rd, (instruction.shamt < 32) ? (int)((unsigned int)n >> instruction.shamt) : 0); break; //LSR
+		case 0b10011011000: writeRef(instruction.Rd, (int)((unsigned int)n * (unsigned int)m)); break; //MUL
+		case 0b10011011010: writeRef(instruction.Rd, (int)(((long long)n * m) >> 32)); break; //SMULH
+		case 0b10011011110: writeRef(instruction.Rd, (int)(((unsigned long long)(unsigned int)n * (unsigned int)m) >> 32)); break; //UMULH
+		case 0b10011010110: //SDIV, UDIV
+			if (instruction.shamt == 0b000010) writeRef(instruction.Rd, (m == 0) ? 0 : ((n == INT_MIN) && (m == -1)) ? n : n / m);
+			else if (instruction.shamt == 0b000011) writeRef(instruction.Rd, (m == 0) ? 0 : (int)((unsigned int)n / (unsigned int)m));
+			else
+			{
+				error = "shamt " + to_string(instruction.shamt) + " is not a divide";
+				return false;
+			}
+			break;
+		case 0b110100101: writeRef(instruction.Rd, (instruction.LSL < 2) ? instruction.MOV_immediate << (instruction.LSL * 16) : 0); break; //MOVZ
+		case 0b111100101: //MOVK
+			if (instruction.LSL < 2)
+			{
+				unsigned int mask = 0xFFFFu << (instruction.LSL * 16);
+				writeRef(instruction.Rd, (int)(((unsigned int)readRef(instruction.Rd) & ~mask) | (((unsigned int)instruction.MOV_immediate << (instruction.LSL * 16)) & mask)));
+			}
+			break;
+
+		case 0b11111000010: case 0b11001000010: //LDUR, LDXR
+			if (!refAddress(address, 8, error)) return false;
+			writeRef(instruction.Rt, refLoad(address, 8, false));
+			break;
+		case 0b10111000100: //LDURSW
+			if (!refAddress(address, 4, error)) return false;
+			writeRef(instruction.Rt, refLoad(address, 4, true));
+			break;
+		case 0b01111000010: //LDURH
+			if (!refAddress(address, 2, error)) return false;
+			writeRef(instruction.Rt, refLoad(address, 2, false));
+			break;
+		case 0b00111000010: //LDURB
+			if (!refAddress(address, 1, error)) return false;
+			writeRef(instruction.Rt, refLoad(address, 1, false));
+			break;
+		case 0b11111000000: case 0b11001000000: case 0b10111000000: case 0b01111000000: case 0b00111000000: //STUR, STXR, STURW, STURH, STURB
+			written.address = address;
+			written.bytes = storeSize(instruction.opcode);
+			if (!refAddress(address, written.bytes, error)) return false;
+			refStore(t, address, written.bytes);
+			break;
+
+		case opcodeVectorLoad: //LDUR Q
+			if (!refAddress(address, 16, error)) return false;
+			memcpy(refVectors[instruction.Rt].data(), refMemory.data() + address, 16);
+			break;
+		case opcodeVectorStore: //STUR Q
+			written.address = address;
+			written.bytes = 16;
+			if (!refAddress(address, 16, error)) return false;
+			memcpy(refMemory.data() + address, refVectors[instruction.Rt].data(), 16);
+			break;
+		case opcodeVector: case opcodeAcross:
+			if (!vectorEncoding(instruction.opcode, instruction.shamt))
+			{
+				error = "shamt " + to_string(instruction.shamt) + " is not a vector operation";
+				return false;
+			}
+			if (instruction.opcode == opcodeAcross) writeRef(instruction.Rd, vectorAcross(instruction.shamt, refVectors[instruction.Rn], false));
+			else vectorLanes(instruction.shamt, refVectors[instruction.Rn], refVectors[instruction.Rm], n, refVectors[instruction.Rd], false);
+			break;
+
+		case opcodeMRS: writeRef(instruction.Rd, instruction._Rd); break; //the count the timing model read, 0 when running alone
+		case opcodeMARK: break;
+		case opcodeSVC:
+			error = "SVC is a host call, which the reference cannot repeat";
+			return false;
+		case 0b00011110001: case 0b11111100000: case 0b11111100010: case 0b10111100000: case 0b10111100010: break; //floating point, not modelled
+		default:
+			if (pluginIndex(instruction.opcode) >= 0)
+			{//the plugin's handler on the reference state, which then checks the registers like any other instruction's
+				int result;
+				if (!callPlugin(pluginIndex(instruction.opcode), instruction, readRef(instruction.Rd), n, m, refRegisters.data(),
+					refMemory.data(), (long long)refMemory.size(), result, error)) return false;
+				writeRef(instruction.Rd, result);
+				break;
+			}
+			error = "opcode " + to_string(instruction.opcode) + " is not in the reference model";
+			return false;
+	}
+
+	refPC = nextPC;
+	return true;
+}
+
+bool overlaps(const MemoryRange &range, long long address)
+{
+	return (address >= range.address) && (address < range.address + range.bytes);
+}
+
+void reportHeader(ostringstream &report, const Instructions &instruction)
+{
+	report << "cosim: divergence at retirement " << cosimRetired << ", cycle " << clockCycles << " ("
+		<< (pipeline ? "pipelined" : "unpipelined") << ")" << endl;
+	report << "  instruction at " << instruction.location << ": " << disassemble(instruction) << endl;
+}
+
+void reportVector(ostream &report, int number, const string &side)
+{//the four 32 bit words of each side
+	const VectorRegister &timing = vectorRegisters[number], &reference = refVectors[number];
+	report << "  V" << number << ": " << side << timing[0] << " " << timing[1] << " " << timing[2] << " " << timing[3]
+		<< ", reference " << reference[0] << " " << reference[1] << " " << reference[2] << " " << reference[3] << endl;
+}
+
+void reportDivergence(const Instructions &instruction, const MemoryRange &written, int youngerRegister, int youngerVector,
+	const MemoryRange &youngerStore)
+{
+	ostringstream report;
+	reportHeader(report, instruction);
+	const char *side = pipeline ? "pipelined " : "unpipelined ";
+	for (int i = 0; i < 32; i++)
+	{
+		int expected = readRef(i);
+		if ((i == youngerRegister) || (registers[i] == expected)) continue;
+		report << "  X" << i << ": " << side << registers[i] << ", reference " << expected << endl;
+	}
+	for (int i = 0; i < 32; i++)
+		if ((i != youngerVector) && (vectorRegisters[i] != refVectors[i])) reportVector(report, i, side);
+	for (long long address = written.address; address < written.address + written.bytes; address++)
+	{
+		if (overlaps(youngerStore, address) || (dataMemory[address] == refMemory[address])) continue;
+		report << "  mem[" << address << "]: " << side << (int)dataMemory[address] << ", reference " << (int)refMemory[address] << endl;
+	}
+	cosimReport = report.str();
+	endProgram = 1;
+}
+
+void checkRetirement()
+{//called from writeback() for each retiring instruction, the report is only built once they differ so a matching
+ //retirement allocates nothing
+	const Instructions &instruction = writebackVars;
+	cosimRetired++;
+
+	if (instruction.location != refPC)
+	{
+		ostringstream report;
+		reportHeader(report, instruction);
+		report << "  PC: " << (pipeline ? "pipelined " : "unpipelined ") << instruction.location << ", reference " << refPC << endl;
+		cosimReport = report.str();
+		endProgram = 1;
+		return;
+	}
+
+	MemoryRange written;
+	string error;
+	if (!stepReference(instruction, written, error))
+	{
+		ostringstream report;
+		reportHeader(report, instruction);
+		report << "  reference: " << error << endl;
+		cosimReport = report.str();
+		endProgram = 1;
+		return;
+	}
+
+	//effects of the younger instruction that already executed this cycle
+	int youngerRegister = -1;
+	int youngerVector = -1;
+	MemoryRange youngerStore = { 0, 0 };
+	if (pipeline)
+	{
+		if (isLoad(executeVars.opcode)) youngerRegister = executeVars.Rt;
+		else if (executeVars.opcode == 0b100101) youngerRegister = 30; //BL
+		else if (executeVars.opcode == opcodeVectorLoad) youngerVector = executeVars.Rt;
+		else if (executeVars.opcode == opcodeVector) youngerVector = executeVars.Rd;
+		youngerStore.bytes = storeSize(executeVars.opcode);
+		youngerStore.address = (long long)executeVars._Rn + executeVars.DT_address;
+	}
+
+	bool diverged = false;
+	for (int i = 0; i < 32; i++)
+		if ((i != youngerRegister) && (registers[i] != readRef(i))) diverged = true;
+	for (int i = 0; i < 32; i++)
+		if ((i != youngerVector) && (vectorRegisters[i] != refVectors[i])) diverged = true;
+	for (long long address = written.address; address < written.address + written.bytes; address++)
+		if (!overlaps(youngerStore, address) && (dataMemory[address] != refMemory[address])) diverged = true;
+	if (diverged) reportDivergence(instruction, written, youngerRegister, youngerVector, youngerStore);
+}
+
+bool finishCosim()
+{//true when the run matched the reference, the final state is checked in full
+	if (!cosimReport.empty()) return false;
+
+	ostringstream report;
+	string side = pipeline ? "pipelined " : "unpipelined ";
+	int differences = 0;
+	for (int i = 0; i < 32; i++)
+	{
+		if (registers[i] == readRef(i)) continue;
+		report << "  X" << i << ": " << side << registers[i] << ", reference " << readRef(i) << endl;
+		differences++;
+	}
+	for (int i = 0; i < 32; i++)
+	{
+		if (vectorRegisters[i] == refVectors[i]) continue;
+		reportVector(report, i, side);
+		differences++;
+	}
+	if (memcmp(dataMemory.data(), refMemory.data(), refMemory.size()))
+	{
+		for (size_t address = 0; address < refMemory.size(); address++)
+		{
+			if (dataMemory[address] == refMemory[address]) continue;
+			if (++differences > 16)
+			{
+				report << "  ..." << endl;
+				break;
+			}
+			report << "  mem[" << address << "]: " << side << (int)dataMemory[address] << ", reference " << (int)refMemory[address] << endl;
+		}
+	}
+
+	if (!differences) return true;
+	cosimReport = "cosim: final state differs after " + to_string(cosimRetired) + " retirements\n" + report.str();
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////FAST FORWARD////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+long long runReference(long long instructions, string &error, void(*visit)(int location))
+{//steps the reference alone from its current state, stopping before an EXIT, and returns the instructions executed
+ //visit, when given, sees the location of each instruction before it executes
+	vector<DecodedInstruction> decoded = predecodeWords(currentText());
+	Instructions instruction = noOP;
+	MemoryRange written;
+	long long executed = 0;
+	while (executed < instructions)
+	{
+		if ((refPC < 1) || (refPC > (int)decoded.size()))
+		{
+			error = "location " + to_string(refPC) + " is outside the program";
+			break;
+		}
+		if (decoded[refPC - 1].opcode == 0b11111111111) break; //EXIT, left for the timing model
+		if (visit) visit(refPC);
+		copyDecoded(decoded[refPC - 1], instruction);
+		instruction.location = refPC;
+		if (!stepReference(instruction, written, error)) break;
+		executed++;
+	}
+	return executed;
+}
+
+void adoptReference()
+{//the architectural state of the reference becomes the timing model's, the caller empties the pipeline
+	registers = refRegisters;
+	vectorRegisters = refVectors;
+	copy(refMemory.begin(), refMemory.end(), dataMemory.begin());
+	negativeFlag = refN;
+	zeroFlag = refZ;
+	carryFlag = refC;
+	overflowFlag = refV;
+	PC = refPC;
+}
@@ -0,0 +1,109 @@
+//Performance counters
+/*
+Two custom R format instructions beside SVC let a program measure its own kernels the way it would with a hardware
+performance monitor:
+
+	MRS Xd, #counter    opcode 0b11111111101, Xd = the counter's count since the last MARK
+	MARK #region        opcode 0b11111111100, ends the open region and starts region 0-63, setting every counter MRS
+	                    reads back to zero
+
+	counter 0   cycles
+	        1   instructions retired
+	        2   branch mispredicts, the taken branches that flush the instructions fetched behind them (fetch predicts
+	            not taken), none unpipelined
+	        3   stall cycles, the cycles stallProcessor() held the processor (events.cpp), as --units stalls do
+	        4   data memory accesses, the loads and stores outside the device registers
+
+The counts of each region are added to the totals of its number when the region ends, at the next MARK or the end of the
+run, and the run prints the totals of every region but 0, so MARK #0 only resets. There is no cache in the timing model, so
+there is no cache miss counter; cachesim.cpp measures misses from a trace instead.
+
+The counters are timing, not architecture: under --cosim the reference model takes the value MRS read from the retiring
+instruction, and when it runs alone (--fast-forward, --simpoint, --parallel) MRS reads 0 and MARK does nothing. The debugger
+does not undo a MARK.
+*/
+
+#include <iostream>
+#include <array>
+#include <iomanip>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+const int performanceCounters = 5;
+const int counterRegions = 64;
+const char *counterNames[performanceCounters] = { "cycles", "instructions", "mispredicts", "stalls", "accesses" };
+
+long long branchMispredicts;
+long long dataAccesses;
+array<long long, performanceCounters> counterBase; //the counts at the last MARK
+int openRegion;
+array<array<long long, performanceCounters>, counterRegions> regionTotals;
+array<long long, counterRegions> regionEntries;
+
+long long counterCount(int counter)
+{
+	switch (counter)
+	{
+		case 0: return clockCycles;
+		case 1: return instructionsRetired;
+		case 2: return branchMispredicts;
+		case 3: return idleCyclesSkipped;
+		case 4: return dataAccesses;
+		default: return 0;
+	}
+}
+
+int readCounter(int counter)
+{//called by execute() for MRS, unknown counters read as 0
+	if ((counter < 0) || (counter >= performanceCounters)) return 0;
+	return (int)(counterCount(counter) - counterBase[counter]);
+}
+
+void closeRegion()
+{
+	for (int i = 0; i < performanceCounters; i++)
+	{
+		regionTotals[openRegion][i] += counterCount(i) - counterBase[i];
+		counterBase[i] = counterCount(i);
+	}
+	regionEntries[openRegion]++;
+}
+
+void markRegion(int region)
+{//called by execute() for MARK
+	closeRegion();
+	openRegion = region % counterRegions;
+}
+
+void resetCounters()
+{//called whenever the clock starts again, after it has been set
+	branchMispredicts = 0;
+	dataAccesses = 0;
+	for (int i = 0; i < performanceCounters; i++) counterBase[i] = counterCount(i);
+	openRegion = 0;
+	for (array<long long, performanceCounters> &totals : regionTotals) totals.fill(0);
+	regionEntries.fill(0);
+}
+
+void reportCounters()
+{//the regions the program marked, nothing when it marked none
+	closeRegion();
+	bool marked = false;
+	for (int region = 1; region < counterRegions; region++) marked = marked || regionEntries[region];
+	if (!marked) return;
+
+	cout << setw(8) << "Region" << setw(8) << "Times";
+	for (const char *name : counterNames) cout << setw(14) << name;
+	cout << setw(8) << "CPI" << endl;
+	for (int region = 1; region < counterRegions; region++)
+	{
+		if (!regionEntries[region]) continue;
+		const array<long long, performanceCounters> &totals = regionTotals[region];
+		cout << setw(8) << region << setw(8) << regionEntries[region];
+		for (long long total : totals) cout << setw(14) << total;
+		cout << setw(8) << fixed << setprecision(2) << (totals[1] ? double(totals[0]) / totals[1] : 0) << endl;
+		cout.unsetf(ios::floatfield);
+	}
+}
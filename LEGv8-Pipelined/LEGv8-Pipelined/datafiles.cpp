@@ -0,0 +1,260 @@
+//Data memory initialization and dumps
+/*
+Replaces the rand() array in setup() with real input. Files named on the command line are loaded into data memory at the
+given address before the program runs, and chosen ranges of data memory are written back out when it finishes.
+
+	--data file address         binary files are copied byte for byte, .csv files hold integers separated by commas,
+	                            spaces or new lines (decimal or 0x hex, # starts a comment line) stored one element each
+	--dump file address bytes   raw bytes, or one element per line when the file name ends in .csv, where bytes must be a
+	                            whole number of elements
+	--csv-width N               element size in bytes for .csv files, 1, 2, 4 or 8 (default 8, the LDUR/STUR size)
+
+Elements are stored little endian, the byte order storeDataMemory() uses. Files are streamed in fixed size chunks so an input
+as large as data memory never has to be held twice.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+vector<DataTransfer> dataLoads;
+vector<DataTransfer> dataDumps;
+int csvWidth = 8;
+
+const size_t dataChunkSize = 65536;
+
+bool isCsvFile(const string &fileName)
+{
+	if (fileName.size() < 4) return false;
+	string extension = fileName.substr(fileName.size() - 4);
+	for (char &c : extension) c = tolower((unsigned char)c);
+	return extension == ".csv";
+}
+
+bool partialElement(const DataTransfer &dump)
+{//a .csv dump whose range ends part way through an element, reported rather than dropping the last bytes
+	if (!isCsvFile(dump.fileName) || !(dump.bytes % csvWidth)) return false;
+	cout << dump.fileName << ": error: " << dump.bytes << " bytes is not a whole number of " << csvWidth << " byte elements" << endl;
+	return true;
+}
+
+int parseDataOption(int argc, char* argv[], int i)
+{//number of arguments used by the data option at argv[i], 0 when it is not one, -1 on error
+	string option = argv[i];
+	try
+	{
+		if ((option == "--data") && (i + 2 < argc))
+		{
+			DataTransfer load = { argv[i + 1], stoll(argv[i + 2], nullptr, 0), 0 };
+			dataLoads.push_back(load);
+			return 3;
+		}
+		if ((option == "--dump") && (i + 3 < argc))
+		{
+			DataTransfer dump = { argv[i + 1], stoll(argv[i + 2], nullptr, 0), stoll(argv[i + 3], nullptr, 0) };
+			if ((dump.address < 0) || (dump.bytes < 0) || (dump.address + dump.bytes > (long long)dataMemory.size()))
+			{
+				cout << dump.fileName << ": error: dump range is outside data memory" << endl;
+				return -1;
+			}
+			dataDumps.push_back(dump);
+			return 4;
+		}
+		if ((option == "--csv-width") && (i + 1 < argc))
+		{
+			csvWidth = stoi(argv[i + 1]);
+			if ((csvWidth != 1) && (csvWidth != 2) && (csvWidth != 4) && (csvWidth != 8))
+			{
+				cout << "--csv-width must be 1, 2, 4 or 8" << endl;
+				return -1;
+			}
+			return 2;
+		}
+	}
+	catch (const exception &)
+	{
+		cout << "Malformed number in " << option << " option" << endl;
+		return -1;
+	}
+	return 0;
+}
+
+void storeElement(long long value, long long address)
+{//little endian, the same layout storeDataMemory() produces
+	for (int i = 0; i < csvWidth; i++) dataMemory[address + i] = (unsigned char)(value >> (8 * i));
+}
+
+long long loadElement(long long address)
+{//sign extended like loadDataMemory()
+	unsigned long long value = 0;
+	for (int i = csvWidth - 1; i >= 0; i--) value = (value << 8) | dataMemory[address + i];
+	int unused = 64 - 8 * csvWidth;
+	return (long long)(value << unused) >> unused;
+}
+
+bool loadBinaryData(const DataTransfer &load)
+{
+	ifstream infile(load.fileName, ios::binary);
+	if (!infile)
+	{
+		cout << load.fileName << ": error: could not open file" << endl;
+		return false;
+	}
+
+	long long address = load.address;
+	while (infile)
+	{
+		long long room = (long long)dataMemory.size() - address;
+		infile.read((char*)dataMemory.data() + address, (streamsize)min<long long>(dataChunkSize, room));
+		address += infile.gcount();
+		if ((address == (long long)dataMemory.size()) && (infile.peek() != char_traits<char>::eof()))
+		{
+			cout << load.fileName << ": error: file does not fit in data memory at address " << load.address << endl;
+			return false;
+		}
+	}
+	cout << "Loaded " << address - load.address << " bytes from " << load.fileName << " at " << load.address << endl;
+	return true;
+}
+
+bool loadCsvData(const DataTransfer &load)
+{
+	ifstream infile(load.fileName, ios::binary);
+	if (!infile)
+	{
+		cout << load.fileName << ": error: could not open file" << endl;
+		return false;
+	}
+
+	vector<char> chunk(dataChunkSize);
+	string token; //a number can be split across two chunks
+	long long address = load.address;
+	long long elements = 0;
+	int line = 1;
+	bool comment = false;
+	bool startOfLine = true;
+
+	auto flush = [&]() -> bool
+	{
+		if (token.empty()) return true;
+		size_t used = 0;
+		long long value = 0;
+		try { value = stoll(token, &used, 0); }
+		catch (const exception &) { used = 0; }
+		if (used != token.size())
+		{
+			cout << load.fileName << ":" << line << ": error: '" << token << "' is not a number" << endl;
+			return false;
+		}
+		if (address + csvWidth > (long long)dataMemory.size())
+		{
+			cout << load.fileName << ":" << line << ": error: data runs past the end of data memory" << endl;
+			return false;
+		}
+		storeElement(value, address);
+		address += csvWidth;
+		elements++;
+		token.clear();
+		return true;
+	};
+
+	while (infile)
+	{
+		infile.read(chunk.data(), chunk.size());
+		streamsize count = infile.gcount();
+		for (streamsize i = 0; i < count; i++)
+		{
+			char c = chunk[i];
+			if (c == '\n')
+			{
+				if (!flush()) return false;
+				line++;
+				comment = false;
+				startOfLine = true;
+				continue;
+			}
+			if (comment) continue;
+			if (startOfLine && (c == '#'))
+			{
+				comment = true;
+				continue;
+			}
+			startOfLine = false;
+			if ((c == ',') || isspace((unsigned char)c))
+			{
+				if (!flush()) return false;
+			}
+			else token += c;
+		}
+	}
+	if (!flush()) return false;
+	cout << "Loaded " << elements << " values from " << load.fileName << " at " << load.address << endl;
+	return true;
+}
+
+bool loadDataFiles()
+{//called once the program is in place, so files override an image's data segment
+	for (DataTransfer &load : dataLoads)
+	{
+		if ((load.address < 0) || (load.address >= (long long)dataMemory.size()))
+		{
+			cout << load.fileName << ": error: address " << load.address << " is outside data memory" << endl;
+			return false;
+		}
+		if (!(isCsvFile(load.fileName) ? loadCsvData(load) : loadBinaryData(load))) return false;
+	}
+	for (const DataTransfer &dump : dataDumps) if (partialElement(dump)) return false; //checked here since --csv-width can follow --dump
+	return true;
+}
+
+bool dumpDataFiles()
+{
+	bool ok = true;
+	for (DataTransfer &dump : dataDumps)
+	{
+		ofstream outfile(dump.fileName, ios::binary);
+		if (!outfile)
+		{
+			cout << dump.fileName << ": error: could not open file" << endl;
+			ok = false;
+			continue;
+		}
+
+		if (isCsvFile(dump.fileName))
+		{
+			string buffer;
+			for (long long address = dump.address; address + csvWidth <= dump.address + dump.bytes; address += csvWidth)
+			{
+				buffer += to_string(loadElement(address));
+				buffer += '\n';
+				if (buffer.size() >= dataChunkSize)
+				{
+					outfile.write(buffer.data(), buffer.size());
+					buffer.clear();
+				}
+			}
+			outfile.write(buffer.data(), buffer.size());
+		}
+		else
+		{
+			for (long long offset = 0; offset < dump.bytes; offset += dataChunkSize)
+				outfile.write((const char*)dataMemory.data() + dump.address + offset, (streamsize)min<long long>(dataChunkSize, dump.bytes - offset));
+		}
+
+		if (!outfile)
+		{
+			cout << dump.fileName << ": error: write failed" << endl;
+			ok = false;
+		}
+		else cout << "Dumped " << dump.bytes << " bytes from " << dump.address << " to " << dump.fileName << endl;
+	}
+	return ok;
+}
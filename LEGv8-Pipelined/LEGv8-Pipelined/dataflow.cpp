@@ -0,0 +1,315 @@
+//Dataflow critical path and ideal CPI
+/*
+Follows the true dependences of the retired instruction stream, through registers (Rn, Rm, Rt, Rd from the decoded fields,
+the flags, and X30 for BL) and through data memory byte by byte, and schedules every instruction as early as its inputs allow
+with the latency of its class. Branches are assumed perfectly predicted and there are no structural limits, so the result is
+a property of the program rather than of pipelined():
+
+	critical path   cycles of the longest dependence chain, the run time of an infinitely wide machine
+	window ILP      instructions per cycle when an instruction may not start until the one W places before it has finished,
+	                for a range of window sizes W
+	ideal CPI       max(1 / width, critical path / instructions) for the chosen issue width
+
+The stream comes from a --trace file or live from the run, and the measured CPI of that run is printed next to the bound.
+
+	--dataflow trace [--width N] [--units file] [--latency class=cycles,...] [--windows W,W,...] [--plugin file]...
+	--ilp                               as a run option, analyses that run with the defaults
+
+Classes are alu, mul, div, load, store and branch (defaults 1, 3, 12, 2, 1, 1, or the latencies of a --units file, units.cpp). Registers follow the LEGv8 definition: X31
+reads as zero and is never a dependence, and MOVZ/MOVK write their register.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+const char *latencyClassNames[latencyClasses] = { "alu", "mul", "div", "load", "store", "branch" };
+
+struct DataflowWindow
+{//one schedule, limited to a window of W instructions in flight or unlimited when W is 0
+	int size;
+	array<long long, dependenceRegisters> registerReady;
+	unordered_map<long long, long long> memoryReady; //per byte, the cycle the last store to it finished
+	vector<long long> finished; //ring of the last W finish times
+	long long end;
+};
+
+array<int, latencyClasses> dataflowLatency = { 1, 3, 12, 2, 1, 1 };
+int dataflowWidth = 4;
+vector<DataflowWindow> dataflowWindows;
+unordered_map<unsigned int, DecodedInstruction> dataflowDecoded; //decode() once per distinct word
+array<long long, latencyClasses> dataflowMix;
+long long dataflowCount;
+
+const DecodedInstruction &decodedWord(unsigned int word)
+{//also used by baselines.cpp
+	auto found = dataflowDecoded.find(word);
+	if (found != dataflowDecoded.end()) return found->second;
+	return dataflowDecoded[word] = predecodeWords(vector<unsigned int>(1, word))[0];
+}
+
+Dependences dependencesOf(const DecodedInstruction &instruction, bool load, bool store)
+{//also used by units.cpp to time the instructions entering execute
+	Dependences result = { {}, 0, {}, 0, latencyALU, -1 };
+	auto source = [&](int number) { if (number != 31) result.sources[result.sourceCount++] = number; };
+	auto destination = [&](int number) { if (number != 31) result.destinations[result.destinationCount++] = number; };
+	auto vectorSource = [&](int number) { result.sources[result.sourceCount++] = vectorRegisterBase + number; }; //V31 is a register
+	auto vectorDestination = [&](int number) { result.destinations[result.destinationCount++] = vectorRegisterBase + number; };
+
+	switch (instruction.opcode)
+	{
+		case 0b000101: result.latency = latencyBRANCH; break; //B
+		case 0b100101: result.latency = latencyBRANCH; destination(30); break; //BL
+		case 0b11010110000: result.latency = latencyBRANCH; source(instruction.Rt); break; //BR
+		case 0b10110100: case 0b10110101: result.latency = latencyBRANCH; source(instruction.Rt); break; //CBZ, CBNZ
+		case 0b01010100: result.latency = latencyBRANCH; source(flagsRegister); break; //B.cond
+		case 0b10011011000: case 0b10011011010: case 0b10011011110: //MUL, SMULH, UMULH
+			result.latency = latencyMUL;
+			source(instruction.Rn);
+			source(instruction.Rm);
+			destination(instruction.Rd);
+			break;
+		case 0b10011010110: //SDIV, UDIV
+			result.latency = latencyDIV;
+			source(instruction.Rn);
+			source(instruction.Rm);
+			destination(instruction.Rd);
+			break;
+		case opcodeSVC: source(0); source(1); source(2); destination(0); break; //arguments in X0 to X2, the result in X0
+		case opcodeVectorLoad: result.latency = latencyLOAD; source(instruction.Rn); vectorDestination(instruction.Rt); break;
+		case opcodeVectorStore: result.latency = latencySTORE; source(instruction.Rn); vectorSource(instruction.Rt); break;
+		case opcodeVector:
+			if ((instruction.shamt >> 2) == vectorMUL) result.latency = latencyMUL;
+			if ((instruction.shamt >> 2) == vectorDUP) source(instruction.Rn);
+			else
+			{
+				vectorSource(instruction.Rn);
+				vectorSource(instruction.Rm);
+			}
+			vectorDestination(instruction.Rd);
+			break;
+		case opcodeAcross: vectorSource(instruction.Rn); destination(instruction.Rd); break; //ADDV and the other reductions
+		case 0b110100101: destination(instruction.Rd); break; //MOVZ
+		case 0b111100101: source(instruction.Rd); destination(instruction.Rd); break; //MOVK keeps the other bits
+		case 0b11010011010: case 0b11010011011: source(instruction.Rn); destination(instruction.Rd); break; //LSR, LSL
+		case 0b10101011000: case 0b11101011000: case 0b11101010000: //ADDS, SUBS, ANDS
+			source(instruction.Rn);
+			source(instruction.Rm);
+			destination(instruction.Rd);
+			result.destinations[result.destinationCount++] = flagsRegister;
+			break;
+		case 0b1011000100: case 0b1111000100: case 0b1111001000: //ADDIS, SUBIS, ANDIS
+			source(instruction.Rn);
+			destination(instruction.Rd);
+			result.destinations[result.destinationCount++] = flagsRegister;
+			break;
+		default:
+			if (pluginInstructionCount && ((result.plugin = pluginIndex(instruction.opcode)) >= 0))
+			{//Rd, Rn and Rm or the immediate, as a built in instruction of the plugin's format
+				source(instruction.Rn);
+				if (instruction.format == 'R') source(instruction.Rm);
+				if (pluginReadsRd(result.plugin)) source(instruction.Rd);
+				destination(instruction.Rd);
+			}
+			else if (store)
+			{
+				result.latency = latencySTORE;
+				source(instruction.Rn);
+				source(instruction.Rt);
+			}
+			else if (load)
+			{
+				result.latency = latencyLOAD;
+				source(instruction.Rn);
+				destination(instruction.Rt);
+			}
+			else if (instruction.format == 'R')
+			{
+				source(instruction.Rn);
+				source(instruction.Rm);
+				destination(instruction.Rd);
+			}
+			else if (instruction.format == 'I')
+			{
+				source(instruction.Rn);
+				destination(instruction.Rd);
+			}
+			break;
+	}
+	return result;
+}
+
+void dataflowRetire(const TraceRecord &record)
+{
+	const DecodedInstruction &instruction = decodedWord(record.word);
+	Dependences dependences = dependencesOf(instruction, record.size && !record.store, record.size && record.store);
+	int latency = (dependences.plugin >= 0) ? pluginUnit(dependences.plugin).latency : dataflowLatency[dependences.latency];
+	dataflowMix[dependences.latency]++;
+
+	for (DataflowWindow &window : dataflowWindows)
+	{
+		long long start = 0;
+		for (int i = 0; i < dependences.sourceCount; i++) start = max(start, window.registerReady[dependences.sources[i]]);
+		if (record.size && !record.store)
+		{
+			for (int i = 0; i < record.size; i++)
+			{
+				auto found = window.memoryReady.find(record.address + i);
+				if (found != window.memoryReady.end()) start = max(start, found->second);
+			}
+		}
+		if (window.size) start = max(start, window.finished[dataflowCount % window.size]); //the instruction W places back
+
+		long long finish = start + latency;
+		for (int i = 0; i < dependences.destinationCount; i++) window.registerReady[dependences.destinations[i]] = finish;
+		if (record.size && record.store)
+			for (int i = 0; i < record.size; i++) window.memoryReady[record.address + i] = finish;
+		if (window.size) window.finished[dataflowCount % window.size] = finish;
+		window.end = max(window.end, finish);
+	}
+	dataflowCount++;
+}
+
+void resetDataflow(const vector<int> &windowSizes)
+{
+	dataflowWindows.clear();
+	for (int size : windowSizes)
+	{
+		DataflowWindow window;
+		window.size = size;
+		window.registerReady.fill(0);
+		window.finished.assign(size, 0);
+		window.end = 0;
+		dataflowWindows.push_back(window);
+	}
+	dataflowMix.fill(0);
+	dataflowCount = 0;
+}
+
+void reportDataflow(long long cycles, long long retired, string measuredName)
+{
+	const DataflowWindow &unlimited = dataflowWindows.back();
+	long long critical = unlimited.end;
+	cout << "Dataflow: " << dataflowCount << " instructions, critical path " << critical << " cycles, ILP "
+		<< fixed << setprecision(2) << (critical ? double(dataflowCount) / critical : 0) << endl;
+	cout << "Mix:";
+	for (int i = 0; i < latencyClasses; i++) cout << " " << latencyClassNames[i] << " " << dataflowMix[i] << " (" << dataflowLatency[i] << ")";
+	cout << endl;
+
+	cout << setw(10) << "Window" << setw(10) << "ILP" << endl;
+	for (const DataflowWindow &window : dataflowWindows)
+		cout << setw(10) << (window.size ? to_string(window.size) : "unlimited") << setw(10)
+		<< (window.end ? double(dataflowCount) / window.end : 0) << endl;
+
+	double ideal = dataflowCount ? max(1.0 / dataflowWidth, double(critical) / dataflowCount) : 0;
+	cout << "Ideal CPI at issue width " << dataflowWidth << ": " << setprecision(3) << ideal << endl;
+	if (retired && ideal > 0)
+	{
+		double measured = double(cycles) / retired;
+		cout << "Measured CPI (" << measuredName << "): " << measured << ", " << setprecision(2) << measured / ideal << "x the bound" << endl;
+	}
+	cout.unsetf(ios::floatfield);
+}
+
+vector<int> defaultWindows()
+{
+	return { 4, 8, 16, 32, 64, 128, 256, 0 };
+}
+
+void useUnitLatencies()
+{//--units replaces the default latencies
+	if (!unitTiming) return;
+	for (int i = 0; i < latencyClasses; i++) dataflowLatency[i] = unitClasses[i].latency;
+}
+
+void startDataflow()
+{
+	useUnitLatencies();
+	resetDataflow(defaultWindows());
+	addTraceListener(dataflowRetire);
+}
+
+void finishDataflow()
+{
+	reportDataflow(clockCycles, instructionsRetired, pipeline ? "pipelined" : "unpipelined");
+}
+
+bool parseClassCycles(string text, array<int, latencyClasses> &cycles, string what)
+{//alu=1,mul=3,... into cycles, also used for the state counts of baselines.cpp
+	stringstream list(text);
+	string item;
+	while (getline(list, item, ','))
+	{
+		size_t equals = item.find('=');
+		int found = -1;
+		for (int i = 0; i < latencyClasses; i++)
+			if ((equals != string::npos) && (item.substr(0, equals) == latencyClassNames[i])) found = i;
+		int count = (found >= 0) ? atoi(item.c_str() + equals + 1) : 0;
+		if (count < 1)
+		{
+			cout << "Bad " << what << " '" << item << "', expected class=cycles with class alu, mul, div, load, store or branch" << endl;
+			return false;
+		}
+		cycles[found] = count;
+	}
+	return true;
+}
+
+int runDataflow(int argc, char* argv[])
+{//--dataflow trace [--width N] [--units file] [--latency class=cycles,...] [--windows W,W,...] [--plugin file]...
+	string usage = "Usage: --dataflow trace [--width N] [--units file] [--latency class=cycles,...] [--windows W,W,...] [--plugin file]...";
+	if (argc < 3)
+	{
+		cout << usage << endl;
+		return 1;
+	}
+	vector<int> windows = defaultWindows();
+	for (int i = 3; i < argc; i++)
+	{
+		string option = argv[i];
+		if ((option == "--width") && (i + 1 < argc)) dataflowWidth = max(1, atoi(argv[++i]));
+		else if ((option == "--units") && (i + 1 < argc))
+		{
+			if (!loadUnits(argv[++i])) return 1;
+			useUnitLatencies();
+		}
+		else if ((option == "--latency") && (i + 1 < argc))
+		{
+			if (!parseClassCycles(argv[++i], dataflowLatency, "latency")) return 1;
+		}
+		else if ((option == "--plugin") && (i + 1 < argc))
+		{//decodes the plugin's instructions in the trace
+			if (!loadPlugin(argv[++i])) return 1;
+		}
+		else if ((option == "--windows") && (i + 1 < argc))
+		{
+			windows.clear();
+			stringstream list(argv[++i]);
+			string item;
+			while (getline(list, item, ',')) if (atoi(item.c_str()) > 0) windows.push_back(atoi(item.c_str()));
+			sort(windows.begin(), windows.end());
+			windows.push_back(0); //the unlimited schedule gives the critical path
+		}
+		else
+		{
+			cout << "Unknown dataflow option " << option << endl;
+			cout << usage << endl;
+			return 1;
+		}
+	}
+
+	resetDataflow(windows);
+	TraceSummary summary;
+	if (!readTrace(argv[2], dataflowRetire, &summary)) return 1;
+	reportDataflow(summary.cycles, summary.records, summary.pipelined ? "recorded pipelined" : "recorded unpipelined");
+	return 0;
+}
@@ -0,0 +1,199 @@
+//Debugger console
+/*
+--debug runs the program under a command console instead of straight through, with reverse execution (reverse.cpp) so any
+earlier cycle can be returned to without running the program again. Commands are read from standard input after the operating
+mode, and an empty line repeats the last one:
+
+	step [n]            n steps forward (default 1)
+	rstep [n]           n steps back
+	continue            run to the next breakpoint or watchpoint, or the end of the program
+	rcontinue           run back to the last breakpoint or write watchpoint, or the oldest step in the undo log
+	goto cycle          go to a clock cycle, forwards or back, passing over breakpoints
+	break location [if Xn op value]
+	                    breakpoint at an instruction location or label, op is ==, !=, <, <=, > or >=
+	watch address [bytes] [read|write|access]
+	                    watchpoint on data memory, 8 bytes written by default
+	delete [n]          removes breakpoint or watchpoint n, or all of them
+	info                lists the breakpoints and watchpoints
+	where               the cycle, PC and the instruction in each pipeline latch
+	regs                registers and flags, and the vector registers that are not all zero as four 32 bit lanes
+	mem address [bytes] data memory in hex (default 64 bytes)
+	output on|off       per stage output while stepping forwards (default on)
+	history             size of the undo log
+	save file           writes a checkpoint of the current step (checkpoint.cpp)
+	quit                leave the console, the program is finalized where it stopped
+
+--break and --watch on the command line add breakpoints and watchpoints before the first prompt and imply --debug. A step is
+one clock cycle pipelined and one instruction (four cycles) unpipelined, so goto stops at the last step boundary at or before
+the cycle.
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <climits>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+bool debugOutput = true;
+vector<string> debuggerCommands; //from --break and --watch, run before the first prompt
+
+long long stepCycles()
+{
+	return pipeline ? 1 : 4;
+}
+
+string latchText(const Instructions &latch)
+{
+	if (!latch.opcode) return "bubble";
+	return disassemble(latch) + " (location " + to_string(latch.location) + ")";
+}
+
+void showWhere()
+{
+	cout << "Cycle " << clockCycles << ", PC " << PC << ", " << instructionsRetired << " retired" << (endProgram ? ", program ended" : "") << endl;
+	cout << "  decode     " << latchText(decodeVars) << endl;
+	cout << "  execute    " << latchText(executeVars) << endl;
+	cout << "  writeback  " << latchText(writebackVars) << endl;
+}
+
+void showRegisters()
+{
+	for (int i = 0; i < 32; i++)
+		cout << setw(4) << ("X" + to_string(i)) << " " << setw(11) << registers[i] << ((i % 4 == 3) ? "\n" : "   ");
+	cout << "Flags: N=" << negativeFlag << " Z=" << zeroFlag << " V=" << overflowFlag << " C=" << carryFlag << endl;
+	for (int i = 0; i < 32; i++)
+	{
+		const VectorRegister &vector = vectorRegisters[i];
+		if (!vector[0] && !vector[1] && !vector[2] && !vector[3]) continue;
+		cout << setw(4) << ("V" + to_string(i));
+		for (int lane : vector) cout << " " << setw(11) << lane;
+		cout << endl;
+	}
+}
+
+void showMemory(int address, int bytes)
+{
+	address = max(0, address);
+	bytes = min(bytes, (int)dataMemory.size() - address);
+	for (int row = 0; row < bytes; row += 16)
+	{
+		cout << setw(8) << address + row << ":" << hex << setfill('0');
+		for (int i = row; (i < row + 16) && (i < bytes); i++) cout << " " << setw(2) << (int)dataMemory[address + i];
+		cout << dec << setfill(' ') << endl;
+	}
+}
+
+void stepDebugger(long long steps)
+{//forwards until a breakpoint or watchpoint, with the per stage output when it is on
+	quietOutput(!debugOutput);
+	long long taken = 0;
+	bool stopped = false;
+	while ((taken < steps) && !stopped)
+	{
+		beginDebugStep();
+		if (!stepForward()) break;
+		taken++;
+		stopped = endDebugStep();
+	}
+	quietOutput(false);
+	if (stopped) cout << debugStop << endl;
+	else if (taken < steps) cout << "Program ended at cycle " << clockCycles << endl;
+}
+
+void reverseContinue()
+{//back to the last breakpoint or write watchpoint, as far as the undo log goes
+	if (!historyStep) return;
+	goToStep(historyStep - 1);
+	while (historyStep > historyLoggedFrom())
+	{
+		if (stoppedBackwards())
+		{
+			cout << debugStop << endl;
+			return;
+		}
+		goToStep(historyStep - 1);
+	}
+	if (historyStep) cout << "Reached step " << historyStep << ", the oldest in the undo log, goto reaches earlier cycles" << endl;
+}
+
+bool debuggerCommand(string line)
+{//false to leave the console
+	stringstream words(line);
+	string command, argument;
+	words >> command;
+	getline(words >> ws, argument);
+	long long count = 1;
+	bool counted = false;
+	try
+	{
+		size_t used;
+		count = stoll(argument, &used, 0);
+		counted = (used == argument.size());
+	}
+	catch (const exception &) {}
+
+	if (command == "step") stepDebugger(max(1LL, count));
+	else if (command == "rstep") goToStep(historyStep - max(1LL, count));
+	else if (command == "continue") stepDebugger(LLONG_MAX);
+	else if (command == "rcontinue") reverseContinue();
+	else if ((command == "goto") && counted)
+	{
+		quietOutput(!debugOutput);
+		bool reached = goToStep(count / stepCycles());
+		quietOutput(false);
+		if (!reached) cout << "Program ended at cycle " << clockCycles << endl;
+	}
+	else if (command == "break") addBreakpoint(argument);
+	else if (command == "watch") addWatchpoint(argument);
+	else if (command == "delete") deleteDebugPoint(counted ? (int)count : 0);
+	else if (command == "info") listDebugPoints();
+	else if (command == "where") showWhere();
+	else if (command == "regs") showRegisters();
+	else if (command == "mem")
+	{
+		stringstream range(argument);
+		long long address = -1, bytes = 64;
+		range >> address >> bytes;
+		if ((address < 0) || (address >= (long long)dataMemory.size())) cout << "Usage: mem address [bytes]" << endl;
+		else showMemory((int)address, (int)min<long long>(max(1LL, bytes), dataMemory.size()));
+	}
+	else if (command == "output")
+	{
+		if ((argument == "on") || (argument == "off")) debugOutput = (argument == "on");
+		else cout << "Usage: output on|off" << endl;
+	}
+	else if (command == "history") historyReport();
+	else if ((command == "save") && !argument.empty()) saveCheckpoint(argument);
+	else if ((command == "quit") || (command == "q")) return false;
+	else cout << "Unknown command " << line << endl;
+
+	for (string moves : { "step", "rstep", "continue", "rcontinue", "goto" })
+		if (command == moves) showWhere();
+	return true;
+}
+
+void runDebugger()
+{
+	startHistory();
+	cout << "Debugger: step, rstep, continue, rcontinue, goto, break, watch, delete, info, where, regs, mem, output, history, save, quit" << endl;
+	for (const string &command : debuggerCommands) debuggerCommand(command);
+	showWhere();
+
+	string line;
+	string last;
+	while (true)
+	{
+		cout << "(legv8) " << flush;
+		if (!getline(cin, line)) break;
+		if (line.find_first_not_of(" \t\r") == string::npos) line = last;
+		if (line.empty()) continue;
+		last = line;
+		if (!debuggerCommand(line)) break;
+	}
+	historyEnabled = false;
+}
@@ -0,0 +1,158 @@
+//Memory mapped devices
+/*
+Addresses from deviceBase up, just past the end of data memory, belong to devices rather than to dataMemory. Loads and stores
+there are handed to the device by storeDataMemory() and loadDataMemory() before any of the data memory instrumentation runs:
+
+	deviceBase + 0x00   console     a store writes its low byte to the console; bytes are buffered and written out in blocks
+	                                of consoleBufferSize and when the run ends, to --console file or standard output
+	deviceBase + 0x08   timer       a load reads the clock cycle count, a free running counter that ignores stores
+	deviceBase + 0x10   input       a load takes as many bytes as it reads from the --input file, little endian and extended
+	                                the way data memory extends them, and reads zeros once the file is exhausted. The file is
+	                                read in chunks of inputChunkSize, so it may be far larger than data memory
+	deviceBase + 0x18   input ready a load reads 1 while the input file has bytes left and 0 after its last one
+
+Other device addresses read as zero and ignore stores. A console store of more than one byte, and an access that starts in
+data memory and runs on past its end, are errors that stop the program. The reference model of cosim.cpp has no devices, so --cosim,
+--fast-forward, --simpoint and --parallel stop with an error at the first access. The debugger's undo log does not cover
+devices either, stepping back would not return the input already read, so --debug cannot be combined with --input.
+resetSimulator() writes out the console and rewinds the input.
+
+With deviceBase = 0x100000 a program reaches the registers as offsets from a base register:
+
+	ADDI  X9, X31, #1
+	LSL   X9, X9, #20       X9 = deviceBase
+	STURB X1, [X9, #0]      print the low byte of X1
+	LDUR  X2, [X9, #8]      X2 = cycles so far
+	LDUR  X3, [X9, #16]     X3 = next 8 bytes of input
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+static_assert(deviceBase == sizeof(dataMemory), "the devices start where data memory ends");
+
+const size_t consoleBufferSize = 4096;
+const size_t inputChunkSize = 65536;
+
+string inputName; //empty when there is no --input
+FILE *consoleFile = stdout;
+vector<char> consoleBuffer;
+ifstream inputFile;
+vector<unsigned char> inputChunk;
+size_t inputPosition; //next unread byte of inputChunk
+
+void flushConsole()
+{
+	if (consoleBuffer.empty()) return;
+	fflush(stdout); //keeps the console in order with the simulator's own output when both go to standard output
+	fwrite(consoleBuffer.data(), 1, consoleBuffer.size(), consoleFile);
+	fflush(consoleFile);
+	consoleBuffer.clear();
+}
+
+bool inputReady()
+{//refills the chunk when it has been used up
+	if (inputPosition < inputChunk.size()) return true;
+	inputChunk.resize(inputChunkSize);
+	inputFile.read((char*)inputChunk.data(), inputChunkSize);
+	inputChunk.resize(inputFile ? inputChunkSize : (size_t)inputFile.gcount());
+	inputPosition = 0;
+	return !inputChunk.empty();
+}
+
+bool deviceStraddle(int location, int size)
+{//true, with the program stopped, for an access that starts in data memory and ends among the devices
+	if ((unsigned int)location >= (unsigned int)deviceBase) return false;
+	cout << "devices: error: " << size << " byte access at " << location << " runs past the end of data memory" << endl;
+	endProgram = 1;
+	return true;
+}
+
+void deviceStore(int data, int location, int size)
+{
+	if (deviceStraddle(location, size) || (location != deviceBase + 0x00)) return;
+	if (size != 1)
+	{
+		cout << "devices: error: " << size << " byte store to the console, it takes single bytes (STURB)" << endl;
+		endProgram = 1;
+		return;
+	}
+	consoleBuffer.push_back((char)data);
+	if (consoleBuffer.size() >= consoleBufferSize) flushConsole();
+}
+
+int deviceLoad(int location, int size)
+{
+	if (deviceStraddle(location, size)) return 0;
+	long long value = 0;
+	switch (location - deviceBase)
+	{
+		case 0x08: value = clockCycles; break;
+		case 0x10:
+			for (int i = 0; i < size; i++)
+			{
+				long long byte = inputReady() ? inputChunk[inputPosition++] : 0;
+				value |= byte << (8 * i);
+			}
+			if ((size < 8) && (value >> (8 * size - 1))) value -= 1LL << (8 * size);
+			break;
+		case 0x18: value = inputReady() ? 1 : 0; break;
+		default: break;
+	}
+	return (int)value;
+}
+
+int parseDeviceOption(int argc, char* argv[], int i)
+{//number of arguments used by the device option at argv[i], 0 when it is not one, -1 on error
+	string option = argv[i];
+	if (i + 1 >= argc) return 0;
+	if (option == "--console")
+	{
+		consoleFile = fopen(argv[i + 1], "wb");
+		if (!consoleFile)
+		{
+			cout << argv[i + 1] << ": error: could not open file" << endl;
+			consoleFile = stdout;
+			return -1;
+		}
+		return 2;
+	}
+	if (option == "--input")
+	{
+		inputName = argv[i + 1];
+		inputFile.open(inputName, ios::binary);
+		if (!inputFile)
+		{
+			cout << inputName << ": error: could not open file" << endl;
+			return -1;
+		}
+		return 2;
+	}
+	return 0;
+}
+
+void resetDevices()
+{
+	flushConsole();
+	inputChunk.clear();
+	inputPosition = 0;
+	if (!inputName.empty())
+	{
+		inputFile.clear();
+		inputFile.seekg(0);
+	}
+}
+
+void finishDevices()
+{
+	flushConsole();
+	if (consoleFile != stdout) fclose(consoleFile);
+	consoleFile = stdout;
+}
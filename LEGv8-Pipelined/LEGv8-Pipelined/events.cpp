@@ -0,0 +1,38 @@
+//Processor stalls
+/*
+A stalled processor skips straight over the cycles in which nothing can happen instead of stepping through them one by one:
+
+	stalls      stallProcessor(cycles) holds every stage for that many cycles, as a long latency operation does. A step
+	            taken while the processor is stalled runs no stages: the clock jumps to the end of the stall and the
+	            cycles passed over are counted in idleCyclesSkipped
+
+The run loop tests clockCycles against stallUntil once per step, so a run without stalls pays one comparison. stallUntil is
+processor state (stateCounters()), kept in checkpoints and the undo log. A stall is dropped by resetSimulator(),
+emptyPipeline() and restoreCheckpoint() before the state they set takes over.
+*/
+
+#include <iostream>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+long long stallUntil;
+long long idleCyclesSkipped;
+
+void stallProcessor(int cycles)
+{
+	stallUntil = max(stallUntil, clockCycles + cycles);
+}
+
+void skipStall()
+{//called by a step while the processor is stalled, which then runs no stages
+	idleCyclesSkipped += stallUntil - clockCycles;
+	clockCycles = stallUntil;
+}
+
+void clearStall()
+{
+	stallUntil = 0;
+}
@@ -0,0 +1,407 @@
+//Program images
+/*
+A program image is a single binary file that is mapped into the simulator instead of being parsed line by line:
+
+	header      ProgramImageHeader, 64 bytes
+	text        one 32 bit word per instruction, location 1 first
+	data        initialized bytes, copied into dataMemory at dataAddress when the image is loaded
+	symbols     per label: location, name length, name padded to 4 bytes
+	decoded     optional, one DecodedInstruction per text word
+
+Every section starts on an 8 byte boundary and all fields are little endian. While an image is loaded fetchInstruction() reads
+the text straight from the mapping and decode() copies the pre-decoded fields instead of parsing the instruction string. The
+mapping is private and read only, so the guest can never write back to the file. An assembled program too large for the
+instruction memory strings is fetched the same way, from a copy of its words (loadProgramText()) in place of a mapping.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <bitset>
+#include <iterator>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct ProgramImageHeader
+{
+	char magic[8]; //LEGV8IMG
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned int textOffset;
+	unsigned int textWords;
+	unsigned int dataOffset;
+	unsigned int dataBytes;
+	unsigned int dataAddress;
+	unsigned int symbolOffset;
+	unsigned int symbolCount;
+	unsigned int decodedOffset;
+	unsigned int decodedCount; //0, or textWords when the image is pre-decoded
+	unsigned int entry; //PC of the first instruction to run
+	unsigned int reserved[2];
+};
+
+static_assert(sizeof(ProgramImageHeader) == 64, "program image header layout changed");
+static_assert(sizeof(DecodedInstruction) == 56, "pre-decoded record layout changed");
+
+const char imageMagic[8] = { 'L', 'E', 'G', 'V', '8', 'I', 'M', 'G' };
+const unsigned int imageVersion = 1;
+
+const unsigned int* imageText = nullptr;
+int imageTextWords = 0;
+const DecodedInstruction* imageDecoded = nullptr;
+vector<unsigned int> imageOwnedText; //the words of a program loaded by loadProgramText(), there is no mapping then
+
+const unsigned char* imageBase = nullptr; //start of the mapping
+size_t imageSize = 0;
+#ifdef _WIN32
+HANDLE imageFile = INVALID_HANDLE_VALUE;
+HANDLE imageMapping = NULL;
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////WRITING/////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void alignImage(vector<unsigned char> &image)
+{
+	while (image.size() % 8) image.push_back(0);
+}
+
+void appendImage(vector<unsigned char> &image, const void *bytes, size_t size)
+{
+	const unsigned char *start = (const unsigned char*)bytes;
+	image.insert(image.end(), start, start + size);
+}
+
+vector<DecodedInstruction> predecodeWords(const vector<unsigned int>& words)
+{//runs every word through decode() itself so the records can never disagree with the string path
+	vector<DecodedInstruction> records;
+	records.reserve(words.size());
+	Instructions saved = decodeVars;
+	int savedLocation = fetchLocation;
+	bool savedPipeline = pipeline;
+	pipeline = true; //decode() then leaves the other latches alone
+	fetchLocation = 0;
+	quietOutput(true);
+	for (unsigned int word : words)
+	{
+		fetchVars = bitset<32>(word).to_string();
+		decode();
+		DecodedInstruction decoded = { decodeVars.opcode, decodeVars.Rd, decodeVars.Rn, decodeVars.Rm, decodeVars.Rt,
+			decodeVars.shamt, decodeVars.ALU_immediate, decodeVars.op, decodeVars.BR_address, decodeVars.COND_BR_address,
+			decodeVars.MOV_immediate, decodeVars.DT_address, decodeVars.LSL, decodeVars.format };
+		records.push_back(decoded);
+	}
+	quietOutput(false);
+	decodeVars = saved;
+	fetchLocation = savedLocation;
+	pipeline = savedPipeline;
+	return records;
+}
+
+void copyDecoded(const DecodedInstruction &decoded, Instructions &instruction)
+{//fills the fields decode() would, leaving the register values and location alone
+	instruction.opcode = decoded.opcode;
+	instruction.format = decoded.format;
+	instruction.Rd = decoded.Rd;
+	instruction.Rn = decoded.Rn;
+	instruction.Rm = decoded.Rm;
+	instruction.Rt = decoded.Rt;
+	instruction.shamt = decoded.shamt;
+	instruction.ALU_immediate = decoded.ALU_immediate;
+	instruction.op = decoded.op;
+	instruction.BR_address = decoded.BR_address;
+	instruction.COND_BR_address = decoded.COND_BR_address;
+	instruction.MOV_immediate = decoded.MOV_immediate;
+	instruction.DT_address = decoded.DT_address;
+	instruction.LSL = decoded.LSL;
+}
+
+bool writeProgramImage(string fileName, const vector<unsigned int>& words, const map<string, int>& symbols,
+	const vector<unsigned char>& data, int dataAddress, bool predecode)
+{
+	if ((dataAddress < 0) || (dataAddress + data.size() > dataMemory.size()))
+	{
+		cout << fileName << ": error: data segment does not fit in data memory" << endl;
+		return false;
+	}
+
+	ProgramImageHeader header = {};
+	memcpy(header.magic, imageMagic, sizeof(imageMagic));
+	header.version = imageVersion;
+	header.headerSize = sizeof(ProgramImageHeader);
+	header.entry = symbols.count("_start") ? symbols.at("_start") : 1;
+
+	vector<unsigned char> image(sizeof(ProgramImageHeader));
+
+	header.textOffset = image.size();
+	header.textWords = words.size();
+	appendImage(image, words.data(), words.size() * sizeof(unsigned int));
+	alignImage(image);
+
+	header.dataOffset = image.size();
+	header.dataBytes = data.size();
+	header.dataAddress = dataAddress;
+	appendImage(image, data.data(), data.size());
+	alignImage(image);
+
+	header.symbolOffset = image.size();
+	header.symbolCount = symbols.size();
+	for (auto &symbol : symbols)
+	{
+		unsigned int entry[2] = { (unsigned int)symbol.second, (unsigned int)symbol.first.size() };
+		appendImage(image, entry, sizeof(entry));
+		appendImage(image, symbol.first.data(), symbol.first.size());
+		while (image.size() % 4) image.push_back(0);
+	}
+	alignImage(image);
+
+	if (predecode)
+	{
+		header.decodedOffset = image.size();
+		header.decodedCount = words.size();
+		vector<DecodedInstruction> decoded = predecodeWords(words);
+		appendImage(image, decoded.data(), decoded.size() * sizeof(DecodedInstruction));
+	}
+
+	memcpy(image.data(), &header, sizeof(header));
+
+	ofstream outfile(fileName, ios::binary);
+	if (!outfile)
+	{
+		cout << fileName << ": error: could not open file" << endl;
+		return false;
+	}
+	outfile.write((const char*)image.data(), image.size());
+	return bool(outfile);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////LOADING/////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool mapImageFile(string fileName)
+{
+#ifdef _WIN32
+	imageFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (imageFile == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(imageFile, &size) || (size.QuadPart == 0))
+	{
+		unloadProgramImage();
+		return false;
+	}
+	imageMapping = CreateFileMappingA(imageFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!imageMapping)
+	{
+		unloadProgramImage();
+		return false;
+	}
+	imageBase = (const unsigned char*)MapViewOfFile(imageMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!imageBase)
+	{
+		unloadProgramImage();
+		return false;
+	}
+	imageSize = (size_t)size.QuadPart;
+#else
+	int file = open(fileName.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	struct stat status;
+	if ((fstat(file, &status) != 0) || (status.st_size == 0))
+	{
+		close(file);
+		return false;
+	}
+	void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file); //the mapping keeps its own reference to the file
+	if (mapping == MAP_FAILED) return false;
+	imageBase = (const unsigned char*)mapping;
+	imageSize = status.st_size;
+#endif
+	return true;
+}
+
+void unloadProgramImage()
+{
+#ifdef _WIN32
+	if (imageBase) UnmapViewOfFile(imageBase);
+	if (imageMapping) CloseHandle(imageMapping);
+	if (imageFile != INVALID_HANDLE_VALUE) CloseHandle(imageFile);
+	imageMapping = NULL;
+	imageFile = INVALID_HANDLE_VALUE;
+#else
+	if (imageBase) munmap((void*)imageBase, imageSize);
+#endif
+	imageBase = nullptr;
+	imageSize = 0;
+	imageText = nullptr;
+	imageTextWords = 0;
+	imageDecoded = nullptr;
+	imageOwnedText.clear();
+	imageOwnedText.shrink_to_fit();
+}
+
+bool imageSectionFits(const ProgramImageHeader &header, unsigned long long offset, unsigned long long bytes)
+{
+	return (offset >= header.headerSize) && (offset % 4 == 0) && (offset + bytes <= imageSize);
+}
+
+bool loadProgramImage(string fileName)
+{//maps the image, points instruction fetch at its text and copies its data segment into data memory
+	unloadProgramImage();
+	if (!mapImageFile(fileName))
+	{
+		cout << fileName << ": error: could not map file" << endl;
+		return false;
+	}
+
+	const ProgramImageHeader &header = *(const ProgramImageHeader*)imageBase;
+	string problem;
+	if ((imageSize < sizeof(ProgramImageHeader)) || memcmp(header.magic, imageMagic, sizeof(imageMagic)))
+		problem = "not a program image";
+	else if ((header.version != imageVersion) || (header.headerSize != sizeof(ProgramImageHeader)))
+		problem = "unsupported image version " + to_string(header.version);
+	else if (!imageSectionFits(header, header.textOffset, 4ULL * header.textWords))
+		problem = "text segment runs past the end of the file";
+	else if (!imageSectionFits(header, header.dataOffset, header.dataBytes))
+		problem = "data segment runs past the end of the file";
+	else if ((unsigned long long)header.dataAddress + header.dataBytes > dataMemory.size())
+		problem = "data segment does not fit in data memory";
+	else if (!imageSectionFits(header, header.symbolOffset, 8ULL * header.symbolCount))
+		problem = "symbol table runs past the end of the file";
+	else if (header.decodedCount && ((header.decodedCount != header.textWords)
+		|| !imageSectionFits(header, header.decodedOffset, (unsigned long long)sizeof(DecodedInstruction) * header.decodedCount)))
+		problem = "pre-decoded section does not match the text segment";
+	else if ((header.entry < 1) || (header.entry > header.textWords))
+		problem = "entry point is outside the text segment";
+
+	if (problem.empty())
+	{
+		assemblySymbols.clear();
+		size_t offset = header.symbolOffset;
+		for (unsigned int i = 0; i < header.symbolCount; i++)
+		{
+			unsigned int entry[2];
+			if (offset + sizeof(entry) > imageSize)
+			{
+				problem = "symbol table runs past the end of the file";
+				break;
+			}
+			memcpy(entry, imageBase + offset, sizeof(entry));
+			offset += sizeof(entry);
+			if (offset + entry[1] > imageSize)
+			{
+				problem = "symbol table runs past the end of the file";
+				break;
+			}
+			assemblySymbols[string((const char*)imageBase + offset, entry[1])] = entry[0];
+			offset += (entry[1] + 3) & ~3u;
+		}
+	}
+
+	if (!problem.empty())
+	{
+		cout << fileName << ": error: " << problem << endl;
+		unloadProgramImage();
+		return false;
+	}
+
+	imageText = (const unsigned int*)(imageBase + header.textOffset);
+	imageTextWords = header.textWords;
+	imageDecoded = header.decodedCount ? (const DecodedInstruction*)(imageBase + header.decodedOffset) : nullptr;
+	memcpy(dataMemory.data() + header.dataAddress, imageBase + header.dataOffset, header.dataBytes);
+	PC = header.entry;
+	return true;
+}
+
+void loadProgramText(const vector<unsigned int> &words)
+{//fetches a program from its words, for one the instruction memory strings cannot hold
+	unloadProgramImage();
+	imageOwnedText = words;
+	imageText = imageOwnedText.data();
+	imageTextWords = (int)imageOwnedText.size();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////BUILDER/////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int runImageBuilder(int argc, char* argv[])
+{//--image source.assembly output.img [--predecode] [--data file address]
+	if (argc < 4)
+	{
+		cout << "Usage: --image source.assembly output.img [--predecode] [--data file address]" << endl;
+		return 1;
+	}
+	string sourceName = argv[2];
+	string imageName = argv[3];
+	bool predecode = false;
+	vector<unsigned char> data;
+	int dataAddress = 0;
+
+	for (int i = 4; i < argc; i++)
+	{
+		string option = argv[i];
+		if (option == "--predecode") predecode = true;
+		else if ((option == "--data") && (i + 2 < argc))
+		{
+			ifstream datafile(argv[++i], ios::binary);
+			if (!datafile)
+			{
+				cout << argv[i] << ": error: could not open file" << endl;
+				return 1;
+			}
+			data.assign(istreambuf_iterator<char>(datafile), istreambuf_iterator<char>());
+			string address = argv[++i];
+			size_t used = 0;
+			long long location = 0;
+			try { location = stoll(address, &used, 0); }
+			catch (const exception &) { used = 0; }
+			if (used != address.size())
+			{
+				cout << "Malformed number in --data option" << endl;
+				return 1;
+			}
+			if ((location < 0) || (location + (long long)data.size() > (long long)dataMemory.size()))
+			{
+				cout << argv[i - 1] << ": error: " << data.size() << " bytes at address " << address << " do not fit in data memory" << endl;
+				return 1;
+			}
+			dataAddress = (int)location;
+		}
+		else
+		{
+			cout << "Unknown image option " << option << endl;
+			cout << "Usage: --image source.assembly output.img [--predecode] [--data file address]" << endl;
+			return 1;
+		}
+	}
+
+	vector<unsigned int> words;
+	int errors = assembleFile(sourceName, words);
+	if (errors)
+	{
+		cout << sourceName << ": " << errors << " error" << (errors == 1 ? "" : "s") << endl;
+		return 1;
+	}
+	if (!writeProgramImage(imageName, words, assemblySymbols, data, dataAddress, predecode)) return 1;
+	cout << "Wrote " << imageName << ": " << words.size() << " instructions, " << data.size() << " data bytes, "
+		<< assemblySymbols.size() << " symbols" << (predecode ? ", pre-decoded" : "") << endl;
+	return 0;
+}
@@ -0,0 +1,242 @@
+//Reuse distance and working set analyzer
+/*
+An instrumentation mode for sizing caches and placing prefetches. While it is on, every call to storeDataMemory() and
+loadDataMemory() and every instruction fetch is mapped to a cache line (instruction locations are 4 bytes apart) and measured:
+
+	reuse distance  distinct lines touched since the last access to the same line, the depth a fully associative LRU cache
+	                would find it at, in power of two buckets with first touches counted as cold
+	working set     distinct lines and pages touched in each window of clock cycles
+	hot lines/pages the lines and pages with the most accesses
+
+Reuse distances are counted with a Fenwick tree over access times that holds a mark at the latest access of each line, so one
+access costs O(log n) whatever the distance. Instruction and data sides are measured separately.
+
+	--locality prefix [--locality-line bytes] [--locality-window cycles]
+
+writes prefix-reuse.csv, prefix-workingset.csv and prefix-hot.csv when the run ends (defaults 64 byte lines, 4 KiB pages and
+windows of 10000 cycles).
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+const int localityPageBytes = 4096;
+const int localityHotCount = 10;
+
+bool localityEnabled = false;
+string localityPrefix;
+int localityLineBytes = 64;
+int localityWindow = 10000;
+
+class LocalitySide
+{//one address space, instruction fetch or data
+public:
+	void reset(string sideName, long long bytes)
+	{
+		name = sideName;
+		lastTime.assign(bytes / localityLineBytes + 1, -1);
+		lineCount.assign(lastTime.size(), 0);
+		lineWindow.assign(lastTime.size(), -1);
+		pageCount.assign(bytes / localityPageBytes + 1, 0);
+		pageWindow.assign(pageCount.size(), -1);
+		tree.assign(max<size_t>(4 * lastTime.size(), 1 << 16) + 1, 0);
+		now = 0;
+		reuse.assign(2, 0);
+		accesses = 0;
+		window = -1;
+		windows.clear();
+	}
+
+	void access(long long address, int size)
+	{
+		if ((address < 0) || (size <= 0)) return;
+		long long first = address / localityLineBytes;
+		long long last = (address + size - 1) / localityLineBytes;
+		for (long long line = first; (line <= last) && (line < (long long)lastTime.size()); line++) touch((int)line);
+	}
+
+	void finishWindow()
+	{
+		if (window >= 0) windows.push_back({ window, windowLines, windowPages, windowAccesses });
+	}
+
+	string name;
+	vector<long long> reuse; //[0] cold, [1] distance 0, [b + 1] distances 2^(b-1) .. 2^b - 1
+	vector<long long> lineCount;
+	vector<long long> pageCount;
+	long long accesses;
+	struct WindowSize { long long window, lines, pages, accesses; };
+	vector<WindowSize> windows;
+
+private:
+	void touch(int line)
+	{
+		accesses++;
+		lineCount[line]++;
+		int page = (int)((long long)line * localityLineBytes / localityPageBytes);
+		pageCount[page]++;
+
+		long long currentWindow = clockCycles / localityWindow;
+		if (currentWindow != window)
+		{
+			finishWindow();
+			window = currentWindow;
+			windowLines = windowPages = windowAccesses = 0;
+		}
+		windowAccesses++;
+		if (lineWindow[line] != window)
+		{
+			lineWindow[line] = window;
+			windowLines++;
+		}
+		if (pageWindow[page] != window)
+		{
+			pageWindow[page] = window;
+			windowPages++;
+		}
+
+		if (now + 1 >= (long long)tree.size()) compact();
+		long long previous = lastTime[line];
+		if (previous < 0) reuse[0]++;
+		else
+		{
+			long long distance = sum(now) - sum(previous + 1); //marks strictly between the two accesses
+			int bucket = 1;
+			while ((1LL << (bucket - 1)) <= distance) bucket++;
+			if ((int)reuse.size() <= bucket) reuse.resize(bucket + 1, 0);
+			reuse[bucket]++;
+			add(previous + 1, -1);
+		}
+		add(now + 1, 1);
+		lastTime[line] = now;
+		now++;
+	}
+
+	void add(long long index, int delta)
+	{
+		for (; index < (long long)tree.size(); index += index & -index) tree[index] += delta;
+	}
+
+	long long sum(long long index)
+	{//marks at times 1 .. index
+		long long total = 0;
+		for (; index > 0; index -= index & -index) total += tree[index];
+		return total;
+	}
+
+	void compact()
+	{//renumbers the latest access of each line 0, 1, 2 ... in order so the tree never has to grow
+		vector<pair<long long, int>> live;
+		for (size_t line = 0; line < lastTime.size(); line++)
+			if (lastTime[line] >= 0) live.push_back({ lastTime[line], (int)line });
+		sort(live.begin(), live.end());
+		fill(tree.begin(), tree.end(), 0);
+		for (size_t i = 0; i < live.size(); i++)
+		{
+			lastTime[live[i].second] = i;
+			add(i + 1, 1);
+		}
+		now = live.size();
+	}
+
+	vector<long long> lastTime; //time of the latest access per line, -1 before the first
+	vector<long long> lineWindow;
+	vector<long long> pageWindow;
+	vector<int> tree;
+	long long now;
+	long long window;
+	long long windowLines, windowPages, windowAccesses;
+};
+
+LocalitySide fetchSide;
+LocalitySide dataSide;
+
+void localityDataAccess(int location, int size)
+{
+	dataSide.access(location, size);
+}
+
+void localityFetch(int location)
+{
+	fetchSide.access(4LL * location, 4);
+}
+
+void startLocality(string prefix)
+{
+	localityPrefix = prefix;
+	fetchSide.reset("fetch", 4LL * memory.size());
+	dataSide.reset("data", dataMemory.size());
+	localityEnabled = true;
+}
+
+void writeHot(ofstream &csv, const LocalitySide &side, const vector<long long> &counts, string kind, int bytes)
+{
+	vector<int> order;
+	for (size_t i = 0; i < counts.size(); i++) if (counts[i]) order.push_back((int)i);
+	int shown = min<int>(localityHotCount, order.size());
+	partial_sort(order.begin(), order.begin() + shown, order.end(), [&](int a, int b) { return counts[a] > counts[b]; });
+	for (int i = 0; i < shown; i++)
+	{
+		csv << side.name << "," << kind << "," << (long long)order[i] * bytes << "," << counts[order[i]] << ","
+			<< double(counts[order[i]]) / side.accesses << endl;
+		if (i < 3)
+			cout << "  " << side.name << " hot " << kind << " at " << (long long)order[i] * bytes << ": " << counts[order[i]] << " accesses" << endl;
+	}
+}
+
+bool finishLocality()
+{
+	if (!localityEnabled) return true;
+	localityEnabled = false;
+	fetchSide.finishWindow();
+	dataSide.finishWindow();
+
+	ofstream reuse(localityPrefix + "-reuse.csv");
+	ofstream sizes(localityPrefix + "-workingset.csv");
+	ofstream hot(localityPrefix + "-hot.csv");
+	if (!reuse || !sizes || !hot)
+	{
+		cout << localityPrefix << ": error: could not open the locality CSV files" << endl;
+		return false;
+	}
+
+	reuse << "side,min_distance,max_distance,count,cumulative_hit_ratio" << endl;
+	sizes << "side,window_start_cycle,accesses,lines,pages,bytes" << endl;
+	hot << "side,kind,address,accesses,fraction" << endl;
+	for (LocalitySide *side : { &fetchSide, &dataSide })
+	{
+		reuse << side->name << ",cold,cold," << side->reuse[0] << "," << 0 << endl;
+		long long hits = 0;
+		for (size_t bucket = 1; bucket < side->reuse.size(); bucket++)
+		{//a fully associative LRU cache of more than max_distance lines hits everything up to here
+			hits += side->reuse[bucket];
+			long long low = (bucket == 1) ? 0 : (1LL << (bucket - 2));
+			long long high = (bucket == 1) ? 0 : (1LL << (bucket - 1)) - 1;
+			reuse << side->name << "," << low << "," << high << "," << side->reuse[bucket] << ","
+				<< (side->accesses ? double(hits) / side->accesses : 0) << endl;
+		}
+
+		long long largest = 0;
+		for (auto &window : side->windows)
+		{
+			sizes << side->name << "," << window.window * localityWindow << "," << window.accesses << "," << window.lines << ","
+				<< window.pages << "," << window.lines * localityLineBytes << endl;
+			largest = max(largest, window.lines);
+		}
+
+		cout << side->name << ": " << side->accesses << " line accesses, " << side->reuse[0] << " cold, largest working set "
+			<< largest << " lines (" << largest * localityLineBytes << " bytes) per " << localityWindow << " cycles" << endl;
+		writeHot(hot, *side, side->lineCount, "line", localityLineBytes);
+		writeHot(hot, *side, side->pageCount, "page", localityPageBytes);
+	}
+	cout << "Locality histograms written to " << localityPrefix << "-reuse.csv, -workingset.csv and -hot.csv" << endl;
+	return true;
+}
@@ -0,0 +1,369 @@
+//Microbenchmarks for the simulator primitives
+/*
+Times decode(), convertBinaryStringToInt, storeDataMemory/loadDataMemory, setFlags, hazardCheck() and a single execute()
+dispatch in isolation. Every primitive walks the same seeded random instruction stream, gets one untimed warm up pass, and is
+then timed over several samples so the mean ns per op can be reported with its spread.
+
+--save writes the results to a file and --compare reads one back, so a baseline build and a candidate build can be run with the
+same seed and the difference judged against the noise of both runs.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <bitset>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <iomanip>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct MicroOpcode
+{
+	string name;
+	int opcode;
+	char format;
+	int shamt; //function bits for opcodes that share a value, such as SDIV
+};
+
+//opcodes in the random stream, none of them branch or exit so each one can also be run through execute()
+MicroOpcode microOpcodes[] =
+{
+	{ "ADD", 0b10001011000, 'R', 0 },
+	{ "SUB", 0b11001011000, 'R', 0 },
+	{ "AND", 0b10001010000, 'R', 0 },
+	{ "ORR", 0b10101010000, 'R', 0 },
+	{ "MUL", 0b10011011000, 'R', 0 },
+	{ "SDIV", 0b10011010110, 'R', 0b000010 },
+	{ "ADDS", 0b10101011000, 'R', 0 },
+	{ "SUBS", 0b11101011000, 'R', 0 },
+	{ "LSL", 0b11010011011, 'R', 0 },
+	{ "LSR", 0b11010011010, 'R', 0 },
+	{ "ADDI", 0b1001000100, 'I', 0 },
+	{ "SUBI", 0b1101000100, 'I', 0 },
+	{ "ANDI", 0b1001001000, 'I', 0 },
+	{ "ORRI", 0b1011001000, 'I', 0 },
+	{ "LDUR", 0b11111000010, 'D', 0 },
+	{ "STUR", 0b11111000000, 'D', 0 },
+	{ "LDURB", 0b00111000010, 'D', 0 },
+	{ "STURB", 0b00111000000, 'D', 0 },
+};
+
+const int microStreamSize = 4096; //power of two so the stream index can wrap with a mask
+const int microDataBase = 4096; //base address for loads and stores, the 9 bit offsets stay non negative
+
+vector<string> microStream; //machine code
+vector<Instructions> microDecoded; //the stream after decode, with register values filled in for execute()
+vector<int> microValues;
+vector<int> microAddresses;
+volatile long long microSink; //results are folded in here so the timed calls can not be optimized away
+
+//field extractions made by decode(), used to exercise convertBinaryStringToInt the way the simulator does
+const int microFields[][3] = //start, end, checkNegative
+{
+	{ 27, 31, 0 }, { 22, 26, 0 }, { 11, 15, 0 }, { 16, 21, 0 }, { 10, 21, 1 }, { 20, 21, 0 },
+	{ 6, 31, 1 }, { 8, 26, 1 }, { 11, 19, 0 }, { 11, 19, 1 }, { 9, 10, 0 }, { 0, 10, 0 },
+};
+
+void buildMicroStream(unsigned int seed)
+{
+	default_random_engine engine(seed);
+	uniform_int_distribution<int> pickOpcode(0, sizeof(microOpcodes) / sizeof(microOpcodes[0]) - 1);
+	uniform_int_distribution<int> pickRegister(1, 30);
+	uniform_int_distribution<int> pickValue(-100000, 100000);
+
+	microStream.clear();
+	microDecoded.clear();
+	microValues.clear();
+	microAddresses.clear();
+
+	for (int i = 0; i < microStreamSize; i++)
+	{
+		MicroOpcode &op = microOpcodes[pickOpcode(engine)];
+		int Rd = pickRegister(engine);
+		int Rn = pickRegister(engine);
+		int Rm = pickRegister(engine);
+		string machineCode;
+
+		if (op.format == 'R')
+		{
+			int shamt = op.shamt ? op.shamt : engine() % 32; //shifts stay inside an int
+			machineCode = bitset<11>(op.opcode).to_string() + bitset<5>(Rm).to_string() + bitset<6>(shamt).to_string()
+				+ bitset<5>(Rn).to_string() + bitset<5>(Rd).to_string();
+		}
+		else if (op.format == 'I')
+			machineCode = bitset<10>(op.opcode).to_string() + bitset<12>(engine() % 4096).to_string()
+			+ bitset<5>(Rn).to_string() + bitset<5>(Rd).to_string();
+		else
+			machineCode = bitset<11>(op.opcode).to_string() + bitset<9>(8 * (engine() % 32)).to_string() + "00"
+			+ bitset<5>(Rn).to_string() + bitset<5>(Rd).to_string();
+
+		microStream.push_back(machineCode);
+		microValues.push_back(pickValue(engine));
+		microAddresses.push_back(microDataBase + 8 * (engine() % 4096));
+
+		fetchVars = machineCode;
+		decode();
+		Instructions decoded = decodeVars;
+		decoded._Rd = microValues.back();
+		decoded._Rt = microValues.back();
+		decoded._Rn = (op.format == 'D') ? microAddresses.back() : microValues.back();
+		decoded._Rm = 1 + engine() % 1000; //never zero, SDIV divides by it
+		microDecoded.push_back(decoded);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////PRIMITIVES//////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void microDecode(int i)
+{
+	fetchVars = microStream[i];
+	decode();
+	microSink += decodeVars.opcode;
+}
+
+void microConvert(int i)
+{
+	const int *field = microFields[i % 12];
+	microSink += convertBinaryStringToInt(microStream[i], field[0], field[1], 0, field[2]);
+}
+
+void microStore(int i)
+{
+	storeDataMemory(microValues[i], microAddresses[i], 8);
+}
+
+void microLoad(int i)
+{
+	microSink += loadDataMemory(microAddresses[i], 8);
+}
+
+void microSetFlags(int i)
+{
+	setFlags(microValues[i] % 4); //mix of negative, zero and positive results
+	microSink += zeroFlag + negativeFlag;
+}
+
+void microHazardCheck(int i)
+{
+	executeVars = microDecoded[i];
+	decodeVars = microDecoded[(i + 1) & (microStreamSize - 1)];
+	PC = 4 + (i & 1023);
+	hazardCheck();
+	microSink += executeVars._Rn;
+}
+
+void microExecute(int i)
+{
+	executeVars = microDecoded[i];
+	execute();
+	microSink += executeVars._Rd;
+}
+
+struct Primitive
+{
+	string name;
+	void(*op)(int i);
+};
+
+Primitive primitives[] =
+{
+	{ "decode", microDecode },
+	{ "convertBinaryStringToInt", microConvert },
+	{ "storeDataMemory", microStore },
+	{ "loadDataMemory", microLoad },
+	{ "setFlags", microSetFlags },
+	{ "hazardCheck", microHazardCheck },
+	{ "execute", microExecute },
+};
+
+struct MicroResult
+{
+	double mean; //ns per op
+	double deviation; //standard deviation of the sample means
+	double minimum;
+	int samples;
+};
+
+MicroResult timePrimitive(Primitive &primitive, int iterations, int repeat)
+{
+	for (int i = 0; i < microStreamSize; i++) primitive.op(i); //warm up caches, branch predictors and the string allocator
+
+	vector<double> sampleNs;
+	int position = 0;
+	for (int sample = 0; sample < repeat; sample++)
+	{
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			primitive.op(position);
+			position = (position + 1) & (microStreamSize - 1);
+		}
+		auto end = chrono::steady_clock::now();
+		sampleNs.push_back(chrono::duration<double, nano>(end - start).count() / iterations);
+	}
+
+	MicroResult result = { 0, 0, sampleNs[0], repeat };
+	for (double ns : sampleNs)
+	{
+		result.mean += ns;
+		result.minimum = min(result.minimum, ns);
+	}
+	result.mean /= repeat;
+	for (double ns : sampleNs) result.deviation += (ns - result.mean) * (ns - result.mean);
+	result.deviation = (repeat > 1) ? sqrt(result.deviation / (repeat - 1)) : 0;
+	return result;
+}
+
+bool readMicroResults(string fileName, map<string, MicroResult> &results)
+{//reads a file written by --save: name,mean,deviation,minimum,samples
+	ifstream file(fileName);
+	string line;
+	int number = 1;
+	getline(file, line); //header
+	while (getline(file, line))
+	{
+		number++;
+		if (!line.empty() && (line.back() == '\r')) line.pop_back();
+		if (line.empty()) continue;
+		stringstream fields(line);
+		string name, value;
+		MicroResult result;
+		try
+		{
+			getline(fields, name, ',');
+			getline(fields, value, ','); result.mean = stod(value);
+			getline(fields, value, ','); result.deviation = stod(value);
+			getline(fields, value, ','); result.minimum = stod(value);
+			getline(fields, value, ','); result.samples = stoi(value);
+		}
+		catch (const exception &)
+		{
+			cout << fileName << ":" << number << ": malformed result" << endl;
+			return false;
+		}
+		results[name] = result;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////HARNESS/////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int runMicrobenchmarks(int argc, char* argv[])
+{//--microbench [--only name] [--iterations N] [--repeat R] [--seed S] [--save file] [--compare file]
+	string only;
+	int iterations = 20000;
+	int repeat = 10;
+	unsigned int seed = 1;
+	string saveName;
+	string compareName;
+
+	for (int i = 2; i < argc; i++)
+	{
+		string option = argv[i];
+		try
+		{
+			if ((option == "--only") && (i + 1 < argc)) only = argv[++i];
+			else if ((option == "--iterations") && (i + 1 < argc)) iterations = stoi(argv[++i]);
+			else if ((option == "--repeat") && (i + 1 < argc)) repeat = stoi(argv[++i]);
+			else if ((option == "--seed") && (i + 1 < argc)) seed = stoul(argv[++i]);
+			else if ((option == "--save") && (i + 1 < argc)) saveName = argv[++i];
+			else if ((option == "--compare") && (i + 1 < argc)) compareName = argv[++i];
+			else
+			{
+				cout << "Unknown microbenchmark option " << option << endl;
+				cout << "Usage: --microbench [--only name] [--iterations N] [--repeat R] [--seed S] [--save file] [--compare file]" << endl;
+				return 1;
+			}
+		}
+		catch (const exception &)
+		{
+			cout << "Malformed number in " << option << " option" << endl;
+			return 1;
+		}
+	}
+	if ((iterations < 1) || (repeat < 1))
+	{
+		cout << "Iterations and repeat must be at least 1" << endl;
+		return 1;
+	}
+
+	map<string, MicroResult> baseline;
+	if (!compareName.empty())
+	{
+		if (!readMicroResults(compareName, baseline)) return 1;
+		if (baseline.empty())
+		{
+			cout << "No baseline results could be read from " << compareName << endl;
+			return 1;
+		}
+	}
+
+	resetSimulator();
+	pipeline = true; //the stages work on the latches as they are, nothing is copied in
+	quietOutput(true);
+	buildMicroStream(seed);
+	quietOutput(false);
+
+	ofstream save;
+	if (!saveName.empty())
+	{
+		save.open(saveName);
+		save << "primitive,mean_ns,stddev_ns,min_ns,samples" << endl;
+	}
+
+	cout << "Seed " << seed << ", " << repeat << " samples of " << iterations << " ops" << endl;
+	cout << left << setw(26) << "Primitive" << right << setw(10) << "ns/op" << setw(10) << "stddev" << setw(8) << "cv%" << setw(10) << "min";
+	if (!baseline.empty()) cout << setw(12) << "baseline" << setw(10) << "change" << "  Verdict";
+	cout << endl;
+
+	int matched = 0;
+	for (Primitive &primitive : primitives)
+	{
+		if (!only.empty() && (only != primitive.name)) continue;
+		matched++;
+
+		quietOutput(true);
+		MicroResult result = timePrimitive(primitive, iterations, repeat);
+		quietOutput(false);
+
+		cout << left << setw(26) << primitive.name << right << fixed << setprecision(1) << setw(10) << result.mean << setw(10) << result.deviation
+			<< setw(8) << (result.mean > 0 ? 100 * result.deviation / result.mean : 0) << setw(10) << result.minimum;
+
+		if (baseline.count(primitive.name))
+		{
+			MicroResult &before = baseline[primitive.name];
+			double change = 100 * (result.mean - before.mean) / before.mean;
+			//a difference smaller than twice the combined standard error of the two runs is reported as noise
+			double noise = 2 * sqrt(before.deviation * before.deviation / before.samples + result.deviation * result.deviation / result.samples);
+			string verdict = "noise";
+			if (result.mean + noise < before.mean) verdict = "faster";
+			else if (result.mean - noise > before.mean) verdict = "slower";
+			cout << setw(12) << before.mean << setw(9) << showpos << change << noshowpos << "%  " << verdict;
+		}
+		else if (!baseline.empty()) cout << setw(12) << "-" << setw(10) << "-" << "  no baseline";
+		cout << endl;
+		cout.unsetf(ios::floatfield);
+
+		if (save.is_open())
+			save << primitive.name << "," << result.mean << "," << result.deviation << "," << result.minimum << "," << result.samples << endl;
+	}
+
+	if (!matched)
+	{
+		cout << "No primitive named " << only << endl;
+		return 1;
+	}
+	return 0;
+}
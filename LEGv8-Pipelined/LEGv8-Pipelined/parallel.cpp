@@ -0,0 +1,206 @@
+//Parallel interval simulation
+/*
+--parallel splits a long detailed run into intervals and simulates them at the same time, one host process each:
+
+	checkpoint  the co-simulation reference model runs the program, with no pipeline, and stops --parallel-warmup
+	            instructions (default 1000) before the start of every interval of --parallel-interval instructions
+	            (default 100000). The state there, with an empty pipeline, is saved as prefix.N.ckp (checkpoint.cpp,
+	            prefix set by --parallel-prefix, default parallel)
+	simulate    each checkpoint is handed to a worker, a copy of this program started with --parallel-worker, which restores
+	            it, runs the warm up in the chosen mode so the pipeline is full when the interval starts, then the interval,
+	            and prints the cycles between the retirement of its first and last instructions. Up to --parallel-jobs
+	            workers (default every hardware thread) run at once, and each checkpoint is deleted when its worker is done
+	stitch      the cycle counts of the intervals add up to the cycles of the run; the first interval starts at cycle 0 and
+	            the last one runs through EXIT, so only the pipeline state at interval boundaries, rebuilt by the warm up,
+	            can differ from a single detailed run
+
+The simulator state is global, so the intervals run in processes rather than threads. The processor has no caches or
+predictors; the warm up only refills the pipeline, and a few instructions are enough for it. When the run ends, the final
+state of the reference becomes the simulator's so the usual report and --dump files see it.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <cstdio>
+#include <climits>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+bool parallelEnabled = false;
+long long parallelInterval = 100000;
+long long parallelWarmup = 1000;
+int parallelJobs = 0; //0 uses every hardware thread
+string parallelPrefix = "parallel";
+
+struct ParallelWorker
+{
+	int interval;
+	string checkpoint;
+	FILE *output;
+};
+
+long long measureInterval(long long warmup, long long instructions, long long &retired)
+{//from an empty pipeline, steps through warmup instructions and then instructions more, or to the end of the program,
+ //returning the cycles of the second part and the instructions it retired
+	while (!endProgram && (instructionsRetired < warmup)) stepProcessor();
+	long long startCycles = clockCycles;
+	long long startRetired = instructionsRetired;
+	while (!endProgram && (instructionsRetired < warmup + instructions)) stepProcessor();
+	retired = instructionsRetired - startRetired;
+	return clockCycles - startCycles;
+}
+
+FILE* startWorker(string program, string checkpoint, long long warmup, long long instructions)
+{
+	string command = "\"" + program + "\" --parallel-worker \"" + checkpoint + "\" " + (pipeline ? "1 " : "0 ")
+		+ to_string(warmup) + " " + to_string(instructions) + (unitTiming ? " --units \"" + unitsFile + "\"" : "") + pluginOptions();
+	cout.flush();
+#ifdef _WIN32
+	command = "\"" + command + "\""; //cmd.exe strips the outer pair of quotes
+	return _popen(command.c_str(), "r");
+#else
+	return popen(command.c_str(), "r");
+#endif
+}
+
+bool finishWorker(ParallelWorker &worker, long long &cycles, long long &retired)
+{//waits for the worker's result line
+	char line[256] = {};
+	bool reported = fgets(line, sizeof(line), worker.output) && (sscanf(line, "Interval %lld %lld", &cycles, &retired) == 2);
+#ifdef _WIN32
+	int status = _pclose(worker.output);
+#else
+	int status = pclose(worker.output);
+#endif
+	remove(worker.checkpoint.c_str());
+	if (!reported || status)
+	{
+		cout << "parallel: error: the worker for interval " << worker.interval << " failed" << endl;
+		return false;
+	}
+	return true;
+}
+
+int parseParallelOption(int argc, char* argv[], int i)
+{//number of arguments used by the parallel option at argv[i], 0 when it is not one, -1 on error
+	string option = argv[i];
+	if (option == "--parallel")
+	{
+		parallelEnabled = true;
+		return 1;
+	}
+	if ((option.compare(0, 11, "--parallel-") != 0) || (i + 1 >= argc)) return 0;
+	long long value = atoll(argv[i + 1]);
+	if (option == "--parallel-interval") parallelInterval = value;
+	else if (option == "--parallel-warmup") parallelWarmup = value;
+	else if (option == "--parallel-jobs") parallelJobs = (int)value;
+	else if (option == "--parallel-prefix") parallelPrefix = argv[i + 1];
+	else return 0;
+	if ((parallelInterval < 1) || (parallelWarmup < 0) || (parallelJobs < 0) || parallelPrefix.empty())
+	{
+		cout << "--parallel-interval must be positive, --parallel-warmup and --parallel-jobs at least 0" << endl;
+		return -1;
+	}
+	return 2;
+}
+
+bool runParallel(string program)
+{
+	int jobs = parallelJobs ? parallelJobs : max(1, (int)thread::hardware_concurrency());
+	deque<ParallelWorker> running;
+	long long executed = 0, cycles = 0, retired = 0;
+	int intervals = 0;
+	bool failed = false;
+	auto collect = [&]()
+	{//the oldest worker's result
+		long long intervalCycles = 0, intervalRetired = 0;
+		if (!finishWorker(running.front(), intervalCycles, intervalRetired)) failed = true;
+		cycles += intervalCycles;
+		retired += intervalRetired;
+		running.pop_front();
+	};
+
+	startCosim();
+	while (!failed)
+	{
+		string error;
+		long long start = (long long)intervals * parallelInterval;
+		long long warmup = min(parallelWarmup, start);
+		executed += runReference(start - warmup - executed, error);
+		if (error.empty() && (executed == start - warmup))
+		{//the simulator holds the checkpoint state while the reference goes on to see whether the interval starts before EXIT
+			adoptReference();
+			emptyPipeline();
+			executed += runReference(warmup, error);
+		}
+		if (!error.empty())
+		{
+			cout << "parallel: error after " << executed << " instructions: " << error << endl;
+			failed = true;
+		}
+		if (failed || (executed < start)) break;
+
+		ParallelWorker worker = { intervals, parallelPrefix + "." + to_string(intervals) + ".ckp", nullptr };
+		quietOutput(true);
+		bool saved = saveCheckpoint(worker.checkpoint);
+		quietOutput(false);
+		if (saved) worker.output = startWorker(program, worker.checkpoint, warmup, parallelInterval);
+		if (!worker.output)
+		{
+			cout << "parallel: error: could not start the worker for interval " << intervals << endl;
+			remove(worker.checkpoint.c_str());
+			failed = true;
+			break;
+		}
+		running.push_back(worker);
+		intervals++;
+		if ((int)running.size() >= jobs) collect();
+	}
+	while (!running.empty()) collect();
+	if (failed) return false;
+
+	adoptReference(); //the reference stopped at EXIT
+	clockCycles = cycles;
+	instructionsRetired = retired;
+	endProgram = 1;
+	cout << "Parallel: " << retired << " instructions in " << intervals << " intervals of " << parallelInterval << " on " << jobs
+		<< " jobs, " << parallelWarmup << " instructions of warm up each" << endl;
+	cout << "Stitched " << cycles << " cycles, CPI " << (retired ? double(cycles) / retired : 0) << endl;
+	return true;
+}
+
+int runParallelWorker(int argc, char* argv[])
+{//--parallel-worker checkpoint mode warmup instructions [--units file] [--plugin file]..., run by runParallel()
+	bool usage = argc < 6;
+	for (int i = 6; !usage && (i < argc); i += 2)
+	{
+		string option = argv[i];
+		if (i + 1 >= argc) usage = true;
+		else if (option == "--units") { if (!loadUnits(argv[i + 1])) return 1; }
+		else if (option == "--plugin") { if (!loadPlugin(argv[i + 1])) return 1; }
+		else usage = true;
+	}
+	if (usage)
+	{
+		cout << "Usage: --parallel-worker checkpoint 0|1 warmup instructions [--units file] [--plugin file]..." << endl;
+		return 1;
+	}
+	pipeline = (string(argv[3]) == "1");
+	quietOutput(true);
+	bool restored = restoreCheckpoint(argv[2]);
+	long long retired = 0;
+	long long cycles = restored ? measureInterval(atoll(argv[4]), atoll(argv[5]), retired) : 0;
+	quietOutput(false);
+	if (!restored)
+	{
+		cout << argv[2] << ": error: could not restore the checkpoint" << endl;
+		return 1;
+	}
+	cout << "Interval " << cycles << " " << retired << endl;
+	return 0;
+}
@@ -0,0 +1,169 @@
+//Custom instruction plugins
+/*
+--plugin file loads a shared library that adds instructions (the interface is in LEGv8-Plugin.h) and may be given more than
+once. Every 11 bit opcode a plugin instruction claims is entered in pluginOpcodes when it loads, so:
+
+	decode      a word whose opcode no built in instruction has (format 'X') looks its opcode up and takes the plugin's format
+	execute     the default case of the opcode switch looks the opcode up and calls the plugin's handler
+	timing      dependencesOf() (dataflow.cpp) marks the instruction with its plugin index, and units.cpp and the dataflow
+	            schedule use the plugin's latency and units for it
+	assembler   the mnemonics are added to the assembler, and disassemble() names them
+
+Built in instructions never reach either lookup. The reference model of cosim.cpp calls the same handler on its own registers
+and memory, so --cosim checks a plugin instruction as it does the rest, and --fast-forward, --simpoint and --parallel run it;
+the workers of --parallel load the same plugins. A handler writes data memory directly, past the debugger's undo log and
+watchpoints, so --plugin cannot be combined with --debug.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct PluginInstruction
+{
+	LegPluginInstruction spec;
+	UnitClass unit;
+};
+
+vector<string> pluginFiles;
+vector<PluginInstruction> pluginInstructions;
+array<short, 2048> pluginOpcodes; //11 bit opcode -> index + 1 into pluginInstructions, 0 when no plugin claims it
+int pluginInstructionCount = 0;
+
+bool builtInOpcode(int opcode)
+{//decode() tries the 6, 8, 9, 10 and 11 bit prefixes of the word in turn
+	return (findFormat(opcode >> 5) != 'X') || (findFormat(opcode >> 3) != 'X') || (findFormat(opcode >> 2) != 'X')
+		|| (findFormat(opcode >> 1) != 'X') || (findFormat(opcode) != 'X') || (opcode == 0b11111111111);
+}
+
+bool claimOpcodes(const LegPluginInstruction &spec, string fileName)
+{
+	unsigned int field = (spec.format == 'I') ? 0xFFC00000u : 0xFFE00000u;
+	string problem;
+	if ((spec.format != 'R') && (spec.format != 'I')) problem = "format must be 'R' or 'I'";
+	else if (!spec.name || !spec.execute) problem = "no name or execute handler";
+	else if ((spec.mask & ~field) || (spec.match & ~spec.mask)) problem = "mask and match must lie in the opcode field";
+	else if ((spec.latency < 1) || (spec.units < 1)) problem = "latency and units must be at least 1";
+
+	int claimed = 0;
+	for (int opcode = 0; problem.empty() && (opcode < (int)pluginOpcodes.size()); opcode++)
+	{
+		if ((((unsigned int)opcode << 21) & spec.mask) != spec.match) continue;
+		if (builtInOpcode(opcode)) problem = "opcode " + to_string(opcode) + " is a built in instruction";
+		else if (pluginOpcodes[opcode]) problem = "opcode " + to_string(opcode) + " is already " + pluginInstructions[pluginOpcodes[opcode] - 1].spec.name;
+		else
+		{
+			pluginOpcodes[opcode] = (short)(pluginInstructions.size() + 1);
+			claimed++;
+		}
+	}
+	if (problem.empty() && !claimed) problem = "the encoding matches no opcode";
+	if (!problem.empty())
+	{
+		cout << fileName << ": error: " << (spec.name ? spec.name : "instruction") << ": " << problem << endl;
+		return false;
+	}
+	pluginInstructions.push_back({ spec, { spec.latency, spec.pipelined != 0, spec.units } });
+	pluginInstructionCount = (int)pluginInstructions.size();
+	addAssemblyKeyword(spec.name, spec.format, (spec.format == 'I') ? spec.match >> 22 : spec.match >> 21);
+	return true;
+}
+
+bool loadPlugin(string fileName)
+{
+#ifdef _WIN32
+	HMODULE library = LoadLibraryA(fileName.c_str());
+	LegPluginEntry entry = library ? (LegPluginEntry)GetProcAddress(library, "legv8Plugin") : nullptr;
+#else
+	void *library = dlopen(fileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+	LegPluginEntry entry = library ? (LegPluginEntry)dlsym(library, "legv8Plugin") : nullptr;
+#endif
+	if (!entry)
+	{
+		cout << fileName << ": error: " << (library ? "no legv8Plugin function" : "could not load the library") << endl;
+		return false;
+	}
+
+	const LegPluginInstruction *table = nullptr;
+	int count = entry(LEGV8_PLUGIN_VERSION, &table);
+	if ((count <= 0) || !table)
+	{
+		cout << fileName << ": error: the plugin refused interface version " << LEGV8_PLUGIN_VERSION << endl;
+		return false;
+	}
+	for (int i = 0; i < count; i++) if (!claimOpcodes(table[i], fileName)) return false;
+	pluginFiles.push_back(fileName); //the library stays loaded until the program exits
+	return true;
+}
+
+int pluginIndex(int opcode)
+{//-1 unless a plugin claims the opcode
+	return ((opcode >= 0) && (opcode < (int)pluginOpcodes.size())) ? pluginOpcodes[opcode] - 1 : -1;
+}
+
+char pluginFormat(int opcode)
+{//called by decode() for opcodes no built in instruction has
+	int index = pluginIndex(opcode);
+	return (index < 0) ? 'X' : pluginInstructions[index].spec.format;
+}
+
+bool callPlugin(int index, const Instructions &instruction, int valueRd, int valueRn, int valueRm, int *registerFile,
+	unsigned char *memory, long long memoryBytes, int &result, string &error)
+{//runs the handler on either the timing model's state or the reference's
+	const LegPluginInstruction &spec = pluginInstructions[index].spec;
+	LegPluginContext context = { instruction.Rd, instruction.Rn, instruction.Rm, instruction.shamt, instruction.ALU_immediate,
+		valueRd, valueRn, valueRm, registerFile, memory, memoryBytes, clockCycles, valueRd };
+	int status = spec.execute(&context);
+	result = context.result;
+	if (status) error = string(spec.name) + " failed with status " + to_string(status);
+	return !status;
+}
+
+bool executePlugin()
+{//called by execute() for opcodes no built in instruction has, false when no plugin claims it either
+	int index = pluginIndex(executeVars.opcode);
+	if (index < 0) return false;
+	string error;
+	if (!callPlugin(index, executeVars, executeVars._Rd, executeVars._Rn, executeVars._Rm, registers.data(), dataMemory.data(),
+		(long long)dataMemory.size(), executeVars._Rd, error))
+	{
+		cout << "plugin: error at location " << executeVars.location << ": " << error << endl;
+		endProgram = 1;
+	}
+	else cout << "Executing " << pluginInstructions[index].spec.name << ", the result is " << executeVars._Rd << endl;
+	return true;
+}
+
+bool pluginReadsRd(int index)
+{
+	return pluginInstructions[index].spec.readsRd != 0;
+}
+
+const UnitClass &pluginUnit(int index)
+{
+	return pluginInstructions[index].unit;
+}
+
+string pluginName(int index)
+{
+	return pluginInstructions[index].spec.name;
+}
+
+string pluginOptions()
+{//the plugins again, for the command line of a parallel worker
+	string options;
+	for (const string &file : pluginFiles) options += " --plugin \"" + file + "\"";
+	return options;
+}
@@ -0,0 +1,340 @@
+//Reverse execution
+/*
+Time travel for the debugger. While history is on, every step of the processor (one clock cycle pipelined, the four cycles of
+one instruction unpipelined) appends an undo record to a log, holding the old value of everything the step changed:
+
+	fields      registers, vector registers, PC, SP, endProgram, fetchLocation and every int field of the three latches,
+	            as the difference from the new value
+	counters    clockCycles, stallUntil and the retired count, 64 bits wide, also as differences
+	flags       the condition flags, the hazard and branch flags and the latch formats, packed into one word
+	memory      the address and old bytes of each storeDataMemory() write, logged as the write happens
+
+Changes to the processor are found by comparing it with a shadow copy after each step, so a step costs a few hundred
+comparisons and around a hundred bytes of log, most of it the latches moving down the pipeline. Stepping back pops the newest record and writes the old values back, and going
+to a cycle unwinds records until it is reached.
+
+Full snapshots (the fields plus the non zero pages of data memory) are taken every 65536 steps. When the log grows past its
+budget (--debug-history MiB, default 256) the records of the oldest snapshot interval are dropped; the steps they covered are
+reached instead by restoring the snapshot before them and stepping forward quietly. Going forward past the newest step always
+executes, and the record of every re-executed step is logged again.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+const int historySnapshotSteps = 65536;
+const int historyPageBytes = 4096;
+
+struct HistorySnapshot
+{//the processor at the start of a step
+	long long step;
+	vector<int> fields;
+	vector<long long> counters;
+	long long retired;
+	unsigned long long packed;
+	vector<int> pages; //non zero data memory pages, their bytes follow in order in pageBytes
+	vector<unsigned char> pageBytes;
+};
+
+bool historyEnabled = false;
+long long historyBudget = 256LL << 20;
+long long historyStep; //steps taken since the start of the run
+
+vector<int*> historyFields; //record tag order, then historyCounters, then the retired count, packed flags and memory writes
+vector<int> fieldShadow; //values at the end of the last step
+vector<long long*> historyCounters;
+vector<long long> counterShadow;
+long long retiredShadow;
+unsigned long long packedShadow;
+
+vector<unsigned char> historyLog;
+vector<size_t> historySteps; //offset in historyLog of the record of each logged step
+long long historyFirst; //step of historySteps[0]
+vector<HistorySnapshot> historySnapshots;
+
+bool *historyFlags[] = { &negativeFlag, &zeroFlag, &overflowFlag, &carryFlag, &branched, &concurrentHazardn,
+	&concurrentHazardt, &concurrentHazardm, &storeFlag, &loadFlag, &atomic };
+const int historyFlagCount = sizeof(historyFlags) / sizeof(historyFlags[0]);
+
+int Instructions::* latchFields[] = { &Instructions::opcode, &Instructions::Rd, &Instructions::_Rd, &Instructions::Rn,
+	&Instructions::_Rn, &Instructions::Rm, &Instructions::_Rm, &Instructions::Rt, &Instructions::_Rt, &Instructions::shamt,
+	&Instructions::ALU_immediate, &Instructions::op, &Instructions::BR_address, &Instructions::COND_BR_address,
+	&Instructions::MOV_immediate, &Instructions::DT_address, &Instructions::LSL, &Instructions::location };
+
+Instructions *historyLatches[] = { &decodeVars, &executeVars, &writebackVars };
+
+int tagCounter(size_t counter) { return (int)(historyFields.size() + counter); }
+int tagRetired() { return tagCounter(historyCounters.size()); }
+int tagPacked() { return tagRetired() + 1; }
+int tagMemory() { return tagRetired() + 2; }
+
+void putHistoryVarint(unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		historyLog.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	historyLog.push_back((unsigned char)value);
+}
+
+unsigned long long getHistoryVarint(size_t &position)
+{
+	unsigned long long value = 0;
+	for (int shift = 0; ; shift += 7)
+	{
+		unsigned char byte = historyLog[position++];
+		value |= (unsigned long long)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return value;
+	}
+}
+
+unsigned long long packStateFlags()
+{//flags in the low bits, the decode, execute and writeback formats in bytes 2, 3 and 4
+	unsigned long long packed = 0;
+	for (int i = 0; i < historyFlagCount; i++) if (*historyFlags[i]) packed |= 1ULL << i;
+	for (int i = 0; i < 3; i++) packed |= (unsigned long long)(unsigned char)historyLatches[i]->format << (16 + 8 * i);
+	return packed;
+}
+
+void unpackStateFlags(unsigned long long packed)
+{
+	for (int i = 0; i < historyFlagCount; i++) *historyFlags[i] = (packed >> i) & 1;
+	for (int i = 0; i < 3; i++) historyLatches[i]->format = (char)(packed >> (16 + 8 * i));
+}
+
+void syncShadow()
+{
+	for (size_t i = 0; i < historyFields.size(); i++) fieldShadow[i] = *historyFields[i];
+	for (size_t i = 0; i < historyCounters.size(); i++) counterShadow[i] = *historyCounters[i];
+	retiredShadow = instructionsRetired;
+	packedShadow = packStateFlags();
+}
+
+void historyDataWrite(int location, int size)
+{//called by storeDataMemory() before the bytes change
+	if ((location < 0) || (location + size > (int)dataMemory.size())) return;
+	putHistoryVarint(tagMemory());
+	putHistoryVarint(location);
+	historyLog.push_back((unsigned char)size);
+	historyLog.insert(historyLog.end(), dataMemory.begin() + location, dataMemory.begin() + location + size);
+}
+
+void takeSnapshot()
+{
+	HistorySnapshot snapshot;
+	snapshot.step = historyStep;
+	for (int *field : historyFields) snapshot.fields.push_back(*field);
+	for (long long *counter : historyCounters) snapshot.counters.push_back(*counter);
+	snapshot.retired = instructionsRetired;
+	snapshot.packed = packStateFlags();
+	for (int page = 0; page < (int)dataMemory.size() / historyPageBytes; page++)
+	{
+		auto begin = dataMemory.begin() + page * historyPageBytes;
+		if (all_of(begin, begin + historyPageBytes, [](unsigned char byte) { return byte == 0; })) continue;
+		snapshot.pages.push_back(page);
+		snapshot.pageBytes.insert(snapshot.pageBytes.end(), begin, begin + historyPageBytes);
+	}
+	historySnapshots.push_back(snapshot);
+}
+
+void restoreSnapshot(const HistorySnapshot &snapshot)
+{
+	for (size_t i = 0; i < historyFields.size(); i++) *historyFields[i] = snapshot.fields[i];
+	for (size_t i = 0; i < historyCounters.size(); i++) *historyCounters[i] = snapshot.counters[i];
+	instructionsRetired = snapshot.retired;
+	unpackStateFlags(snapshot.packed);
+	dataMemory.fill(0);
+	for (size_t i = 0; i < snapshot.pages.size(); i++)
+		copy(snapshot.pageBytes.begin() + i * historyPageBytes, snapshot.pageBytes.begin() + (i + 1) * historyPageBytes,
+			dataMemory.begin() + snapshot.pages[i] * historyPageBytes);
+	fetchInstruction(fetchLocation); //fetchVars is always the word at fetchLocation
+
+	historyStep = historyFirst = snapshot.step;
+	historyLog.clear();
+	historySteps.clear();
+	syncShadow();
+}
+
+vector<int*> stateFields()
+{//every int of processor state, the registers and the vector registers, then PC, SP, endProgram and fetchLocation, then the latches
+	vector<int*> fields;
+	for (int &value : registers) fields.push_back(&value);
+	for (VectorRegister &vector : vectorRegisters)
+		for (int &lane : vector) fields.push_back(&lane);
+	for (int *scalar : { &PC, &SP, &endProgram, &fetchLocation }) fields.push_back(scalar);
+	for (Instructions *latch : historyLatches)
+		for (int Instructions::* field : latchFields) fields.push_back(&(latch->*field));
+	return fields;
+}
+
+vector<long long*> stateCounters()
+{//the 64 bit processor state, apart from the retired count which the checkpoint header and the undo log carry on their own
+	return { &clockCycles, &stallUntil };
+}
+
+void startHistory()
+{
+	historyFields = stateFields();
+	fieldShadow.assign(historyFields.size(), 0);
+	historyCounters = stateCounters();
+	counterShadow.assign(historyCounters.size(), 0);
+
+	historyStep = historyFirst = 0;
+	historyLog.clear();
+	historySteps.clear();
+	historySnapshots.clear();
+	syncShadow();
+	historyEnabled = true;
+}
+
+void trimHistory()
+{//drops whole snapshot intervals from the front of the log until it fits the budget
+	while ((long long)historyLog.size() > historyBudget)
+	{
+		auto next = find_if(historySnapshots.begin(), historySnapshots.end(),
+			[](const HistorySnapshot &snapshot) { return snapshot.step > historyFirst; });
+		if ((next == historySnapshots.end()) || (next->step >= historyStep)) return;
+		size_t cut = historySteps[next->step - historyFirst];
+		historyLog.erase(historyLog.begin(), historyLog.begin() + cut);
+		historySteps.erase(historySteps.begin(), historySteps.begin() + (next->step - historyFirst));
+		for (size_t &offset : historySteps) offset -= cut;
+		historyFirst = next->step;
+	}
+}
+
+bool stepForward()
+{//one step of the processor with its undo record, false once the program has ended
+	if (endProgram) return false;
+	if ((historyStep % historySnapshotSteps == 0) && (historySnapshots.empty() || (historySnapshots.back().step < historyStep)))
+		takeSnapshot();
+
+	historySteps.push_back(historyLog.size());
+	stepProcessor(); //storeDataMemory() logs its writes as they happen
+	for (size_t i = 0; i < historyFields.size(); i++)
+	{
+		int value = *historyFields[i];
+		if (value == fieldShadow[i]) continue;
+		putHistoryVarint(i);
+		putHistoryVarint(zigzag((long long)fieldShadow[i] - value));
+		fieldShadow[i] = value;
+	}
+	for (size_t i = 0; i < historyCounters.size(); i++)
+	{
+		long long value = *historyCounters[i];
+		if (value == counterShadow[i]) continue;
+		putHistoryVarint(tagCounter(i));
+		putHistoryVarint(zigzag(counterShadow[i] - value));
+		counterShadow[i] = value;
+	}
+	if (instructionsRetired != retiredShadow)
+	{
+		putHistoryVarint(tagRetired());
+		putHistoryVarint(zigzag(retiredShadow - instructionsRetired));
+		retiredShadow = instructionsRetired;
+	}
+	unsigned long long packed = packStateFlags();
+	if (packed != packedShadow)
+	{
+		putHistoryVarint(tagPacked());
+		putHistoryVarint(packed ^ packedShadow);
+		packedShadow = packed;
+	}
+	historyStep++;
+	trimHistory();
+	return true;
+}
+
+void unwindStep()
+{//undoes the newest logged step, its entries are applied newest first so repeated writes to a byte end at the oldest value
+	size_t begin = historySteps.back();
+	vector<size_t> entries;
+	for (size_t position = begin; position < historyLog.size(); )
+	{
+		entries.push_back(position);
+		int tag = (int)getHistoryVarint(position);
+		if (tag == tagMemory())
+		{
+			getHistoryVarint(position);
+			position += 1 + historyLog[position];
+		}
+		else getHistoryVarint(position);
+	}
+
+	for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry)
+	{
+		size_t position = *entry;
+		int tag = (int)getHistoryVarint(position);
+		if (tag == tagMemory())
+		{
+			int location = (int)getHistoryVarint(position);
+			int size = historyLog[position++];
+			copy(historyLog.begin() + position, historyLog.begin() + position + size, dataMemory.begin() + location);
+		}
+		else if (tag == tagPacked()) unpackStateFlags(packStateFlags() ^ getHistoryVarint(position));
+		else if (tag == tagRetired()) instructionsRetired += unzigzag(getHistoryVarint(position));
+		else if (tag >= tagCounter(0)) *historyCounters[tag - tagCounter(0)] += unzigzag(getHistoryVarint(position));
+		else *historyFields[tag] = (int)(*historyFields[tag] + unzigzag(getHistoryVarint(position)));
+	}
+
+	historyLog.resize(begin);
+	historySteps.pop_back();
+	historyStep--;
+}
+
+bool goToStep(long long step)
+{//false when the program ends first
+	if (step < 0) step = 0;
+	if (step < historyFirst)
+	{//older than the log, start again from the newest snapshot at or before it
+		while (historySnapshots.back().step > step) historySnapshots.pop_back();
+		quietOutput(true);
+		restoreSnapshot(historySnapshots.back());
+		while ((historyStep < step) && stepForward());
+		quietOutput(false);
+		return historyStep == step;
+	}
+	if (step < historyStep)
+	{
+		while (historyStep > step) unwindStep();
+		while (historySnapshots.back().step > historyStep) historySnapshots.pop_back();
+		fetchInstruction(fetchLocation);
+		syncShadow();
+		return true;
+	}
+	while ((historyStep < step) && stepForward());
+	return historyStep == step;
+}
+
+long long historyLoggedFrom()
+{//the oldest step going back reaches without re-executing
+	return historyFirst;
+}
+
+vector<pair<int, int>> lastStepWrites()
+{//location and size of the data memory writes of the newest logged step
+	vector<pair<int, int>> writes;
+	if (historySteps.empty()) return writes;
+	for (size_t position = historySteps.back(); position < historyLog.size(); )
+	{
+		int tag = (int)getHistoryVarint(position);
+		unsigned long long value = getHistoryVarint(position);
+		if (tag != tagMemory()) continue;
+		writes.push_back({ (int)value, historyLog[position] });
+		position += 1 + historyLog[position];
+	}
+	return writes;
+}
+
+void historyReport()
+{
+	cout << "History: step " << historyStep << " (cycle " << clockCycles << "), " << historySteps.size() << " steps logged from step "
+		<< historyFirst << " in " << historyLog.size() << " bytes of " << historyBudget << ", " << historySnapshots.size()
+		<< " snapshots every " << historySnapshotSteps << " steps" << endl;
+}
@@ -0,0 +1,129 @@
+//Semihosting
+/*
+SVC #call, the custom opcode 0b11111111110 beside EXIT, asks the host to do what a guest program has no device for. It is an
+R format instruction with Rd = X0, Rn = X1 and Rm = X2, so it reads its arguments from X0 to X2 and writes its result to X0
+in writeback like any other R format instruction:
+
+	0   exit    stops the run as EXIT does, and the simulator exits with X0 as its status
+	1   open    X0 data memory address of a NUL terminated path, X1 mode 0 read, 1 write (created or truncated) or 2 append;
+	            returns a handle, -1 on failure
+	2   read    X0 handle, X1 data memory address, X2 bytes; returns the bytes read, 0 at the end of the file, -1 on failure
+	3   write   X0 handle, X1 data memory address, X2 bytes; returns the bytes written, -1 on failure
+	4   close   X0 handle; returns 0, -1 on failure
+	5   clock   returns the clock cycle count
+
+Handles 0, 1 and 2 are the simulator's standard input, output and error. A read or write moves the whole buffer between the
+host file and dataMemory with one fread or fwrite, so a large transfer costs no more per byte than the host copy; only the
+debugger's undo log and watchpoints look at the range. The reference model of cosim.cpp cannot repeat a host call, so
+--cosim, --fast-forward, --simpoint and --parallel stop with an error at the first SVC. Files stay open across debugger steps
+in either direction and are not part of checkpoints; resetSimulator() closes them.
+
+	ADDI X0, X31, #0        X0 = address of a path placed at 0 by --data
+	ADDI X1, X31, #0        to read
+	SVC  #1                 X0 = handle
+	ADDI X1, X31, #1024     buffer
+	ADDI X2, X31, #512      bytes
+	SVC  #2                 X0 = bytes read
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+const int historyChunk = 255; //historyDataWrite() records the size of a write in one byte
+
+vector<FILE*> semihostFiles = { stdin, stdout, stderr }; //indexed by handle, nullptr once closed
+int semihostExitCode = 0;
+
+int operandInExecute(int number)
+{//a register as execute() sees it, the instruction in writeback has not written its register yet when pipelined; also used
+ //by simd.cpp for the scalar operands of vector instructions
+	if (pipeline && writebackVars.opcode && ((writebackVars.format == 'R') || (writebackVars.format == 'I'))
+		&& (writebackVars.opcode != 0b11010110000) && (writebackVars.Rd == number)) return writebackVars._Rd;
+	return registers[number];
+}
+
+FILE* semihostFile(int handle)
+{
+	return ((handle >= 0) && (handle < (int)semihostFiles.size())) ? semihostFiles[handle] : nullptr;
+}
+
+bool guestRange(int address, int bytes, bool store)
+{//true when the range is inside data memory, after telling the debugger about it; also used by the vector loads and stores
+	if ((address < 0) || (bytes < 0) || ((long long)address + bytes > (long long)dataMemory.size())) return false;
+	for (int page = address >> watchPageShift; bytes && (page <= (address + bytes - 1) >> watchPageShift); page++)
+	{
+		if (watchTags[page % watchTags.size()] & (store ? watchWrite : watchRead))
+		{
+			watchAccess(address, bytes, store);
+			break;
+		}
+	}
+	if (store && historyEnabled)
+		for (int offset = 0; offset < bytes; offset += historyChunk) historyDataWrite(address + offset, min(historyChunk, bytes - offset));
+	return true;
+}
+
+int semihostOpen(int address, int mode)
+{
+	string path;
+	while ((address >= 0) && (address < (int)dataMemory.size()) && dataMemory[address]) path += (char)dataMemory[address++];
+	const char *modes[] = { "rb", "wb", "ab" };
+	if ((address >= (int)dataMemory.size()) || (address < 0) || (mode < 0) || (mode > 2)) return -1;
+	FILE *file = fopen(path.c_str(), modes[mode]);
+	if (!file) return -1;
+	for (size_t handle = 3; handle < semihostFiles.size(); handle++)
+	{
+		if (semihostFiles[handle]) continue;
+		semihostFiles[handle] = file;
+		return (int)handle;
+	}
+	semihostFiles.push_back(file);
+	return (int)semihostFiles.size() - 1;
+}
+
+int semihostCall(int call)
+{//called by execute() for SVC, returns the value for X0
+	int x0 = operandInExecute(0), x1 = operandInExecute(1), x2 = operandInExecute(2);
+	FILE *file = semihostFile(x0);
+	switch (call)
+	{
+		case 0:
+			semihostExitCode = x0;
+			endProgram = 1;
+			return x0;
+		case 1: return semihostOpen(x0, x1);
+		case 2:
+			if (!file || !guestRange(x1, x2, true)) return -1;
+			if (file == stdin) cout.flush();
+			return (int)fread(dataMemory.data() + x1, 1, x2, file);
+		case 3:
+		{
+			if (!file || !guestRange(x1, x2, false)) return -1;
+			if ((file == stdout) || (file == stderr)) cout.flush();
+			int written = (int)fwrite(dataMemory.data() + x1, 1, x2, file);
+			fflush(file);
+			return written;
+		}
+		case 4:
+			if (!file || (x0 < 3)) return -1;
+			semihostFiles[x0] = nullptr;
+			return fclose(file) ? -1 : 0;
+		case 5: return clockCycles;
+		default: return -1;
+	}
+}
+
+void resetSemihosting()
+{//closes the files the program opened
+	semihostExitCode = 0;
+	for (size_t handle = 3; handle < semihostFiles.size(); handle++)
+		if (semihostFiles[handle]) fclose(semihostFiles[handle]);
+	semihostFiles.resize(3);
+}
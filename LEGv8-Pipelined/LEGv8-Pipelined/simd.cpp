@@ -0,0 +1,287 @@
+//Vector instructions
+/*
+A subset of the Advanced SIMD (NEON) instructions on 32 vector registers V0-V31 of 128 bits, in the custom opcodes below MARK.
+T is the arrangement, 16B, 8H or 4S lanes:
+
+	LDUR Qt, [Xn, #offset]      opcode 0b11111111001, D format, Vt = the 16 bytes at Xn + offset
+	STUR Qt, [Xn, #offset]      opcode 0b11111111000, D format, the 16 bytes at Xn + offset = Vt
+	ADD  Vd.T, Vn.T, Vm.T       opcode 0b11111111010, V format, also SUB, MUL, CMEQ, CMGT, SMIN, SMAX, UMIN, UMAX, AND, ORR, EOR
+	DUP  Vd.T, Xn               the same opcode, the low lane of Xn in every lane of Vd
+	ADDV Xd, Vn.T               opcode 0b11111111011, R format, reduces the lanes into Xd; also SMINV, SMAXV, UMINV, UMAXV
+
+The operation (VectorOperation) and the arrangement share the shamt field, operation * 4 + 0, 1 or 2 for 16B, 8H or 4S.
+CMEQ and CMGT set a lane to all ones where the comparison holds. The scalar registers are 32 bits wide, so the reductions write
+Xd directly instead of a vector register as ARM does; SMINV and SMAXV sign extend the result lane, the others zero extend it
+as UMOV would.
+
+Vector instructions read and write the vector registers in execute, one instruction after another in either mode, so they
+need no forwarding between each other. DUP and the loads and stores read Xn the way a host call reads its arguments
+(operandInExecute()), and the reductions write Xd in writeback like any R format instruction. A load or store is one memcpy
+between the register and dataMemory, after the checks and instrumentation a scalar access gets; an address outside data memory,
+the device registers included, stops the run with an error.
+
+Each operation is a single SSE instruction on the host, SSE4.1 for the 8 and 32 bit minimum and maximum and for the 32 bit
+multiply, with a portable loop over the lanes when the host does not have SSE4.1, for 16B MUL, which SSE does not have, and
+with --simd-scalar. The reference model of cosim.cpp always takes the loop, so --cosim checks one against the other. The
+vector registers are processor state (stateFields()), kept in checkpoints and the undo log of the debugger.
+*/
+
+#include <iostream>
+#include <string>
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HOST_SSE41
+#include <smmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SSE41_FUNCTION
+#else
+#define SSE41_FUNCTION __attribute__((target("sse4.1")))
+#endif
+#endif
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+const char *vectorOperationNames[vectorOperations] = { "ADD", "SUB", "MUL", "CMEQ", "CMGT", "SMIN", "SMAX", "UMIN", "UMAX",
+	"AND", "ORR", "EOR", "DUP" };
+const char *vectorArrangementNames[] = { "16B", "8H", "4S" };
+
+array<VectorRegister, 32> vectorRegisters;
+
+bool detectHostSimd()
+{
+#if defined(HOST_SSE41) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] >> 19) & 1;
+#elif defined(HOST_SSE41)
+	__builtin_cpu_init(); //hostSimd is set during static initialization, which may come before the compiler's own
+	return __builtin_cpu_supports("sse4.1");
+#else
+	return false;
+#endif
+}
+
+bool hostSimd = detectHostSimd(); //cleared by --simd-scalar
+
+bool vectorEncoding(int opcode, int shamt)
+{//false for the shamt values that are no operation, which only hand written machine code can hold
+	int operation = shamt >> 2;
+	if ((shamt & 3) == 3) return false;
+	if (opcode == opcodeAcross)
+		return (operation == vectorADD) || (operation == vectorSMIN) || (operation == vectorSMAX) || (operation == vectorUMIN) || (operation == vectorUMAX);
+	return operation < vectorOperations;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////PORTABLE LANES//////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename Lane>
+Lane laneResult(int operation, Lane a, Lane b)
+{//arithmetic wraps around in the lane, it is done on unsigned values
+	typedef typename make_unsigned<Lane>::type Unsigned;
+	switch (operation)
+	{
+		case vectorADD: return (Lane)((unsigned int)a + (unsigned int)b);
+		case vectorSUB: return (Lane)((unsigned int)a - (unsigned int)b);
+		case vectorMUL: return (Lane)((unsigned int)a * (unsigned int)b);
+		case vectorCMEQ: return (a == b) ? (Lane)-1 : 0;
+		case vectorCMGT: return (a > b) ? (Lane)-1 : 0;
+		case vectorSMIN: return min(a, b);
+		case vectorSMAX: return max(a, b);
+		case vectorUMIN: return ((Unsigned)a < (Unsigned)b) ? a : b;
+		case vectorUMAX: return ((Unsigned)a > (Unsigned)b) ? a : b;
+		case vectorAND: return a & b;
+		case vectorORR: return a | b;
+		case vectorEOR: return a ^ b;
+		default: return b; //DUP, b is the scalar
+	}
+}
+
+template<typename Lane>
+void portableLanes(int operation, const VectorRegister &n, const VectorRegister &m, int scalar, VectorRegister &result)
+{
+	const int count = 16 / sizeof(Lane);
+	Lane a[count], b[count];
+	memcpy(a, n.data(), 16);
+	memcpy(b, m.data(), 16);
+	for (int i = 0; i < count; i++) a[i] = laneResult<Lane>(operation, a[i], (operation == vectorDUP) ? (Lane)scalar : b[i]);
+	memcpy(result.data(), a, 16);
+}
+
+template<typename Lane>
+int portableAcross(int operation, const VectorRegister &n)
+{
+	const int count = 16 / sizeof(Lane);
+	Lane a[count];
+	memcpy(a, n.data(), 16);
+	Lane total = a[0];
+	for (int i = 1; i < count; i++) total = laneResult<Lane>(operation, total, a[i]);
+	return total;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////HOST SIMD///////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef HOST_SSE41
+SSE41_FUNCTION bool hostOperation(int operation, int size, __m128i a, __m128i b, __m128i &result)
+{//false for 16B MUL, the only operation SSE has no instruction for
+	switch (operation * 4 + size)
+	{
+		case vectorADD * 4 + 0: result = _mm_add_epi8(a, b); return true;
+		case vectorADD * 4 + 1: result = _mm_add_epi16(a, b); return true;
+		case vectorADD * 4 + 2: result = _mm_add_epi32(a, b); return true;
+		case vectorSUB * 4 + 0: result = _mm_sub_epi8(a, b); return true;
+		case vectorSUB * 4 + 1: result = _mm_sub_epi16(a, b); return true;
+		case vectorSUB * 4 + 2: result = _mm_sub_epi32(a, b); return true;
+		case vectorMUL * 4 + 1: result = _mm_mullo_epi16(a, b); return true;
+		case vectorMUL * 4 + 2: result = _mm_mullo_epi32(a, b); return true;
+		case vectorCMEQ * 4 + 0: result = _mm_cmpeq_epi8(a, b); return true;
+		case vectorCMEQ * 4 + 1: result = _mm_cmpeq_epi16(a, b); return true;
+		case vectorCMEQ * 4 + 2: result = _mm_cmpeq_epi32(a, b); return true;
+		case vectorCMGT * 4 + 0: result = _mm_cmpgt_epi8(a, b); return true;
+		case vectorCMGT * 4 + 1: result = _mm_cmpgt_epi16(a, b); return true;
+		case vectorCMGT * 4 + 2: result = _mm_cmpgt_epi32(a, b); return true;
+		case vectorSMIN * 4 + 0: result = _mm_min_epi8(a, b); return true;
+		case vectorSMIN * 4 + 1: result = _mm_min_epi16(a, b); return true;
+		case vectorSMIN * 4 + 2: result = _mm_min_epi32(a, b); return true;
+		case vectorSMAX * 4 + 0: result = _mm_max_epi8(a, b); return true;
+		case vectorSMAX * 4 + 1: result = _mm_max_epi16(a, b); return true;
+		case vectorSMAX * 4 + 2: result = _mm_max_epi32(a, b); return true;
+		case vectorUMIN * 4 + 0: result = _mm_min_epu8(a, b); return true;
+		case vectorUMIN * 4 + 1: result = _mm_min_epu16(a, b); return true;
+		case vectorUMIN * 4 + 2: result = _mm_min_epu32(a, b); return true;
+		case vectorUMAX * 4 + 0: result = _mm_max_epu8(a, b); return true;
+		case vectorUMAX * 4 + 1: result = _mm_max_epu16(a, b); return true;
+		case vectorUMAX * 4 + 2: result = _mm_max_epu32(a, b); return true;
+		case vectorAND * 4 + 0: case vectorAND * 4 + 1: case vectorAND * 4 + 2: result = _mm_and_si128(a, b); return true;
+		case vectorORR * 4 + 0: case vectorORR * 4 + 1: case vectorORR * 4 + 2: result = _mm_or_si128(a, b); return true;
+		case vectorEOR * 4 + 0: case vectorEOR * 4 + 1: case vectorEOR * 4 + 2: result = _mm_xor_si128(a, b); return true;
+		default: return false;
+	}
+}
+
+SSE41_FUNCTION bool hostLanes(int operation, int size, const VectorRegister &n, const VectorRegister &m, int scalar, VectorRegister &result)
+{
+	__m128i a = _mm_loadu_si128((const __m128i*)n.data());
+	__m128i b = _mm_loadu_si128((const __m128i*)m.data());
+	__m128i lanes;
+	if (operation == vectorDUP)
+		lanes = (size == 0) ? _mm_set1_epi8((char)scalar) : (size == 1) ? _mm_set1_epi16((short)scalar) : _mm_set1_epi32(scalar);
+	else if (!hostOperation(operation, size, a, b, lanes)) return false;
+	_mm_storeu_si128((__m128i*)result.data(), lanes);
+	return true;
+}
+
+SSE41_FUNCTION int hostAcross(int operation, int size, const VectorRegister &n)
+{//folds the upper half of the vector onto the lower until lane 0 holds the result
+	__m128i lanes = _mm_loadu_si128((const __m128i*)n.data());
+	hostOperation(operation, size, lanes, _mm_srli_si128(lanes, 8), lanes);
+	hostOperation(operation, size, lanes, _mm_srli_si128(lanes, 4), lanes);
+	if (size < 2) hostOperation(operation, size, lanes, _mm_srli_si128(lanes, 2), lanes);
+	if (size < 1) hostOperation(operation, size, lanes, _mm_srli_si128(lanes, 1), lanes);
+	return _mm_cvtsi128_si32(lanes);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////EXECUTION///////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void vectorLanes(int shamt, const VectorRegister &n, const VectorRegister &m, int scalar, VectorRegister &result, bool host)
+{//the V format operations, host is false for the reference model
+	int operation = shamt >> 2, size = shamt & 3;
+#ifdef HOST_SSE41
+	if (host && hostLanes(operation, size, n, m, scalar, result)) return;
+#endif
+	if (size == 0) portableLanes<int8_t>(operation, n, m, scalar, result);
+	else if (size == 1) portableLanes<int16_t>(operation, n, m, scalar, result);
+	else portableLanes<int32_t>(operation, n, m, scalar, result);
+}
+
+int vectorAcross(int shamt, const VectorRegister &n, bool host)
+{//the reductions, the result lane extended to the value written to Xd
+	int operation = shamt >> 2, size = shamt & 3;
+	int lane;
+#ifdef HOST_SSE41
+	if (host) lane = hostAcross(operation, size, n);
+	else
+#endif
+	lane = (size == 0) ? portableAcross<int8_t>(operation, n) : (size == 1) ? portableAcross<int16_t>(operation, n) : portableAcross<int32_t>(operation, n);
+
+	if (size == 2) return lane;
+	int bits = 8 << size;
+	lane &= (1 << bits) - 1;
+	if (((operation == vectorSMIN) || (operation == vectorSMAX)) && (lane >> (bits - 1))) lane -= 1 << bits;
+	return lane;
+}
+
+void executeVector()
+{//called by execute() for the vector opcodes
+	const char *border = "==================================Excecute===================================";
+	Instructions &instruction = executeVars;
+	int operation = instruction.shamt >> 2, size = instruction.shamt & 3;
+	cout << border << endl;
+
+	if ((instruction.opcode == opcodeVectorStore) || (instruction.opcode == opcodeVectorLoad))
+	{//the base as forwarded becomes the latch's, so the trace and cosim see the address used
+		bool store = instruction.opcode == opcodeVectorStore;
+		instruction._Rn = operandInExecute(instruction.Rn);
+		int address = instruction._Rn + instruction.DT_address;
+		if (!guestRange(address, 16, store))
+		{
+			cout << "simd: error at location " << instruction.location << ": vector access at " << address << " is outside data memory" << endl;
+			endProgram = 1;
+		}
+		else
+		{
+			dataAccesses++;
+			if (localityEnabled) localityDataAccess(address, 16);
+			if (store) memcpy(dataMemory.data() + address, vectorRegisters[instruction.Rt].data(), 16);
+			else memcpy(vectorRegisters[instruction.Rt].data(), dataMemory.data() + address, 16);
+			cout << (store ? "Storing vector register " : "Loading vector register ") << instruction.Rt << (store ? " to address " : " from address ") << address << endl;
+		}
+	}
+	else if (!vectorEncoding(instruction.opcode, instruction.shamt))
+	{
+		cout << "simd: error at location " << instruction.location << ": shamt " << instruction.shamt << " is not a vector operation" << endl;
+		endProgram = 1;
+	}
+	else if (instruction.opcode == opcodeAcross)
+	{
+		instruction._Rd = vectorAcross(instruction.shamt, vectorRegisters[instruction.Rn], hostSimd);
+		cout << "Executing " << vectorOperationNames[operation] << "V across V" << instruction.Rn << "." << vectorArrangementNames[size]
+			<< ", the result is " << instruction._Rd << endl;
+	}
+	else
+	{
+		if (operation == vectorDUP) instruction._Rn = operandInExecute(instruction.Rn);
+		vectorLanes(instruction.shamt, vectorRegisters[instruction.Rn], vectorRegisters[instruction.Rm], instruction._Rn,
+			vectorRegisters[instruction.Rd], hostSimd);
+		cout << "Executing vector " << vectorOperationNames[operation] << " into V" << instruction.Rd << "." << vectorArrangementNames[size] << endl;
+	}
+	cout << border << endl;
+}
+
+string disassembleVector(const Instructions &instruction)
+{//called by disassemble() for the vector opcodes
+	int operation = instruction.shamt >> 2, size = instruction.shamt & 3;
+	if ((instruction.opcode == opcodeVectorStore) || (instruction.opcode == opcodeVectorLoad))
+		return string((instruction.opcode == opcodeVectorStore) ? "STUR" : "LDUR") + " Q" + to_string(instruction.Rt) + ", [X"
+			+ to_string(instruction.Rn) + ", #" + to_string(instruction.DT_address) + "]";
+	if (!vectorEncoding(instruction.opcode, instruction.shamt)) return "vector opcode " + to_string(instruction.opcode) + " with shamt " + to_string(instruction.shamt);
+
+	auto vector = [&](int number) { return "V" + to_string(number) + "." + vectorArrangementNames[size]; };
+	if (instruction.opcode == opcodeAcross) return string(vectorOperationNames[operation]) + "V X" + to_string(instruction.Rd) + ", " + vector(instruction.Rn);
+	if (operation == vectorDUP) return "DUP " + vector(instruction.Rd) + ", X" + to_string(instruction.Rn);
+	return string(vectorOperationNames[operation]) + " " + vector(instruction.Rd) + ", " + vector(instruction.Rn) + ", " + vector(instruction.Rm);
+}
@@ -0,0 +1,345 @@
+//Sampled simulation
+/*
+--simpoint estimates the CPI of a whole run from a few short detailed intervals, picked SimPoint style:
+
+	profile     the co-simulation reference model runs the program once, with no pipeline, and counts the instructions
+	            executed in each basic block (a block starts at the entry and after every branch) over every interval of
+	            --simpoint-interval instructions (default 10000), giving one basic block vector per interval
+	cluster     the vectors, each scaled to sum to 1, are grouped by k-means for k = 1 .. --simpoint-clusters (default 10),
+	            and the smallest k whose BIC score is within 90% of the best is used. Vectors less than 0.01 apart count
+	            as one phase (a floor on the variance), so a program with a single steady phase gets a single cluster. The
+	            program has at most a few thousand blocks, so the vectors are clustered directly rather than through a
+	            random projection
+	simulate    in each cluster the interval nearest its centre and up to --simpoint-samples - 1 more at random (default 3
+	            in all) are simulated in the chosen mode. The reference runs up to --simpoint-warmup instructions
+	            (default 1000) before the interval, the pipeline starts empty there and fills during the warm up, and only
+	            the cycles of the interval itself are counted
+	estimate    the CPI is the mean of each cluster's samples weighted by the instructions in the cluster, and the bound is
+	            1.96 standard errors of that stratified sample, with the finite population correction
+
+Clusters where every interval was simulated add no error, and a bound needs two samples in every other cluster. Sampling is
+repeatable, the random choices use a fixed seed.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <climits>
+#include <iomanip>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+bool simpointEnabled = false;
+long long simpointInterval = 10000;
+int simpointClusters = 10;
+long long simpointWarmup = 1000;
+int simpointSamples = 3;
+
+struct SimpointInterval
+{
+	long long start; //instructions executed before it
+	long long length;
+	vector<pair<int, int>> blocks; //block number, instructions executed in it
+	int cluster;
+	double cpi; //measured, -1 until simulated
+};
+
+vector<bool> simpointBranch; //by location, whether the instruction ends a basic block
+vector<int> simpointBlock; //by location, the block it leads or -1
+int simpointBlocks;
+vector<int> blockCounts; //instructions per block in the interval being profiled
+vector<SimpointInterval> simpointIntervals;
+int currentBlock;
+bool blockEnded;
+long long profiled;
+
+void closeInterval()
+{
+	SimpointInterval interval = { profiled - (profiled - 1) % simpointInterval - 1, 0, {}, 0, -1 };
+	for (int block = 0; block < simpointBlocks; block++)
+	{
+		if (!blockCounts[block]) continue;
+		interval.blocks.push_back({ block, blockCounts[block] });
+		interval.length += blockCounts[block];
+		blockCounts[block] = 0;
+	}
+	simpointIntervals.push_back(interval);
+}
+
+void profileInstruction(int location)
+{//runReference() visitor
+	if (blockEnded)
+	{
+		if (simpointBlock[location] < 0)
+		{
+			simpointBlock[location] = simpointBlocks++;
+			blockCounts.push_back(0);
+		}
+		currentBlock = simpointBlock[location];
+	}
+	blockCounts[currentBlock]++;
+	blockEnded = simpointBranch[location];
+	if (++profiled % simpointInterval == 0) closeInterval();
+}
+
+double distanceSquared(const vector<double> &a, const vector<double> &b)
+{
+	double total = 0;
+	for (size_t i = 0; i < a.size(); i++) total += (a[i] - b[i]) * (a[i] - b[i]);
+	return total;
+}
+
+struct Clustering
+{
+	vector<vector<double>> centres;
+	vector<int> assignment;
+	double bic;
+};
+
+Clustering kMeans(const vector<vector<double>> &points, int k, mt19937 &random)
+{//k-means++ seeding, then Lloyd iterations until no point moves
+	Clustering result;
+	uniform_int_distribution<size_t> pick(0, points.size() - 1);
+	result.centres.push_back(points[pick(random)]);
+	vector<double> nearest(points.size());
+	while ((int)result.centres.size() < k)
+	{
+		double total = 0;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			nearest[i] = distanceSquared(points[i], result.centres[0]);
+			for (const vector<double> &centre : result.centres) nearest[i] = min(nearest[i], distanceSquared(points[i], centre));
+			total += nearest[i];
+		}
+		if (total <= 0) break; //fewer distinct points than k
+		double target = uniform_real_distribution<double>(0, total)(random);
+		size_t chosen = 0;
+		for (; (chosen + 1 < points.size()) && (target > nearest[chosen]); chosen++) target -= nearest[chosen];
+		result.centres.push_back(points[chosen]);
+	}
+	k = (int)result.centres.size();
+
+	result.assignment.assign(points.size(), -1);
+	for (int iteration = 0; iteration < 100; iteration++)
+	{
+		bool moved = false;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			int best = 0;
+			for (int c = 1; c < k; c++)
+				if (distanceSquared(points[i], result.centres[c]) < distanceSquared(points[i], result.centres[best])) best = c;
+			if (best != result.assignment[i]) moved = true;
+			result.assignment[i] = best;
+		}
+		if (!moved) break;
+		vector<int> members(k, 0);
+		for (vector<double> &centre : result.centres) fill(centre.begin(), centre.end(), 0.0);
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			members[result.assignment[i]]++;
+			for (size_t d = 0; d < points[i].size(); d++) result.centres[result.assignment[i]][d] += points[i][d];
+		}
+		for (int c = 0; c < k; c++)
+			for (double &value : result.centres[c]) value /= max(1, members[c]);
+	}
+
+	//BIC of the clustering as spherical Gaussians with a shared variance (Pelleg and Moore)
+	const double pi = 3.14159265358979323846;
+	double R = (double)points.size();
+	double M = points.empty() ? 1 : (double)points[0].size();
+	double distortion = 0;
+	vector<double> sizes(k, 0);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		distortion += distanceSquared(points[i], result.centres[result.assignment[i]]);
+		sizes[result.assignment[i]]++;
+	}
+	double variance = max(distortion / max(1.0, R - k), 1e-4 / M); //vectors closer than 0.01 are the same phase
+	double likelihood = 0;
+	for (double size : sizes)
+	{
+		if (size <= 0) continue;
+		likelihood += size * log(size) - size * log(R) - size * M / 2 * log(2 * pi * variance) - (size - k) / 2;
+	}
+	result.bic = likelihood - k * (M + 1) / 2 * log(R);
+	return result;
+}
+
+bool simulateInterval(SimpointInterval &interval, long long &executed, long long &detailed)
+{//runs the reference up to the warm up, then the chosen mode through the interval
+	string error;
+	long long warmup = min(simpointWarmup, interval.start);
+	executed += runReference(interval.start - warmup - executed, error);
+	if (!error.empty())
+	{
+		cout << "simpoint: error: " << error << endl;
+		return false;
+	}
+	adoptReference();
+	emptyPipeline();
+
+	long long retired = 0;
+	long long cycles = measureInterval(warmup, interval.length, retired);
+	interval.cpi = retired ? double(cycles) / retired : 0;
+	detailed += instructionsRetired;
+	return true;
+}
+
+int parseSimpointOption(int argc, char* argv[], int i)
+{//number of arguments used by the simpoint option at argv[i], 0 when it is not one, -1 on error
+	string option = argv[i];
+	if (option == "--simpoint")
+	{
+		simpointEnabled = true;
+		return 1;
+	}
+	if ((option.compare(0, 11, "--simpoint-") != 0) || (i + 1 >= argc)) return 0;
+	long long value = atoll(argv[i + 1]);
+	if (option == "--simpoint-interval") simpointInterval = value;
+	else if (option == "--simpoint-clusters") simpointClusters = (int)value;
+	else if (option == "--simpoint-warmup") simpointWarmup = value;
+	else if (option == "--simpoint-samples") simpointSamples = (int)value;
+	else return 0;
+	if ((simpointInterval < 1) || (simpointClusters < 1) || (simpointWarmup < 0) || (simpointSamples < 1))
+	{
+		cout << "--simpoint-interval, --simpoint-clusters and --simpoint-samples must be positive, --simpoint-warmup at least 0" << endl;
+		return -1;
+	}
+	return 2;
+}
+
+bool runSimpoint()
+{
+	//profile
+	vector<DecodedInstruction> decoded = predecodeWords(currentText());
+	simpointBranch.assign(decoded.size() + 2, false);
+	for (size_t i = 0; i < decoded.size(); i++)
+	{
+		switch (decoded[i].opcode)
+		{
+			case 0b000101: case 0b100101: case 0b11010110000: case 0b10110100: case 0b10110101: case 0b01010100:
+				simpointBranch[i + 1] = true; //B, BL, BR, CBZ, CBNZ, B.cond
+				break;
+		}
+	}
+	simpointBlock.assign(decoded.size() + 2, -1);
+	simpointBlocks = 0;
+	blockCounts.clear();
+	simpointIntervals.clear();
+	blockEnded = true;
+	profiled = 0;
+
+	string error;
+	startCosim();
+	long long total = runReference(LLONG_MAX, error, profileInstruction);
+	if (!error.empty())
+	{
+		cout << "simpoint: error after " << total << " instructions: " << error << endl;
+		return false;
+	}
+	if (profiled % simpointInterval) closeInterval();
+	if (simpointIntervals.empty())
+	{
+		cout << "simpoint: the program executes no instructions before EXIT" << endl;
+		return false;
+	}
+
+	//cluster
+	vector<vector<double>> points;
+	for (const SimpointInterval &interval : simpointIntervals)
+	{
+		vector<double> point(simpointBlocks, 0.0);
+		for (const pair<int, int> &block : interval.blocks) point[block.first] = double(block.second) / interval.length;
+		points.push_back(point);
+	}
+	mt19937 random(20161);
+	vector<Clustering> candidates;
+	for (int k = 1; k <= min<int>(simpointClusters, points.size()); k++) candidates.push_back(kMeans(points, k, random));
+	double lowest = candidates[0].bic, highest = candidates[0].bic;
+	for (const Clustering &candidate : candidates)
+	{
+		lowest = min(lowest, candidate.bic);
+		highest = max(highest, candidate.bic);
+	}
+	const Clustering *chosen = &candidates.back();
+	for (const Clustering &candidate : candidates)
+	{
+		if (candidate.bic - lowest < 0.9 * (highest - lowest)) continue;
+		chosen = &candidate;
+		break;
+	}
+	int k = (int)chosen->centres.size();
+	for (size_t i = 0; i < simpointIntervals.size(); i++) simpointIntervals[i].cluster = chosen->assignment[i];
+
+	//choose the samples, nearest the centre first
+	vector<vector<int>> members(k);
+	for (size_t i = 0; i < simpointIntervals.size(); i++) members[simpointIntervals[i].cluster].push_back((int)i);
+	vector<int> samples;
+	for (int c = 0; c < k; c++)
+	{
+		if (members[c].empty()) continue;
+		auto nearest = min_element(members[c].begin(), members[c].end(), [&](int a, int b)
+			{ return distanceSquared(points[a], chosen->centres[c]) < distanceSquared(points[b], chosen->centres[c]); });
+		iter_swap(members[c].begin(), nearest);
+		shuffle(members[c].begin() + 1, members[c].end(), random);
+		for (int s = 0; (s < simpointSamples) && (s < (int)members[c].size()); s++) samples.push_back(members[c][s]);
+	}
+	sort(samples.begin(), samples.end());
+
+	//simulate
+	quietOutput(true);
+	startCosim();
+	long long executed = 0, detailed = 0;
+	bool simulated = true;
+	for (int sample : samples)
+	{
+		simulated = simulateInterval(simpointIntervals[sample], executed, detailed);
+		if (!simulated) break;
+	}
+	quietOutput(false);
+	if (!simulated) return false;
+
+	//estimate
+	double estimate = 0, variance = 0;
+	bool bounded = true;
+	cout << "Simpoint: " << total << " instructions in " << simpointIntervals.size() << " intervals of " << simpointInterval
+		<< ", " << simpointBlocks << " basic blocks, " << k << " clusters" << endl;
+	cout << setw(8) << "Cluster" << setw(10) << "Intervals" << setw(9) << "Weight" << setw(9) << "Sampled" << setw(9) << "CPI"
+		<< setw(9) << "Stddev" << "  Intervals simulated" << endl;
+	for (int c = 0; c < k; c++)
+	{
+		if (members[c].empty()) continue;
+		long long instructions = 0;
+		for (int member : members[c]) instructions += simpointIntervals[member].length;
+		double weight = double(instructions) / total;
+		int n = min<int>(simpointSamples, members[c].size());
+		double mean = 0, spread = 0;
+		for (int s = 0; s < n; s++) mean += simpointIntervals[members[c][s]].cpi / n;
+		for (int s = 0; s < n; s++) spread += pow(simpointIntervals[members[c][s]].cpi - mean, 2);
+		spread = (n > 1) ? spread / (n - 1) : 0;
+		estimate += weight * mean;
+		if (n < (int)members[c].size())
+		{
+			if (n < 2) bounded = false;
+			variance += weight * weight * (1 - double(n) / members[c].size()) * spread / n;
+		}
+
+		cout << setw(8) << c << setw(10) << members[c].size() << fixed << setprecision(3) << setw(9) << weight << setw(9) << n
+			<< setw(9) << mean << setw(9) << sqrt(spread) << " ";
+		for (int s = 0; s < n; s++) cout << " " << simpointIntervals[members[c][s]].start / simpointInterval;
+		cout << endl;
+	}
+	cout << "Estimated CPI " << estimate;
+	if (bounded) cout << " +/- " << 1.96 * sqrt(variance) << " (95%)";
+	else cout << ", no bound with one sample per cluster";
+	cout << ", about " << (long long)(estimate * total) << " cycles" << endl;
+	cout << "Detailed simulation of " << detailed << " instructions (" << setprecision(2) << 100.0 * detailed / total
+		<< "% of the run, warm up included)" << endl;
+	cout.unsetf(ios::floatfield);
+	return true;
+}
@@ -0,0 +1,689 @@
+//Retirement traces and trace driven replay
+/*
+--trace file records every instruction that retires in writeback() to a compact binary trace, and --replay file runs the
+pipeline again from that trace without executing anything: fetch, decode, hazardCheck() and writeback() work as usual, but the
+execute stage takes branch outcomes, register values and stores from the trace. A workload is captured once and can then be
+replayed under every execution mode, and replayed cycle counts match a full run of the same mode exactly.
+
+	header      TraceHeader, 48 bytes
+	text        one 32 bit word per instruction memory location, location 1 first
+	records     one per retired instruction, in retirement order
+
+Each record starts with a flags byte and is followed only by the fields its flags call for. Numbers are LEB128 varints and signed
+values are zigzag encoded first, so most records take two to four bytes:
+
+	traceJump       the next record is not at location + 1, the difference follows (branch taken)
+	traceWord       the instruction word differs from the text section, the word follows
+	traceRegister   register number byte, then the difference from the last value traced for that register
+	traceLoad       difference from the last traced data address, then the access size byte
+	traceStore      as traceLoad, followed by the value stored
+
+Records are packed on the simulator thread into one of two buffers while a writer thread sends the other to disk, so recording
+only waits on the disk when it falls a whole buffer behind. Data memory is not part of the trace; a replay starts from zeroed
+data memory and applies the traced stores. Vector registers (simd.cpp) are not traced either: a vector access records its
+address and 16 byte size only, and a replay leaves the memory a vector store wrote untouched.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+struct TraceHeader
+{
+	char magic[8]; //LEGV8TRC
+	unsigned int version;
+	unsigned int headerSize;
+	unsigned int textWords;
+	unsigned int entry; //location of the first record
+	unsigned long long records;
+	unsigned long long cycles; //clock cycles of the recorded run
+	unsigned int pipelined; //execution mode of the recorded run
+	unsigned int reserved;
+};
+
+static_assert(sizeof(TraceHeader) == 48, "trace header layout changed");
+
+const char traceMagic[8] = { 'L', 'E', 'G', 'V', '8', 'T', 'R', 'C' };
+const unsigned int traceVersion = 1;
+const size_t traceBufferSize = 1 << 20;
+
+const unsigned char traceJump = 0x01;
+const unsigned char traceWord = 0x02;
+const unsigned char traceRegister = 0x04;
+const unsigned char traceLoad = 0x08;
+const unsigned char traceStore = 0x10;
+
+const int opcodeEXIT = 0b11111111111;
+const int opcodeBL = 0b100101;
+const int opcodeBR = 0b11010110000;
+
+int dataAccessSize(int opcode)
+{//bytes moved by execute() for a load or store, 0 for anything else
+	switch (opcode)
+	{
+		case 0b11111000000: case 0b11111000010: case 0b11001000000: return 8; //STUR, LDUR, STXR
+		case 0b10111000000: case 0b10111000100: case 0b11001000010: return 4; //STURW, LDURSW, LDXR
+		case 0b01111000000: case 0b01111000010: return 2; //STURH, LDURH
+		case 0b00111000000: case 0b00111000010: return 1; //STURB, LDURB
+		case opcodeVectorStore: case opcodeVectorLoad: return 16; //STUR Q, LDUR Q
+		default: return 0;
+	}
+}
+
+bool isStore(int opcode)
+{
+	return (opcode == 0b11111000000) || (opcode == 0b11001000000) || (opcode == 0b10111000000) || (opcode == 0b01111000000) || (opcode == 0b00111000000)
+		|| (opcode == opcodeVectorStore);
+}
+
+unsigned long long zigzag(long long value)
+{
+	return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+}
+
+long long unzigzag(unsigned long long value)
+{
+	return (long long)(value >> 1) ^ -(long long)(value & 1);
+}
+
+unsigned int memoryWord(int location)
+{//the strings assembler() leaves can hold padding, anything but a '1' counts as a zero bit
+	unsigned int word = 0;
+	const string &text = memory.at(location);
+	for (size_t i = 0; i < 32; i++) word = (word << 1) | ((i < text.size()) && (text[i] == '1'));
+	return word;
+}
+
+vector<unsigned int> currentText()
+{//instruction memory as words, from the mapped image or the strings the assembler left
+	vector<unsigned int> words;
+	if (imageText)
+		return vector<unsigned int>(imageText, imageText + imageTextWords);
+	for (size_t location = 1; (location < memory.size()) && !memory[location].empty(); location++)
+		words.push_back(memoryWord(location));
+	return words;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////RECORDING///////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TraceWriter
+{//double buffered, the simulator fills one buffer while the writer thread drains the other
+public:
+	bool open(const string &fileName)
+	{
+		outfile.open(fileName, ios::binary);
+		if (!outfile) return false;
+		filling.reserve(traceBufferSize + 64);
+		draining.reserve(traceBufferSize + 64);
+		writer = thread(&TraceWriter::drain, this);
+		return true;
+	}
+
+	void put(unsigned char byte) { filling.push_back(byte); }
+
+	void putVarint(unsigned long long value)
+	{
+		while (value >= 0x80)
+		{
+			filling.push_back((unsigned char)(value | 0x80));
+			value >>= 7;
+		}
+		filling.push_back((unsigned char)value);
+	}
+
+	void putBytes(const void *bytes, size_t size)
+	{
+		const unsigned char *start = (const unsigned char*)bytes;
+		filling.insert(filling.end(), start, start + size);
+	}
+
+	void endRecord()
+	{
+		if (filling.size() >= traceBufferSize) handOff();
+	}
+
+	bool close(const TraceHeader &header)
+	{//flushes the last buffer, stops the writer and fills in the header
+		handOff();
+		{
+			lock_guard<mutex> lock(guard);
+			finished = true;
+		}
+		ready.notify_all();
+		writer.join();
+		outfile.seekp(0);
+		outfile.write((const char*)&header, sizeof(header));
+		outfile.close();
+		return !failed && !outfile.fail();
+	}
+
+private:
+	void handOff()
+	{
+		unique_lock<mutex> lock(guard);
+		ready.wait(lock, [this] { return !full; });
+		swap(filling, draining);
+		full = true;
+		lock.unlock();
+		ready.notify_all();
+	}
+
+	void drain()
+	{
+		unique_lock<mutex> lock(guard);
+		while (true)
+		{
+			ready.wait(lock, [this] { return full || finished; });
+			if (!full) return;
+			lock.unlock();
+			outfile.write((const char*)draining.data(), draining.size());
+			if (!outfile) failed = true;
+			draining.clear();
+			lock.lock();
+			full = false;
+			ready.notify_all();
+		}
+	}
+
+	ofstream outfile;
+	vector<unsigned char> filling;
+	vector<unsigned char> draining;
+	thread writer;
+	mutex guard;
+	condition_variable ready;
+	bool full = false; //draining holds bytes the writer has not written yet
+	bool finished = false;
+	bool failed = false;
+};
+
+bool traceRecording = false;
+TraceWriter *traceWriter = nullptr;
+vector<TraceListener> traceListeners; //analyzers fed live from the same records
+string traceFileName;
+TraceHeader traceHeader;
+vector<unsigned int> traceText;
+array<long long, 32> tracedRegisters;
+long long tracedAddress;
+TraceRecord pendingRecord; //a record waits for the next retirement so it knows where execution went
+bool recordPending;
+
+void beginRecording()
+{
+	if (traceRecording) return;
+	traceText = currentText();
+	traceHeader = {};
+	traceHeader.entry = PC;
+	tracedRegisters.fill(0);
+	tracedAddress = 0;
+	recordPending = false;
+	traceRecording = true;
+}
+
+void addTraceListener(TraceListener listener)
+{
+	beginRecording();
+	traceListeners.push_back(listener);
+}
+
+bool startTrace(string fileName)
+{
+	traceWriter = new TraceWriter;
+	if (!traceWriter->open(fileName))
+	{
+		cout << fileName << ": error: could not open file" << endl;
+		delete traceWriter;
+		traceWriter = nullptr;
+		return false;
+	}
+
+	beginRecording();
+	traceFileName = fileName;
+	memcpy(traceHeader.magic, traceMagic, sizeof(traceMagic));
+	traceHeader.version = traceVersion;
+	traceHeader.headerSize = sizeof(TraceHeader);
+	traceHeader.textWords = traceText.size();
+	traceHeader.pipelined = pipeline;
+	traceWriter->putBytes(&traceHeader, sizeof(traceHeader)); //rewritten with the counts when the trace is closed
+	traceWriter->putBytes(traceText.data(), traceText.size() * sizeof(unsigned int));
+	return true;
+}
+
+void emitRecord(const TraceRecord &record)
+{
+	TraceWriter &out = *traceWriter;
+	bool inText = (record.location >= 1) && (record.location <= (int)traceText.size());
+	unsigned char flags = 0;
+	if (record.nextLocation != record.location + 1) flags |= traceJump;
+	if (!inText) flags |= traceWord;
+	if (record.registerNumber >= 0) flags |= traceRegister;
+	if (record.size) flags |= record.store ? traceStore : traceLoad;
+
+	out.put(flags);
+	if (flags & traceJump) out.putVarint(zigzag((long long)record.nextLocation - (record.location + 1)));
+	if (flags & traceWord) out.putVarint(record.word); //only reached for code outside the text section
+	if (flags & traceRegister)
+	{
+		out.put((unsigned char)record.registerNumber);
+		out.putVarint(zigzag(record.value - tracedRegisters[record.registerNumber]));
+		tracedRegisters[record.registerNumber] = record.value;
+	}
+	if (record.size)
+	{
+		out.putVarint(zigzag(record.address - tracedAddress));
+		out.put((unsigned char)record.size);
+		tracedAddress = record.address;
+		if (record.store) out.putVarint(zigzag(record.stored));
+	}
+	out.endRecord();
+}
+
+void deliverRecord(const TraceRecord &record)
+{
+	if (traceWriter) emitRecord(record);
+	for (TraceListener listener : traceListeners) listener(record);
+	traceHeader.records++;
+}
+
+void recordRetirement()
+{//called from writeback() for each retiring instruction, the effects are read back the way execute() left them
+	const Instructions &instruction = writebackVars;
+	TraceRecord record = { instruction.location, instruction.location + 1, 0, -1, 0, 0, false, 0, 0 };
+	bool inText = (record.location >= 1) && (record.location <= (int)traceText.size());
+	record.word = inText ? traceText[record.location - 1] : memoryWord(record.location);
+	int size = dataAccessSize(instruction.opcode);
+
+	if (size)
+	{
+		record.size = size;
+		record.address = (long long)instruction._Rn + instruction.DT_address;
+		record.store = isStore(instruction.opcode);
+		if (record.store) record.stored = instruction._Rt;
+		else if (instruction.opcode != opcodeVectorLoad)
+		{//the instruction behind this one has executed since, re-read memory unless it was a store
+			record.registerNumber = instruction.Rt;
+			bool youngerStore = pipeline && isStore(executeVars.opcode);
+			bool measuring = localityEnabled; //not a guest access
+			localityEnabled = false;
+			record.value = youngerStore ? registers[instruction.Rt] : loadDataMemory((int)record.address, size);
+			localityEnabled = measuring;
+		}
+	}
+	else if (instruction.opcode == opcodeBL)
+	{
+		record.registerNumber = 30;
+		record.value = instruction.location + 1;
+	}
+	else if (((instruction.format == 'R') || (instruction.format == 'I')) && (instruction.opcode != opcodeBR))
+	{
+		record.registerNumber = instruction.Rd;
+		record.value = instruction._Rd;
+	}
+
+	if (recordPending)
+	{
+		pendingRecord.nextLocation = record.location;
+		deliverRecord(pendingRecord);
+	}
+	pendingRecord = record;
+	recordPending = true;
+}
+
+bool finishTrace()
+{
+	if (!traceRecording) return true;
+	if (recordPending)
+	{//the run ended on the EXIT that followed the last record
+		if (writebackVars.opcode == opcodeEXIT) pendingRecord.nextLocation = writebackVars.location;
+		deliverRecord(pendingRecord);
+	}
+	traceHeader.cycles = clockCycles;
+	traceRecording = false;
+	traceListeners.clear();
+	if (!traceWriter) return true;
+
+	bool ok = traceWriter->close(traceHeader);
+	delete traceWriter;
+	traceWriter = nullptr;
+	if (!ok)
+	{
+		cout << traceFileName << ": error: write failed" << endl;
+		return false;
+	}
+	cout << "Traced " << traceHeader.records << " retirements to " << traceFileName << endl;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////REPLAY//////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class TraceReader
+{
+public:
+	bool open(const string &fileName, string &problem)
+	{
+		infile.open(fileName, ios::binary);
+		if (!infile)
+		{
+			problem = "could not open file";
+			return false;
+		}
+		infile.read((char*)&header, sizeof(header));
+		if ((infile.gcount() != sizeof(header)) || memcmp(header.magic, traceMagic, sizeof(traceMagic)))
+		{
+			problem = "not a trace file";
+			return false;
+		}
+		if ((header.version != traceVersion) || (header.headerSize != sizeof(TraceHeader)))
+		{
+			problem = "unsupported trace version " + to_string(header.version);
+			return false;
+		}
+		text.resize(header.textWords);
+		infile.read((char*)text.data(), text.size() * sizeof(unsigned int));
+		if (infile.gcount() != (streamsize)(text.size() * sizeof(unsigned int)))
+		{
+			problem = "text section runs past the end of the file";
+			return false;
+		}
+		recordStart = infile.tellg();
+		return true;
+	}
+
+	void rewind()
+	{
+		infile.clear();
+		infile.seekg(recordStart);
+		buffer.clear();
+		position = 0;
+		remaining = header.records;
+		registerValues.fill(0);
+		address = 0;
+		nextLocation = header.entry;
+		corrupt = false;
+	}
+
+	bool next(TraceRecord &record)
+	{//false at the end of the trace or when it is cut short
+		if (!remaining) return false;
+		remaining--;
+		unsigned char flags = getByte();
+		record.location = nextLocation;
+		record.nextLocation = record.location + 1;
+		if (flags & traceJump) record.nextLocation += (int)unzigzag(getVarint());
+		nextLocation = record.nextLocation;
+
+		bool inText = (record.location >= 1) && (record.location <= (int)text.size());
+		record.word = (flags & traceWord) ? (unsigned int)getVarint() : inText ? text[record.location - 1] : 0;
+		record.registerNumber = -1;
+		if (flags & traceRegister)
+		{
+			record.registerNumber = getByte() & 31;
+			registerValues[record.registerNumber] += unzigzag(getVarint());
+			record.value = (int)registerValues[record.registerNumber];
+		}
+		record.size = 0;
+		record.store = false;
+		if (flags & (traceLoad | traceStore))
+		{
+			address += unzigzag(getVarint());
+			record.address = address;
+			record.size = getByte();
+			record.store = (flags & traceStore) != 0;
+			if (record.store) record.stored = (int)unzigzag(getVarint());
+		}
+		return !corrupt;
+	}
+
+	TraceHeader header;
+	vector<unsigned int> text;
+
+private:
+	unsigned char getByte()
+	{
+		if (position == buffer.size())
+		{
+			buffer.resize(traceBufferSize);
+			infile.read((char*)buffer.data(), buffer.size());
+			buffer.resize((size_t)infile.gcount());
+			position = 0;
+			if (buffer.empty())
+			{
+				corrupt = true;
+				return 0;
+			}
+		}
+		return buffer[position++];
+	}
+
+	unsigned long long getVarint()
+	{
+		unsigned long long value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			unsigned char byte = getByte();
+			value |= (unsigned long long)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) break;
+		}
+		return value;
+	}
+
+	ifstream infile;
+	streampos recordStart;
+	vector<unsigned char> buffer;
+	size_t position = 0;
+	unsigned long long remaining = 0;
+	array<long long, 32> registerValues;
+	long long address = 0;
+	int nextLocation = 0;
+	bool corrupt = false;
+};
+
+bool readTrace(string fileName, TraceListener listener, TraceSummary *summary)
+{//feeds every record of a trace file to an analyzer
+	TraceReader trace;
+	string problem;
+	if (!trace.open(fileName, problem))
+	{
+		cout << fileName << ": error: " << problem << endl;
+		return false;
+	}
+	trace.rewind();
+	TraceRecord record;
+	unsigned long long count = 0;
+	while (trace.next(record))
+	{
+		listener(record);
+		count++;
+	}
+	if (count != trace.header.records)
+	{
+		cout << fileName << ": error: trace ends after " << count << " of " << trace.header.records << " records" << endl;
+		return false;
+	}
+	if (summary)
+	{
+		summary->records = trace.header.records;
+		summary->cycles = trace.header.cycles;
+		summary->pipelined = trace.header.pipelined != 0;
+	}
+	return true;
+}
+
+TraceReader *replayTrace = nullptr;
+string replayError;
+long long replayed;
+
+void replayExecute()
+{//stands in for execute(), applying the traced effects of the instruction instead of computing them
+	if (!pipeline)
+	{
+		executeVars = decodeVars;
+		executeVars._Rd = registers.at(executeVars.Rd);
+		executeVars._Rm = registers.at(executeVars.Rm);
+		executeVars._Rn = registers.at(executeVars.Rn);
+		executeVars._Rt = registers.at(executeVars.Rt);
+	}
+	if (executeVars.opcode == 0) return; //bubble
+	if (executeVars.opcode == opcodeEXIT)
+	{
+		endProgram = 1;
+		return;
+	}
+
+	TraceRecord record;
+	if (!replayTrace->next(record))
+	{
+		replayError = "trace ended before instruction at " + to_string(executeVars.location);
+		endProgram = 1;
+		return;
+	}
+	if (record.location != executeVars.location)
+	{
+		replayError = "trace expected location " + to_string(record.location) + " but the pipeline executed " + to_string(executeVars.location);
+		endProgram = 1;
+		return;
+	}
+	replayed++;
+
+	if (record.registerNumber >= 0)
+	{
+		if ((executeVars.format == 'R') || (executeVars.format == 'I')) executeVars._Rd = record.value; //written by writeback()
+		else registers.at(record.registerNumber) = record.value; //loads and BL write in execute()
+	}
+	if (record.store && (record.size <= 8))
+	{
+		for (int i = 0; i < record.size; i++) dataMemory.at(record.address + i) = (unsigned char)((long long)record.stored >> (8 * i));
+	}
+	if (record.nextLocation != record.location + 1)
+	{
+		PC = record.nextLocation;
+		branched = true;
+	}
+}
+
+void replayPipelined()
+{
+	while (!endProgram)
+	{
+		fetch();
+		decode();
+		forwarding();
+		replayExecute();
+		writeback();
+		clockCycles++;
+		hazardCheck();
+	}
+}
+
+void replayUnpipelined()
+{
+	while (!endProgram)
+	{
+		fetch();
+		clockCycles++;
+		decode();
+		clockCycles++;
+		replayExecute();
+		clockCycles++;
+		writeback();
+		clockCycles++;
+	}
+}
+
+int runReplay(int argc, char* argv[])
+{//--replay file [--mode unpipelined|pipelined]
+	if (argc < 3)
+	{
+		cout << "Usage: --replay file [--mode unpipelined|pipelined]" << endl;
+		return 1;
+	}
+	string fileName = argv[2];
+	string onlyMode;
+	for (int i = 3; i < argc; i++)
+	{
+		string option = argv[i];
+		if ((option == "--mode") && (i + 1 < argc)) onlyMode = argv[++i];
+		else
+		{
+			cout << "Unknown replay option " << option << endl;
+			cout << "Usage: --replay file [--mode unpipelined|pipelined]" << endl;
+			return 1;
+		}
+	}
+
+	TraceReader trace;
+	string problem;
+	if (!trace.open(fileName, problem))
+	{
+		cout << fileName << ": error: " << problem << endl;
+		return 1;
+	}
+	vector<DecodedInstruction> decoded = predecodeWords(trace.text);
+	replayTrace = &trace;
+
+	cout << fileName << ": " << trace.header.records << " retirements, recorded " << (trace.header.pipelined ? "pipelined" : "unpipelined")
+		<< " in " << trace.header.cycles << " cycles" << endl;
+	cout << left << setw(12) << "Mode" << right << setw(12) << "Instr" << setw(12) << "Cycles" << setw(8) << "CPI" << setw(10) << "Seconds"
+		<< setw(10) << "MIPS" << "  Result" << endl;
+
+	int failures = 0;
+	const char *modeNames[] = { "unpipelined", "pipelined" };
+	for (int mode = 0; mode < 2; mode++)
+	{
+		if (!onlyMode.empty() && (onlyMode != modeNames[mode])) continue;
+
+		resetSimulator();
+		imageText = trace.text.data(); //fetch and decode straight from the trace's text, already decoded
+		imageTextWords = trace.text.size();
+		imageDecoded = decoded.data();
+		pipeline = (mode == 1);
+		PC = trace.header.entry;
+		fetchInstruction(PC);
+		trace.rewind();
+		replayed = 0;
+		replayError.clear();
+
+		quietOutput(true);
+		auto start = chrono::steady_clock::now();
+		if (pipeline) replayPipelined();
+		else replayUnpipelined();
+		auto end = chrono::steady_clock::now();
+		quietOutput(false);
+
+		TraceRecord extra;
+		if (replayError.empty() && trace.next(extra)) replayError = "pipeline reached EXIT with records left in the trace";
+		string result = "ok";
+		if (!replayError.empty()) result = "FAILED";
+		else if ((pipeline == (trace.header.pipelined != 0)) && (clockCycles != (long long)trace.header.cycles)) result = "cycles differ from recording";
+		if (result != "ok") failures++;
+
+		double seconds = chrono::duration<double>(end - start).count();
+		double cpi = instructionsRetired ? double(clockCycles) / instructionsRetired : 0;
+		double mips = (seconds > 0) ? instructionsRetired / seconds / 1e6 : 0;
+		cout << left << setw(12) << modeNames[mode] << right << setw(12) << instructionsRetired << setw(12) << clockCycles << setw(8) << fixed
+			<< setprecision(3) << cpi << setw(10) << setprecision(4) << seconds << setw(10) << setprecision(4) << mips << "  " << result << endl;
+		cout.unsetf(ios::floatfield);
+		if (!replayError.empty()) cout << fileName << ": error: " << replayError << endl;
+	}
+
+	imageText = nullptr; //the vectors belong to this function
+	imageTextWords = 0;
+	imageDecoded = nullptr;
+	replayTrace = nullptr;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+//Functional unit timing
+/*
+--units file describes the functional units of a target core, one line per latency class of dataflow.cpp (alu, mul, div,
+load, store, branch), and the run then times every instruction that enters execute against that table:
+
+	# a core with a slow divider
+	mul     latency=3   pipelined=yes   units=1
+	div     latency=20  pipelined=no    units=1
+	load    latency=2
+
+	latency     cycles from entering execute until the result can be used by the next instruction (default 1)
+	pipelined   yes when a unit accepts a new instruction every cycle, no when it is busy for the whole latency (default yes)
+	units       how many instructions of the class can be in flight at once (default 1)
+
+An instruction in execute waits until its source registers (and the flags for B.cond) are ready, a data stall, and then until
+a unit of its class is free, a structural stall. Pipelined, the waiting holds the whole processor through stallProcessor()
+(events.cpp) but a long latency by itself does not, so independent instructions go on while a multiply is in flight.
+Unpipelined, execute also takes the full latency of the instruction, and the cycles past the first are counted as latency
+cycles. Instructions still execute functionally when they enter
+execute; only the cycles are affected, and a table of all 1 latency pipelined units gives the timing of a run without one.
+
+Classes a file leaves out keep the defaults. The latencies also replace the dataflow defaults for --ilp and --dataflow. The
+unit state is not in the undo log or in checkpoints, so --units cannot be combined with --debug, and a checkpoint taken
+mid-run restores without the instructions still in flight.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+bool unitTiming = false;
+string unitsFile;
+array<UnitClass, latencyClasses> unitClasses;
+
+array<long long, dependenceRegisters> registerReady; //cycle each register (and the flags and vector registers) can be read by an instruction in execute
+array<vector<long long>, latencyClasses> unitFree; //per unit, the cycle it accepts another instruction
+vector<vector<long long>> pluginUnitFree; //the same for the units of each plugin instruction
+long long dataStallCycles;
+long long structuralStallCycles;
+long long latencyCycles; //unpipelined, the execute cycles of an instruction past the first
+
+bool loadUnits(string fileName)
+{
+	for (UnitClass &unit : unitClasses) unit = { 1, true, 1 };
+	ifstream infile(fileName);
+	if (!infile)
+	{
+		cout << fileName << ": error: could not open file" << endl;
+		return false;
+	}
+
+	string line;
+	int lineNumber = 0;
+	while (getline(infile, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		stringstream words(line);
+		string className, setting;
+		if (!(words >> className)) continue;
+
+		int found = -1;
+		for (int i = 0; i < latencyClasses; i++) if (className == latencyClassNames[i]) found = i;
+		string problem = (found < 0) ? "unknown class " + className + ", expected alu, mul, div, load, store or branch" : "";
+		while (problem.empty() && (words >> setting))
+		{
+			size_t equals = setting.find('=');
+			string key = setting.substr(0, equals);
+			string value = (equals == string::npos) ? "" : setting.substr(equals + 1);
+			if ((key == "latency") && (atoi(value.c_str()) >= 1)) unitClasses[found].latency = atoi(value.c_str());
+			else if ((key == "units") && (atoi(value.c_str()) >= 1)) unitClasses[found].units = atoi(value.c_str());
+			else if ((key == "pipelined") && ((value == "yes") || (value == "no"))) unitClasses[found].pipelined = (value == "yes");
+			else problem = "bad setting " + setting + ", expected latency=cycles, pipelined=yes|no or units=N";
+		}
+		if (!problem.empty())
+		{
+			cout << fileName << ":" << lineNumber << ": error: " << problem << endl;
+			return false;
+		}
+	}
+	unitsFile = fileName;
+	unitTiming = true;
+	resetUnits();
+	return true;
+}
+
+void resetUnits()
+{//nothing in flight, called whenever the clock starts again
+	registerReady.fill(0);
+	for (int i = 0; i < latencyClasses; i++) unitFree[i].assign(unitClasses[i].units, 0);
+	pluginUnitFree.resize(pluginInstructionCount);
+	for (int i = 0; i < pluginInstructionCount; i++) pluginUnitFree[i].assign(pluginUnit(i).units, 0);
+	dataStallCycles = 0;
+	structuralStallCycles = 0;
+	latencyCycles = 0;
+}
+
+void issueInstruction(const Instructions &instruction)
+{//called by execute() for each instruction it starts, before the instruction runs
+	DecodedInstruction fields = {};
+	fields.opcode = instruction.opcode;
+	fields.Rd = instruction.Rd;
+	fields.Rn = instruction.Rn;
+	fields.Rm = instruction.Rm;
+	fields.Rt = instruction.Rt;
+	fields.shamt = instruction.shamt; //the vector operation
+	fields.format = instruction.format;
+	Dependences dependences = dependencesOf(fields, isLoad(instruction.opcode), storeSize(instruction.opcode) > 0);
+	bool plugin = dependences.plugin >= 0;
+	const UnitClass &unit = plugin ? pluginUnit(dependences.plugin) : unitClasses[dependences.latency];
+
+	long long now = clockCycles;
+	long long ready = now;
+	for (int i = 0; i < dependences.sourceCount; i++) ready = max(ready, registerReady[dependences.sources[i]]);
+	vector<long long> &units = plugin ? pluginUnitFree[dependences.plugin] : unitFree[dependences.latency];
+	auto chosen = min_element(units.begin(), units.end());
+	long long start = max(ready, *chosen);
+	dataStallCycles += ready - now;
+	structuralStallCycles += start - ready;
+
+	*chosen = start + (unit.pipelined ? 1 : unit.latency);
+	for (int i = 0; i < dependences.destinationCount; i++) registerReady[dependences.destinations[i]] = start + unit.latency;
+
+	long long latency = pipeline ? 0 : unit.latency - 1;
+	latencyCycles += latency;
+	long long hold = start - now + latency;
+	if (hold > 0) stallProcessor((int)hold + (pipeline ? 1 : 2)); //the rest of this step takes 1 more cycle pipelined, 2 unpipelined
+}
+
+void reportUnits()
+{
+	cout << "Functional units (" << unitsFile << "): " << dataStallCycles << " data stall, " << structuralStallCycles
+		<< " structural stall and " << latencyCycles << " latency cycles" << endl;
+}
@@ -0,0 +1,778 @@
+//Benchmark workload suite
+/*
+Each kernel generates its own machine code and input data for a chosen size N, the same way bubble.machine and setup() do for the
+original ten element sort. The harness runs every kernel under every execution mode with the per stage output silenced, checks the
+result left in data memory, and reports host MIPS (simulated instructions per host second) and simulated CPI. N must be at least
+1, and a size whose data or code would not fit in data memory or instruction memory is refused before any kernel runs.
+
+The kernels are scheduled for the current pipeline. Back to back dependencies are only safe out of a load, into the register of a
+CBZ/CBNZ, or in the X = X op Y form that forwarding() handles, so any other dependent pair is kept at least two instructions apart.
+X0 and X31 are never written.
+
+The harness also checks that the cycle loop does not touch the heap, counting allocations with the operator new of
+allocations.cpp. Each run is first stepped through untimed to learn its length, then run again for real with its first
+1/benchWarmupShare of steps as a warm up, so the latches, fetchVars and the output streams have their buffers; any allocation
+after that marks the run ALLOCATES and fails it.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <bitset>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <iomanip>
+
+#include "LEGv8-Pipelined.h"
+
+using namespace std;
+
+//opcodes used by the kernels, values match the cases in execute()
+const int opB = 0b000101;
+const int opBL = 0b100101;
+const int opBCOND = 0b01010100;
+const int opCBZ = 0b10110100;
+const int opCBNZ = 0b10110101;
+const int opADD = 0b10001011000;
+const int opADDI = 0b1001000100;
+const int opSDIV = 0b10011010110;
+const int opMUL = 0b10011011000;
+const int opSUB = 0b11001011000;
+const int opSUBI = 0b1101000100;
+const int opSUBS = 0b11101011000;
+const int opLSR = 0b11010011010;
+const int opLSL = 0b11010011011;
+const int opBR = 0b11010110000;
+const int opSTUR = 0b11111000000;
+const int opLDUR = 0b11111000010;
+const int opLDURSW = 0b10111000100;
+const int opEXIT = 0b11111111111;
+
+const int condLE = 0b01101;
+const int XZR = 31;
+const int LR = 30;
+
+int kernelTextWords; //length of the last kernel built, EXIT padding included
+
+struct KernelBuilder //emits machine code into instruction memory, branch targets are resolved from labels once the kernel is complete
+{
+	int location = 1;
+	map<string, int> labels;
+	vector<pair<int, string>> fixups; //memory location of a branch and the label it targets
+
+	void emit(string machineCode)
+	{//a kernel too long for instruction memory is only measured, runWorkloads() refuses to run it
+		if ((size_t)location < memory.size()) memory[location] = machineCode;
+		location++;
+	}
+
+	void R(int opcode, int Rd, int Rn, int Rm, int shamt = 0)
+	{
+		emit(bitset<11>(opcode).to_string() + bitset<5>(Rm).to_string() + bitset<6>(shamt).to_string() + bitset<5>(Rn).to_string() + bitset<5>(Rd).to_string());
+	}
+	void I(int opcode, int Rd, int Rn, int immediate)
+	{
+		emit(bitset<10>(opcode).to_string() + bitset<12>(immediate).to_string() + bitset<5>(Rn).to_string() + bitset<5>(Rd).to_string());
+	}
+	void D(int opcode, int Rt, int Rn, int address)
+	{
+		emit(bitset<11>(opcode).to_string() + bitset<9>(address).to_string() + "00" + bitset<5>(Rn).to_string() + bitset<5>(Rt).to_string());
+	}
+	void B(int opcode, string label)
+	{
+		fixups.push_back(make_pair(location, label));
+		emit(bitset<6>(opcode).to_string() + bitset<26>(0).to_string());
+	}
+	void C(int opcode, int Rt, string label)
+	{
+		fixups.push_back(make_pair(location, label));
+		emit(bitset<8>(opcode).to_string() + bitset<19>(0).to_string() + bitset<5>(Rt).to_string());
+	}
+	void BR(int Rt) { R(opBR, Rt, Rt, 0); } //execute() reads the target from the Rt (Rd) field, Rn is filled in as well to match ARM
+	void nop() { emit(bitset<8>(opCBNZ).to_string() + bitset<19>(1).to_string() + bitset<5>(XZR).to_string()); } //CBNZ XZR never branches
+	void label(string name) { labels[name] = location; }
+
+	void loadConstant(int Rd, int value)
+	{//ADDI only carries a 12 bit signed immediate, larger values are built 11 bits at a time
+		if ((value >= 0) && (value < 2048))
+		{
+			I(opADDI, Rd, XZR, value);
+			return;
+		}
+		I(opADDI, Rd, XZR, value >> 22);
+		nop();
+		R(opLSL, Rd, Rd, 0, 11);
+		nop();
+		I(opADDI, Rd, Rd, (value >> 11) & 0x7FF);
+		nop();
+		R(opLSL, Rd, Rd, 0, 11);
+		nop();
+		I(opADDI, Rd, Rd, value & 0x7FF);
+	}
+
+	void finish()
+	{//resolve branch offsets and pad with EXIT so the pipeline has something to fetch past the end
+		for (auto fixup : fixups)
+		{
+			if ((size_t)fixup.first >= memory.size()) continue;
+			string &machineCode = memory.at(fixup.first);
+			int offset = labels.at(fixup.second) - fixup.first;
+			if (findFormat(convertBinaryStringToInt(machineCode, 0, 5, 0, 0)) == 'B')
+				machineCode = machineCode.substr(0, 6) + bitset<26>(offset).to_string();
+			else
+				machineCode = machineCode.substr(0, 8) + bitset<19>(offset).to_string() + machineCode.substr(27, 5);
+		}
+		for (int i = 0; i < 5; i++) R(opEXIT, 0, 0, 0);
+		kernelTextWords = location - 1;
+	}
+};
+
+struct Kernel
+{
+	string name;
+	int defaultSize;
+	void(*generate)(int size);
+	bool(*check)(int size);
+	long long(*dataBytes)(long long size); //data memory the kernel uses at that size, its stack included
+};
+
+vector<int> kernelInput; //host copy of the generated input, used by the checks
+
+void storeArray(const vector<int>& values, int location)
+{
+	for (size_t i = 0; i < values.size(); i++) storeDataMemory(values[i], location + 8 * i, 8);
+}
+
+bool checkArray(const vector<int>& expected, int location)
+{
+	for (size_t i = 0; i < expected.size(); i++)
+		if (loadDataMemory(location + 8 * i, 8) != expected[i]) return false;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////KERNELS/////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void bubbleSortGenerate(int n)
+{//array at 0, sorted in place
+	kernelInput.clear();
+	for (int i = 0; i < n; i++) kernelInput.push_back(rand() % 10000);
+	storeArray(kernelInput, 0);
+
+	KernelBuilder k;
+	k.loadConstant(1, n);
+	k.I(opADDI, 2, XZR, 0);				//X2 = &a[0]
+	k.I(opSUBI, 3, 1, 1);				//X3 = passes left
+	k.label("outer");
+	k.C(opCBZ, 3, "done");
+	k.I(opADDI, 4, 2, 0);				//X4 = &a[i]
+	k.I(opADDI, 5, 3, 0);				//X5 = compares left in this pass
+	k.label("inner");
+	k.C(opCBZ, 5, "nextPass");
+	k.D(opLDUR, 6, 4, 0);
+	k.D(opLDUR, 7, 4, 8);
+	k.R(opSUBS, 8, 6, 7);
+	k.C(opBCOND, condLE, "skip");		//a[i] <= a[i+1]
+	k.D(opSTUR, 7, 4, 0);
+	k.D(opSTUR, 6, 4, 8);
+	k.label("skip");
+	k.I(opADDI, 4, 4, 8);
+	k.I(opSUBI, 5, 5, 1);
+	k.B(opB, "inner");
+	k.label("nextPass");
+	k.I(opSUBI, 3, 3, 1);
+	k.B(opB, "outer");
+	k.label("done");
+	k.finish();
+}
+
+bool bubbleSortCheck(int)
+{
+	vector<int> expected = kernelInput;
+	sort(expected.begin(), expected.end());
+	return checkArray(expected, 0);
+}
+
+void insertionSortGenerate(int n)
+{//array at 0, sorted in place
+	kernelInput.clear();
+	for (int i = 0; i < n; i++) kernelInput.push_back(rand() % 10000);
+	storeArray(kernelInput, 0);
+
+	KernelBuilder k;
+	k.loadConstant(1, n);
+	k.I(opADDI, 2, XZR, 0);				//X2 = &a[0]
+	k.I(opADDI, 9, 2, 8);				//X9 = &a[i], i = 1
+	k.I(opSUBI, 3, 1, 1);				//X3 = elements left to insert
+	k.label("outer");
+	k.C(opCBZ, 3, "done");
+	k.I(opADDI, 4, 9, 0);				//X4 = hole
+	k.D(opLDUR, 6, 9, 0);				//X6 = key
+	k.label("inner");
+	k.R(opSUB, 7, 4, 2);
+	k.C(opCBZ, 7, "place");				//hole reached a[0]
+	k.D(opLDUR, 8, 4, -8);
+	k.R(opSUBS, 10, 8, 6);
+	k.C(opBCOND, condLE, "place");		//a[hole-1] <= key
+	k.D(opSTUR, 8, 4, 0);
+	k.I(opSUBI, 4, 4, 8);
+	k.B(opB, "inner");
+	k.label("place");
+	k.D(opSTUR, 6, 4, 0);
+	k.I(opADDI, 9, 9, 8);
+	k.I(opSUBI, 3, 3, 1);
+	k.B(opB, "outer");
+	k.label("done");
+	k.finish();
+}
+
+bool insertionSortCheck(int n)
+{
+	return bubbleSortCheck(n);
+}
+
+void matrixMultiplyGenerate(int n)
+{//A at 0, B after A, C = A x B after B, all n x n row major
+	kernelInput.clear();
+	for (int i = 0; i < 2 * n * n; i++) kernelInput.push_back(rand() % 10);
+	storeArray(kernelInput, 0);
+
+	KernelBuilder k;
+	k.loadConstant(1, n);
+	k.nop();
+	k.R(opLSL, 11, 1, 0, 3);			//X11 = row size in bytes
+	k.R(opMUL, 14, 1, 1);
+	k.R(opLSL, 14, 14, 0, 3);			//X14 = &B
+	k.R(opADD, 12, XZR, XZR);			//X12 = &A[i][0]
+	k.R(opADD, 13, 14, 14);				//X13 = &C
+	k.I(opADDI, 15, 1, 0);				//X15 = rows left
+	k.label("rowLoop");
+	k.C(opCBZ, 15, "done");
+	k.I(opADDI, 16, 14, 0);				//X16 = &B[0][j]
+	k.I(opADDI, 17, 1, 0);				//X17 = columns left
+	k.label("columnLoop");
+	k.C(opCBZ, 17, "nextRow");
+	k.I(opADDI, 18, 12, 0);				//X18 walks the row of A
+	k.I(opADDI, 19, 16, 0);				//X19 walks the column of B
+	k.I(opADDI, 20, 1, 0);				//X20 = products left
+	k.R(opADD, 21, XZR, XZR);			//X21 = sum
+	k.label("dotLoop");
+	k.C(opCBZ, 20, "storeSum");
+	k.D(opLDUR, 22, 18, 0);
+	k.D(opLDUR, 23, 19, 0);
+	k.R(opMUL, 24, 22, 23);
+	k.I(opADDI, 18, 18, 8);
+	k.R(opADD, 21, 21, 24);
+	k.R(opADD, 19, 19, 11);
+	k.I(opSUBI, 20, 20, 1);
+	k.B(opB, "dotLoop");
+	k.label("storeSum");
+	k.D(opSTUR, 21, 13, 0);
+	k.I(opADDI, 13, 13, 8);
+	k.I(opADDI, 16, 16, 8);
+	k.I(opSUBI, 17, 17, 1);
+	k.B(opB, "columnLoop");
+	k.label("nextRow");
+	k.R(opADD, 12, 12, 11);
+	k.I(opSUBI, 15, 15, 1);
+	k.B(opB, "rowLoop");
+	k.label("done");
+	k.finish();
+}
+
+bool matrixMultiplyCheck(int n)
+{
+	vector<int> expected(n * n, 0);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			for (int x = 0; x < n; x++)
+				expected[i * n + j] += kernelInput[i * n + x] * kernelInput[n * n + x * n + j];
+	return checkArray(expected, 2 * n * n * 8);
+}
+
+void memcpyGenerate(int n)
+{//source at 0, memcpy destination after it, memset destination after that
+	kernelInput.clear();
+	for (int i = 0; i < n; i++) kernelInput.push_back(rand() % 10000);
+	storeArray(kernelInput, 0);
+
+	KernelBuilder k;
+	k.loadConstant(1, n);
+	k.nop();
+	k.R(opLSL, 3, 1, 0, 3);				//X3 = copy destination
+	k.I(opADDI, 4, XZR, 85);			//X4 = fill value
+	k.R(opADD, 9, 3, 3);				//X9 = set destination
+	k.I(opADDI, 6, 1, 0);				//X6 = words left
+	k.I(opADDI, 5, 9, 0);
+	k.label("setLoop");
+	k.C(opCBZ, 6, "setDone");
+	k.D(opSTUR, 4, 5, 0);
+	k.I(opADDI, 5, 5, 8);
+	k.I(opSUBI, 6, 6, 1);
+	k.B(opB, "setLoop");
+	k.label("setDone");
+	k.I(opADDI, 5, XZR, 0);				//X5 = source
+	k.I(opADDI, 7, 3, 0);				//X7 = destination
+	k.I(opADDI, 6, 1, 0);
+	k.label("copyLoop");
+	k.C(opCBZ, 6, "done");
+	k.D(opLDUR, 8, 5, 0);
+	k.I(opADDI, 5, 5, 8);
+	k.D(opSTUR, 8, 7, 0);
+	k.I(opADDI, 7, 7, 8);
+	k.I(opSUBI, 6, 6, 1);
+	k.B(opB, "copyLoop");
+	k.label("done");
+	k.finish();
+}
+
+bool memcpyCheck(int n)
+{
+	return checkArray(kernelInput, n * 8) && checkArray(vector<int>(n, 85), 2 * n * 8);
+}
+
+void linkedListGenerate(int n)
+{//head pointer at 0, sum written to 8, node count to 16, nodes of {next, value} from 32 linked in shuffled order
+	vector<int> order(n);
+	for (int i = 0; i < n; i++) order[i] = i;
+	shuffle(order.begin(), order.end(), default_random_engine(rand()));
+
+	kernelInput.clear();
+	for (int i = 0; i < n; i++) kernelInput.push_back(rand() % 10000);
+
+	storeDataMemory(n ? 32 + 16 * order[0] : 0, 0, 8);
+	for (int i = 0; i < n; i++)
+	{
+		int node = 32 + 16 * order[i];
+		storeDataMemory((i + 1 < n) ? 32 + 16 * order[i + 1] : 0, node, 8);
+		storeDataMemory(kernelInput[i], node + 8, 8);
+	}
+
+	KernelBuilder k;
+	k.D(opLDUR, 2, XZR, 0);				//X2 = node
+	k.R(opADD, 3, XZR, XZR);			//X3 = sum
+	k.R(opADD, 5, XZR, XZR);			//X5 = count
+	k.label("walk");
+	k.C(opCBZ, 2, "done");
+	k.D(opLDUR, 4, 2, 8);
+	k.D(opLDUR, 2, 2, 0);
+	k.R(opADD, 3, 3, 4);
+	k.I(opADDI, 5, 5, 1);
+	k.B(opB, "walk");
+	k.label("done");
+	k.D(opSTUR, 3, XZR, 8);
+	k.D(opSTUR, 5, XZR, 16);
+	k.finish();
+}
+
+bool linkedListCheck(int n)
+{
+	int sum = 0;
+	for (int value : kernelInput) sum += value;
+	return (loadDataMemory(8, 8) == sum) && (loadDataMemory(16, 8) == n);
+}
+
+const int fibonacciModulus = 10007;
+
+void fibonacciGenerate(int n)
+{//first n Fibonacci numbers mod 10007 written from 0, the reduction uses SDIV and MUL
+	kernelInput.clear();
+
+	KernelBuilder k;
+	k.I(opADDI, 4, XZR, 0);				//X4 = a
+	k.I(opADDI, 5, XZR, 1);				//X5 = b
+	k.R(opADD, 3, XZR, XZR);			//X3 = &fib[i]
+	k.loadConstant(2, fibonacciModulus);
+	k.loadConstant(1, n);
+	k.nop();
+	k.label("loop");
+	k.C(opCBZ, 1, "done");
+	k.R(opADD, 6, 4, 5);
+	k.D(opSTUR, 4, 3, 0);
+	k.R(opSDIV, 7, 6, 2, 0b000010);
+	k.I(opADDI, 3, 3, 8);
+	k.R(opMUL, 7, 7, 2);
+	k.R(opADD, 4, 5, XZR);				//a = b
+	k.R(opSUB, 5, 6, 7);				//b = (a + b) mod m
+	k.I(opSUBI, 1, 1, 1);
+	k.B(opB, "loop");
+	k.label("done");
+	k.finish();
+}
+
+bool fibonacciCheck(int n)
+{
+	vector<int> expected;
+	int a = 0, b = 1;
+	for (int i = 0; i < n; i++)
+	{
+		expected.push_back(a);
+		int c = (a + b) % fibonacciModulus;
+		a = b;
+		b = c;
+	}
+	return checkArray(expected, 0);
+}
+
+void binarySearchGenerate(int n)
+{//sorted keys at 0, n queries after them, number of hits written after the queries
+	kernelInput.clear();
+	int key = 0;
+	for (int i = 0; i < n; i++)
+	{
+		key += 1 + rand() % 4;
+		kernelInput.push_back(key);
+	}
+	storeArray(kernelInput, 0);
+	for (int i = 0; i < n; i++) storeDataMemory(rand() % (key + 2), (n + i) * 8, 8);
+
+	KernelBuilder k;
+	k.loadConstant(1, n);
+	k.I(opADDI, 2, XZR, 0);				//X2 = &a[0]
+	k.R(opADD, 10, XZR, XZR);			//X10 = hits
+	k.R(opLSL, 3, 1, 0, 3);				//X3 = &query
+	k.I(opADDI, 9, 1, 0);				//X9 = queries left
+	k.label("queryLoop");
+	k.C(opCBZ, 9, "done");
+	k.R(opADD, 5, XZR, XZR);			//X5 = lo
+	k.I(opADDI, 6, 1, 0);				//X6 = hi (exclusive)
+	k.D(opLDUR, 4, 3, 0);				//X4 = key
+	k.label("search");
+	k.R(opSUBS, 7, 6, 5);
+	k.C(opBCOND, condLE, "next");		//empty range, not found
+	k.R(opADD, 8, 5, 6);
+	k.R(opLSR, 8, 8, 0, 1);				//X8 = mid
+	k.nop();
+	k.R(opLSL, 11, 8, 0, 3);
+	k.R(opADD, 11, 11, 2);				//X11 = &a[mid]
+	k.I(opADDI, 13, 8, 1);
+	k.D(opLDUR, 12, 11, 0);
+	k.R(opSUBS, 7, 12, 4);
+	k.C(opBCOND, condLE, "notGreater");	//a[mid] <= key
+	k.R(opADD, 6, 8, XZR);				//hi = mid
+	k.B(opB, "search");
+	k.label("notGreater");
+	k.R(opSUBS, 7, 4, 12);
+	k.C(opBCOND, condLE, "found");		//a[mid] == key
+	k.R(opADD, 5, 13, XZR);				//lo = mid + 1
+	k.B(opB, "search");
+	k.label("found");
+	k.I(opADDI, 10, 10, 1);
+	k.label("next");
+	k.I(opADDI, 3, 3, 8);
+	k.I(opSUBI, 9, 9, 1);
+	k.B(opB, "queryLoop");
+	k.label("done");
+	k.R(opLSL, 3, 1, 0, 4);
+	k.nop();
+	k.D(opSTUR, 10, 3, 0);
+	k.finish();
+}
+
+bool binarySearchCheck(int n)
+{
+	int hits = 0;
+	for (int i = 0; i < n; i++)
+		if (binary_search(kernelInput.begin(), kernelInput.end(), loadDataMemory((n + i) * 8, 8))) hits++;
+	return loadDataMemory(2 * n * 8, 8) == hits;
+}
+
+void recursiveGenerate(int n)
+{//divide and conquer sum of the array at 0, every call is a BL with a stack frame of {LR, &a[lo], n, left sum}, result written after the array
+	kernelInput.clear();
+	for (int i = 0; i < n; i++) kernelInput.push_back(rand() % 10000);
+	storeArray(kernelInput, 0);
+
+	KernelBuilder k;
+	k.loadConstant(28, int(dataMemory.size()));	//SP, the stack grows down from the top of data memory
+	k.I(opADDI, 27, XZR, 1);			//X27 = 1
+	k.loadConstant(26, n);
+	k.I(opADDI, 1, XZR, 0);
+	k.nop();
+	k.I(opADDI, 3, 26, 0);
+	k.B(opBL, "sum");
+	k.R(opLSL, 4, 26, 0, 3);
+	k.nop();
+	k.D(opSTUR, 2, 4, 0);
+	k.B(opB, "done");
+	k.label("sum");						//X2 = sum of the X3 elements starting at address X1
+	k.I(opSUBI, 28, 28, 32);
+	k.R(opSUBS, 9, 3, 27);
+	k.C(opBCOND, condLE, "leaf");		//n <= 1
+	k.D(opSTUR, LR, 28, 0);
+	k.D(opSTUR, 1, 28, 8);
+	k.D(opSTUR, 3, 28, 16);
+	k.R(opLSR, 3, 3, 0, 1);
+	k.B(opBL, "sum");					//left half
+	k.D(opSTUR, 2, 28, 24);
+	k.D(opLDUR, 3, 28, 16);
+	k.D(opLDUR, 1, 28, 8);
+	k.R(opLSR, 10, 3, 0, 1);
+	k.nop();
+	k.R(opLSL, 11, 10, 0, 3);
+	k.R(opSUB, 3, 3, 10);
+	k.R(opADD, 1, 1, 11);
+	k.B(opBL, "sum");					//right half
+	k.D(opLDUR, 9, 28, 24);
+	k.R(opADD, 2, 2, 9);
+	k.D(opLDUR, LR, 28, 0);
+	k.I(opADDI, 28, 28, 32);
+	k.BR(LR);
+	k.label("leaf");
+	k.D(opLDUR, 2, 1, 0);
+	k.I(opADDI, 28, 28, 32);
+	k.BR(LR);
+	k.label("done");
+	k.finish();
+}
+
+bool recursiveCheck(int n)
+{
+	int sum = 0;
+	for (int value : kernelInput) sum += value;
+	return loadDataMemory(n * 8, 8) == sum;
+}
+
+int reduceInput(int n)
+{//n 32 bit values at 0, padded with zeros to whole vectors, which changes neither the sum nor the maximum
+	kernelInput.clear();
+	for (int i = 0; i < n; i++) kernelInput.push_back(rand() % 10000);
+	kernelInput.resize((n + 3) & ~3, 0);
+	for (size_t i = 0; i < kernelInput.size(); i++) storeDataMemory(kernelInput[i], 4 * (int)i, 4);
+	return (int)kernelInput.size();
+}
+
+void reduceGenerate(int n)
+{//sum and maximum of the 32 bit array at 0 one element at a time, written after the array
+	n = reduceInput(n);
+
+	KernelBuilder k;
+	k.loadConstant(1, n);				//X1 = elements left
+	k.I(opADDI, 2, XZR, 0);				//X2 = &a[i]
+	k.R(opADD, 3, XZR, XZR);			//X3 = sum
+	k.R(opADD, 4, XZR, XZR);			//X4 = maximum
+	k.label("loop");
+	k.C(opCBZ, 1, "done");
+	k.D(opLDURSW, 5, 2, 0);
+	k.I(opADDI, 2, 2, 4);
+	k.R(opADD, 3, 3, 5);
+	k.R(opSUBS, 6, 5, 4);
+	k.C(opBCOND, condLE, "skip");		//a[i] <= maximum
+	k.R(opADD, 4, 5, XZR);
+	k.label("skip");
+	k.I(opSUBI, 1, 1, 1);
+	k.B(opB, "loop");
+	k.label("done");
+	k.loadConstant(7, 4 * n);
+	k.nop();
+	k.D(opSTUR, 3, 7, 0);
+	k.D(opSTUR, 4, 7, 8);
+	k.finish();
+}
+
+void vectorReduceGenerate(int n)
+{//reduce with the simd.cpp vector instructions, four elements per LDUR Q and ADDV/SMAXV across the lanes at the end
+	n = reduceInput(n);
+
+	KernelBuilder k;
+	k.loadConstant(1, n / 4);			//X1 = vectors left
+	k.I(opADDI, 2, XZR, 0);				//X2 = &a[i]
+	k.R(opcodeVector, 1, XZR, 0, vectorDUP * 4 + 2);	//V1 = lane sums
+	k.R(opcodeVector, 2, XZR, 0, vectorDUP * 4 + 2);	//V2 = lane maximums
+	k.label("loop");
+	k.C(opCBZ, 1, "done");
+	k.D(opcodeVectorLoad, 3, 2, 0);
+	k.I(opADDI, 2, 2, 16);
+	k.R(opcodeVector, 1, 1, 3, vectorADD * 4 + 2);
+	k.R(opcodeVector, 2, 2, 3, vectorSMAX * 4 + 2);
+	k.I(opSUBI, 1, 1, 1);
+	k.B(opB, "loop");
+	k.label("done");
+	k.R(opcodeAcross, 3, 1, XZR, vectorADD * 4 + 2);
+	k.R(opcodeAcross, 4, 2, XZR, vectorSMAX * 4 + 2);
+	k.loadConstant(7, 4 * n);
+	k.nop();
+	k.D(opSTUR, 3, 7, 0);
+	k.D(opSTUR, 4, 7, 8);
+	k.finish();
+}
+
+bool reduceCheck(int)
+{
+	int sum = 0, maximum = 0;
+	for (int value : kernelInput) sum += value;
+	for (int value : kernelInput) maximum = max(maximum, value);
+	int location = 4 * (int)kernelInput.size();
+	return (loadDataMemory(location, 8) == sum) && (loadDataMemory(location + 8, 8) == maximum);
+}
+
+Kernel kernels[] =
+{
+	{ "bubble", 32, bubbleSortGenerate, bubbleSortCheck, [](long long n) { return 8 * n; } },
+	{ "insertion", 32, insertionSortGenerate, insertionSortCheck, [](long long n) { return 8 * n; } },
+	{ "matmul", 8, matrixMultiplyGenerate, matrixMultiplyCheck, [](long long n) { return 3 * 8 * n * n; } },
+	{ "memcpy", 256, memcpyGenerate, memcpyCheck, [](long long n) { return 3 * 8 * n; } },
+	{ "list", 256, linkedListGenerate, linkedListCheck, [](long long n) { return 32 + 16 * n; } },
+	{ "fibonacci", 256, fibonacciGenerate, fibonacciCheck, [](long long n) { return 8 * n; } },
+	{ "bsearch", 64, binarySearchGenerate, binarySearchCheck, [](long long n) { return 16 * n + 8; } },
+	{ "recursive", 256, recursiveGenerate, recursiveCheck, [](long long n) { return 8 * n + 8 + 32 * 33; } }, //a frame per level, 32 levels at most
+	{ "reduce", 256, reduceGenerate, reduceCheck, [](long long n) { return 4 * ((n + 3) & ~3LL) + 16; } },
+	{ "vreduce", 256, vectorReduceGenerate, reduceCheck, [](long long n) { return 4 * ((n + 3) & ~3LL) + 16; } },
+};
+
+struct ExecutionMode
+{
+	string name;
+	bool pipelined;
+	bool checked; //lockstep against the cosim.cpp reference
+};
+
+ExecutionMode executionModes[] =
+{
+	{ "unpipelined", false, false },
+	{ "pipelined", true, false },
+	{ "checked", true, true },
+};
+
+const int benchWarmupShare = 10; //the first tenth of a run's steps warm it up
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////HARNESS/////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int runWorkloads(int argc, char* argv[])
+{//--bench [--kernel name] [--size N] [--scale factor] [--csv file]
+	string usage = "Usage: --bench [--kernel name] [--size N] [--scale factor] [--csv file]";
+	string onlyKernel;
+	long long size = 0;
+	long long scale = 1;
+	string csvName;
+
+	for (int i = 2; i < argc; i++)
+	{
+		string option = argv[i];
+		if ((option == "--kernel") && (i + 1 < argc)) onlyKernel = argv[++i];
+		else if (((option == "--size") || (option == "--scale")) && (i + 1 < argc))
+		{
+			string text = argv[++i];
+			size_t used = 0;
+			long long value = 0;
+			try { value = stoll(text, &used); }
+			catch (const exception &) { used = 0; }
+			if ((used != text.size()) || (value < 1))
+			{
+				cout << option << " takes a whole number of at least 1, not '" << text << "'" << endl;
+				cout << usage << endl;
+				return 1;
+			}
+			(option == "--size" ? size : scale) = value;
+		}
+		else if ((option == "--csv") && (i + 1 < argc)) csvName = argv[++i];
+		else
+		{
+			cout << "Unknown benchmark option " << option << endl;
+			cout << usage << endl;
+			return 1;
+		}
+	}
+
+	for (Kernel &kernel : kernels)
+	{//every size is checked before anything runs, a kernel built past either memory would fail part way with a misleading result
+		if (!onlyKernel.empty() && (onlyKernel != kernel.name)) continue;
+		long long n = size ? size : kernel.defaultSize * min(scale, (long long)dataMemory.size());
+		if ((n > (long long)dataMemory.size()) || (kernel.dataBytes(n) > (long long)dataMemory.size()))
+		{//every kernel takes at least a byte per element, so the first test keeps the footprint from overflowing
+			cout << kernel.name << " at N = " << n << " does not fit in the " << dataMemory.size() << " bytes of data memory" << endl;
+			cout << usage << endl;
+			return 1;
+		}
+		resetSimulator();
+		kernel.generate((int)n);
+		if (kernelTextWords > (int)memory.size() - 1)
+		{
+			cout << kernel.name << " at N = " << n << " is " << kernelTextWords << " instructions, instruction memory holds " << memory.size() - 1 << endl;
+			cout << usage << endl;
+			return 1;
+		}
+	}
+
+	ofstream csv;
+	if (!csvName.empty())
+	{
+		csv.open(csvName);
+		csv << "kernel,size,mode,instructions,cycles,cpi,seconds,mips,allocations,result" << endl;
+	}
+
+	cout << left << setw(11) << "Kernel" << right << setw(7) << "N" << "  " << left << setw(12) << "Mode" << right
+		<< setw(12) << "Instr" << setw(12) << "Cycles" << setw(8) << "CPI" << setw(10) << "Seconds" << setw(10) << "MIPS" << setw(8) << "Allocs" << "  Result" << endl;
+
+	int failures = 0;
+	int matched = 0;
+	for (Kernel &kernel : kernels)
+	{
+		if (!onlyKernel.empty() && (onlyKernel != kernel.name)) continue;
+		matched++;
+		int n = (int)(size ? size : kernel.defaultSize * scale);
+		unsigned int seed = rand(); //every mode runs the same input
+
+		for (ExecutionMode &mode : executionModes)
+		{
+			auto prepare = [&]()
+			{
+				resetSimulator();
+				srand(seed);
+				kernel.generate(n);
+				pipeline = mode.pipelined;
+				fetchInstruction(PC);
+			};
+			prepare();
+			quietOutput(true);
+			long long steps = 0;
+			for (; !endProgram; steps++) stepProcessor(); //untimed, sizes the warm up
+			quietOutput(false);
+
+			prepare();
+			cosimEnabled = mode.checked;
+			if (cosimEnabled) startCosim();
+
+			quietOutput(true);
+			auto start = chrono::steady_clock::now();
+			for (long long step = 0; (step < steps / benchWarmupShare) && !endProgram; step++) stepProcessor();
+			long long warmAllocations = heapAllocationCount();
+			run();
+			long long allocations = heapAllocationCount() - warmAllocations;
+			auto end = chrono::steady_clock::now();
+			quietOutput(false);
+
+			double seconds = chrono::duration<double>(end - start).count();
+			double cpi = instructionsRetired ? double(clockCycles) / instructionsRetired : 0;
+			double mips = (seconds > 0) ? instructionsRetired / seconds / 1e6 : 0;
+			bool correct = kernel.check(n);
+			bool agreed = !mode.checked || finishCosim();
+			cosimEnabled = false;
+			if (!correct || !agreed || allocations) failures++;
+			string result = !agreed ? "DIVERGED" : !correct ? "WRONG" : allocations ? "ALLOCATES" : "ok";
+
+			cout << left << setw(11) << kernel.name << right << setw(7) << n << "  " << left << setw(12) << mode.name << right
+				<< setw(12) << instructionsRetired << setw(12) << clockCycles << setw(8) << fixed << setprecision(3) << cpi
+				<< setw(10) << setprecision(4) << seconds << setw(10) << setprecision(4) << mips << setw(8) << allocations << "  " << result << endl;
+			cout.unsetf(ios::floatfield);
+			if (!agreed) cout << cosimReport;
+
+			if (csv.is_open())
+				csv << kernel.name << "," << n << "," << mode.name << "," << instructionsRetired << "," << clockCycles << ","
+				<< cpi << "," << seconds << "," << mips << "," << allocations << "," << result << endl;
+		}
+	}
+
+	if (!matched)
+	{
+		cout << "No kernel named " << onlyKernel << endl;
+		return 1;
+	}
+	return failures ? 1 : 0;
+}